@@ -0,0 +1,261 @@
+// Amasson
+
+
+#include "Aggregates/SlotInventoryAggregate.h"
+#include "Components/SlotInventoryComponentBase.h"
+#include "Debug/SlotInventoryJournal.h"
+#include "SlotInventoryBlueprintLibrary.h"
+#include "SlotInventoryStats.h"
+
+
+/** Members */
+
+USlotInventoryAggregate* USlotInventoryAggregate::MakeInventoryAggregate(const TArray<USlotInventoryComponentBase*>& Members)
+{
+    USlotInventoryAggregate* Aggregate = NewObject<USlotInventoryAggregate>();
+    Aggregate->SetMembers(Members);
+    return Aggregate;
+}
+
+USlotInventoryAggregate* USlotInventoryAggregate::MakeInventoryAggregateFromHolder(UObject* Holder, const TArray<FName>& InventoryTags)
+{
+    TArray<USlotInventoryComponentBase*> Members;
+    for (const FName& InventoryTag : InventoryTags)
+    {
+        if (USlotInventoryComponentBase* Inventory = USlotInventoryBlueprintLibrary::GetInventoryComponent(Holder, InventoryTag))
+            Members.AddUnique(Inventory);
+    }
+    return MakeInventoryAggregate(Members);
+}
+
+void USlotInventoryAggregate::SetMembers(const TArray<USlotInventoryComponentBase*>& NewMembers)
+{
+    Members.Reset();
+    for (USlotInventoryComponentBase* Member : NewMembers)
+    {
+        if (IsValid(Member))
+            Members.AddUnique(Member);
+    }
+}
+
+TArray<USlotInventoryComponentBase*> USlotInventoryAggregate::GetMembers() const
+{
+    return GetValidMembers();
+}
+
+TArray<USlotInventoryComponentBase*> USlotInventoryAggregate::GetValidMembers() const
+{
+    TArray<USlotInventoryComponentBase*> ValidMembers;
+    ValidMembers.Reserve(Members.Num());
+    for (const TWeakObjectPtr<USlotInventoryComponentBase>& Member : Members)
+    {
+        if (Member.IsValid())
+            ValidMembers.Add(Member.Get());
+    }
+    return ValidMembers;
+}
+
+
+/** Slots */
+
+int32 USlotInventoryAggregate::GetCapacity() const
+{
+    int32 Capacity = 0;
+    for (const USlotInventoryComponentBase* Member : GetValidMembers())
+        Capacity += Member->GetContentCapacity();
+    return Capacity;
+}
+
+bool USlotInventoryAggregate::ResolveIndex(int32 Index, USlotInventoryComponentBase*& Member, int32& MemberIndex) const
+{
+    if (Index < 0)
+        return false;
+
+    for (USlotInventoryComponentBase* ValidMember : GetValidMembers())
+    {
+        const int32 Capacity = ValidMember->GetContentCapacity();
+        if (Index < Capacity)
+        {
+            Member = ValidMember;
+            MemberIndex = Index;
+            return true;
+        }
+        Index -= Capacity;
+    }
+    return false;
+}
+
+bool USlotInventoryAggregate::GetSlotValueAtIndex(int32 Index, FInventorySlot& SlotValue) const
+{
+    USlotInventoryComponentBase* Member;
+    int32 MemberIndex;
+    if (ResolveIndex(Index, Member, MemberIndex))
+        return Member->GetSlotValueAtIndex(MemberIndex, SlotValue);
+    return false;
+}
+
+
+/** Queries */
+
+int32 USlotInventoryAggregate::GetItemQuantity(FName Item) const
+{
+    int32 Total = 0;
+    for (const USlotInventoryComponentBase* Member : GetValidMembers())
+        Total += USlotInventoryBlueprintLibrary::GetItemQuantity(Member->GetContent(), Item);
+    return Total;
+}
+
+int32 USlotInventoryAggregate::GetEmptySlotCount() const
+{
+    int32 Total = 0;
+    for (const USlotInventoryComponentBase* Member : GetValidMembers())
+        Total += USlotInventoryBlueprintLibrary::GetEmptySlotCounts(Member->GetContent());
+    return Total;
+}
+
+bool USlotInventoryAggregate::ContainsItems(const TMap<FName, int32>& Items) const
+{
+    const TArray<USlotInventoryComponentBase*> ValidMembers = GetValidMembers();
+
+    TMap<FName, int32> Missing = Items;
+    for (const USlotInventoryComponentBase* Member : ValidMembers)
+    {
+        Member->GetContent().ForEachStoredSlot([&Missing](int32 SlotIndex, const FInventorySlot& Slot)
+        {
+            if (Slot.IsEmpty())
+                return;
+            if (int32* Quantity = Missing.Find(Slot.Item))
+                *Quantity -= Slot.Quantity;
+        });
+    }
+
+    for (const auto& [Item, Quantity] : Missing)
+    {
+        if (Quantity > 0)
+            return false;
+    }
+    return true;
+}
+
+
+/** Modifications */
+
+bool USlotInventoryAggregate::ModifyContent(const TMap<FName, int32>& Items, TMap<FName, int32>& Overflows, bool bAllOrNothing)
+{
+    SLOTINVENTORY_SCOPE_CYCLE_COUNTER(AggregateModifyContent);
+
+    const TArray<USlotInventoryComponentBase*> ValidMembers = GetValidMembers();
+
+    FPlan Plan;
+    Overflows.Reset();
+    for (const auto& [Item, Quantity] : Items)
+    {
+        const int32 QuantityLeft = PlanStack(Plan, ValidMembers, Item, Quantity);
+        if (QuantityLeft != 0)
+            Overflows.Add(Item, QuantityLeft);
+    }
+
+    if (Plan.Slots.IsEmpty() || (bAllOrNothing && !Overflows.IsEmpty()))
+    {
+        if (bAllOrNothing)
+            Overflows = Items;
+        return false;
+    }
+
+    for (const FPlannedSlot& PlannedSlot : Plan.Slots)
+    {
+        USlotInventoryComponentBase* Member = ValidMembers[PlannedSlot.MemberIndex];
+        FInventorySlot& Slot = *Member->Content.GetSlotPtrAtIndex(PlannedSlot.SlotIndex);
+        if (PlannedSlot.Quantity == 0)
+        {
+            Slot.Reset();
+        }
+        else
+        {
+            Slot.Item = PlannedSlot.Item;
+            Slot.Quantity = PlannedSlot.Quantity;
+        }
+        Member->MarkDirtySlot(PlannedSlot.SlotIndex);
+
+        if (FSlotInventoryJournal* Journal = FSlotInventoryJournal::GetRecording())
+            Journal->RecordSlotValues(Member, { PlannedSlot.SlotIndex });
+    }
+    return true;
+}
+
+int32 USlotInventoryAggregate::PlanStack(FPlan& Plan, const TArray<USlotInventoryComponentBase*>& ValidMembers, const FName& Item, int32 Quantity) const
+{
+    int32 ScannedSlots = 0;
+
+    /** Current value of a slot, including what has already been planned */
+    auto GetPlannedValue = [&Plan](int32 MemberIndex, int32 SlotIndex, const FInventorySlot& Slot, FName& OutItem, int32& OutQuantity)
+    {
+        if (const int32* PlannedIndex = Plan.SlotLookup.Find({ MemberIndex, SlotIndex }))
+        {
+            OutItem = Plan.Slots[*PlannedIndex].Item;
+            OutQuantity = Plan.Slots[*PlannedIndex].Quantity;
+        }
+        else
+        {
+            OutItem = Slot.IsEmpty() ? NAME_None : Slot.Item;
+            OutQuantity = Slot.IsEmpty() ? 0 : Slot.Quantity;
+        }
+    };
+
+    auto SetPlannedValue = [&Plan](int32 MemberIndex, int32 SlotIndex, const FName& NewItem, int32 NewQuantity)
+    {
+        if (const int32* PlannedIndex = Plan.SlotLookup.Find({ MemberIndex, SlotIndex }))
+        {
+            Plan.Slots[*PlannedIndex].Item = NewItem;
+            Plan.Slots[*PlannedIndex].Quantity = NewQuantity;
+        }
+        else
+        {
+            Plan.SlotLookup.Add({ MemberIndex, SlotIndex }, Plan.Slots.Num());
+            Plan.Slots.Add({ MemberIndex, SlotIndex, NewItem, NewQuantity });
+        }
+    };
+
+    /** First merge into the existing stacks of every member, then fill empty slots */
+    for (int32 Pass = 0; Pass < 2 && Quantity != 0; Pass++)
+    {
+        const bool bOnlyMerge = Pass == 0;
+        if (!bOnlyMerge && Quantity < 0)
+            break;
+
+        for (int32 MemberIndex = 0; MemberIndex < ValidMembers.Num() && Quantity != 0; MemberIndex++)
+        {
+            const USlotInventoryComponentBase* Member = ValidMembers[MemberIndex];
+            const FInventoryContent& Content = Member->GetContent();
+            const int32 MaxStackSize = Member->GetMaxStackSizeForID(Item);
+
+            for (int32 SlotIndex = 0; SlotIndex < Content.GetCapacity() && Quantity != 0; SlotIndex++)
+            {
+                ++ScannedSlots;
+                const FInventorySlot& Slot = *Content.GetSlotConstPtrAtIndex(SlotIndex);
+                if (Slot.HasModifiers())
+                    continue;
+
+                FName SlotItem;
+                int32 SlotQuantity;
+                GetPlannedValue(MemberIndex, SlotIndex, Slot, SlotItem, SlotQuantity);
+
+                const bool bIsEmpty = SlotQuantity == 0;
+                if (bOnlyMerge ? (bIsEmpty || SlotItem != Item) : !bIsEmpty)
+                    continue;
+
+                const int32 Transfer = Quantity > 0
+                    ? FMath::Min(Quantity, FMath::Max(MaxStackSize - SlotQuantity, 0))
+                    : FMath::Max(Quantity, -SlotQuantity);
+                if (Transfer == 0)
+                    continue;
+
+                Quantity -= Transfer;
+                SetPlannedValue(MemberIndex, SlotIndex, Item, SlotQuantity + Transfer);
+            }
+        }
+    }
+
+    INC_DWORD_STAT_BY(STAT_SlotInventory_SlotsScanned, ScannedSlots);
+    return Quantity;
+}
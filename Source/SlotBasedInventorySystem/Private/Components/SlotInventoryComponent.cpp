@@ -3,6 +3,10 @@
 
 #include "Components/SlotInventoryComponent.h"
 #include "Net/UnrealNetwork.h"
+#include "Subsystems/SlotInventorySubsystem.h"
+#include "Engine/World.h"
+#include "TimerManager.h"
+#include "SlotInventoryStats.h"
 
 
 USlotInventoryComponent::USlotInventoryComponent()
@@ -15,12 +19,24 @@ void USlotInventoryComponent::BeginPlay()
 {
     Super::BeginPlay();
 
+    /** Roles of actors spawned by replication are only exchanged after their construction */
+    bHasAuthority = GetOwner() ? GetOwner()->HasAuthority() : false;
+
     if (bHasAuthority)
     {
         OnInventoryCapacityChanged.AddDynamic(this, &ThisClass::OnCapacityChanged);
+        ScheduleNetDormancy();
     }
 }
 
+void USlotInventoryComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    if (UWorld* World = GetWorld())
+        World->GetTimerManager().ClearTimer(DormancyTimerHandle);
+
+    Super::EndPlay(EndPlayReason);
+}
+
 void USlotInventoryComponent::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
 {
     Super::GetLifetimeReplicatedProps(OutLifetimeProps);
@@ -28,17 +44,95 @@ void USlotInventoryComponent::GetLifetimeReplicatedProps(TArray<FLifetimePropert
 
 }
 
+bool USlotInventoryComponent::CallRemoteFunction(UFunction* Function, void* Parameters, FOutParmRec* OutParms, FFrame* Stack)
+{
+    if (Function->HasAnyFunctionFlags(FUNC_NetServer) && GetNetMode() == NM_Client
+        && Function->GetFName() != GET_FUNCTION_NAME_CHECKED(USlotInventoryComponent, Server_TagTelemetryRequest)
+        && Function->GetFName() != GET_FUNCTION_NAME_CHECKED(USlotInventoryComponent, Server_SetViewLocked))
+    {
+        /** Reliable RPCs of a same actor are received in order, the tag arrives right before its request */
+        if (FSlotInventoryNetTelemetry* Telemetry = GetOrCreateNetTelemetry())
+            Server_TagTelemetryRequest(Telemetry->RecordRequestSent());
+    }
+
+    return Super::CallRemoteFunction(Function, Parameters, OutParms, Stack);
+}
+
+
+/** Request Budget */
+
+template<typename FunctionType>
+void USlotInventoryComponent::SubmitServerRequest(ESlotInventoryServerRequest Request, int32 WorkSlots, FunctionType&& Execute)
+{
+    RecordServerRequest(Request);
+
+    const uint32 TelemetrySequence = TaggedTelemetryRequest;
+    TaggedTelemetryRequest = 0;
+
+    auto ExecuteAndAcknowledge = [this, TelemetrySequence, Execute = Forward<FunctionType>(Execute)]() mutable
+    {
+        Execute();
+        if (TelemetrySequence != 0)
+            AcknowledgeTelemetryRequest(TelemetrySequence);
+    };
+
+    UWorld* World = GetWorld();
+    USlotInventorySubsystem* Subsystem = World ? World->GetSubsystem<USlotInventorySubsystem>() : nullptr;
+    if (Subsystem == nullptr)
+    {
+        ExecuteAndAcknowledge();
+        return;
+    }
+
+    /** Requests of the server itself have no connection and are never limited */
+    const UNetConnection* Connection = GetOwner() ? GetOwner()->GetNetConnection() : nullptr;
+
+    FSlotInventoryRequestBudget& Budget = Subsystem->GetRequestBudget();
+    const double Cost = FSlotInventoryRequestBudget::EstimateCost(Request, WorkSlots);
+    switch (Budget.Consume(Connection, Cost))
+    {
+    case FSlotInventoryRequestBudget::EDecision::Accept:
+        ExecuteAndAcknowledge();
+        break;
+    case FSlotInventoryRequestBudget::EDecision::Defer:
+        Budget.Defer(Connection, Cost, this, TFunction<void()>(MoveTemp(ExecuteAndAcknowledge)));
+        break;
+    case FSlotInventoryRequestBudget::EDecision::Reject:
+        Client_RequestRejected(TelemetrySequence);
+        break;
+    }
+}
+
+void USlotInventoryComponent::Client_RequestRejected_Implementation(uint32 TelemetrySequence)
+{
+    if (TelemetrySequence != 0)
+    {
+        if (FSlotInventoryNetTelemetry* Telemetry = GetOrCreateNetTelemetry())
+            Telemetry->RecordRequestRejected(TelemetrySequence);
+    }
+
+    OnServerRequestRejected.Broadcast(this);
+}
+
 void USlotInventoryComponent::Server_BroadcastFullInventory_Implementation(bool bOwnerOnly)
 {
-    TArray<int32> AllIndices;
-    AllIndices.Reserve(GetContentCapacity() + 1);  // Reserve space for N+1 elements
-    for (int32 i = 0; i <= GetContentCapacity(); i++)
-        AllIndices.Add(i);
+    SubmitServerRequest(ESlotInventoryServerRequest::BroadcastFullInventory, GetContentCapacity(), [this, bOwnerOnly]()
+    {
+        SLOTINVENTORY_SCOPE_CYCLE_COUNTER(BroadcastFullInventory);
 
-    if (bOwnerOnly)
-        Client_UpdateSlotsValues_Implementation(AllIndices, Content.Slots);
-    else
-        NetMulticast_UpdateSlotsValues_Implementation(AllIndices, Content.Slots);
+        TArray<int32> AllIndices;
+        AllIndices.Reserve(GetContentCapacity() + 1);  // Reserve space for N+1 elements
+        for (int32 i = 0; i <= GetContentCapacity(); i++)
+            AllIndices.Add(i);
+
+        TArray<FInventorySlot> AllSlots;
+        Content.CopySlots(AllSlots);
+
+        if (bOwnerOnly)
+            Client_UpdateSlotsValues_Implementation(AllIndices, AllSlots);
+        else
+            NetMulticast_UpdateSlotsValues_Implementation(AllIndices, AllSlots);
+    });
 }
 
 
@@ -46,43 +140,71 @@ void USlotInventoryComponent::Server_BroadcastFullInventory_Implementation(bool
 
 void USlotInventoryComponent::Server_RequestSetContentCapacity_Implementation(int32 NewCapacity)
 {
-    SetContentCapacity(NewCapacity);
+    /** Negative capacities are set to 0, clamped here so the resized slots count cannot overflow */
+    NewCapacity = FMath::Max(NewCapacity, 0);
+    SubmitServerRequest(ESlotInventoryServerRequest::SetContentCapacity, FMath::Abs(NewCapacity - GetContentCapacity()), [this, NewCapacity]()
+    {
+        SetContentCapacity(NewCapacity);
+    });
 }
 
 void USlotInventoryComponent::Server_RequestSetSlotValueAtIndex_Implementation(int32 Index, const FInventorySlot& NewSlotValue)
 {
-    SetSlotValueAtIndex(Index, NewSlotValue);
+    SubmitServerRequest(ESlotInventoryServerRequest::SetSlotValueAtIndex, 0, [this, Index, NewSlotValue]()
+    {
+        SetSlotValueAtIndex(Index, NewSlotValue);
+    });
 }
 
 void USlotInventoryComponent::Server_RequestClearSlotAtIndex_Implementation(int32 Index)
 {
-    ClearSlotAtIndex(Index);
+    SubmitServerRequest(ESlotInventoryServerRequest::ClearSlotAtIndex, 0, [this, Index]()
+    {
+        ClearSlotAtIndex(Index);
+    });
 }
 
 void USlotInventoryComponent::Server_RequestDropSlotTowardOtherInventoryAtIndex_Implementation(int32 SourceIndex, USlotInventoryComponentBase* DestinationInventory, int32 DestinationIndex, int32 MaxAmount)
 {
-    DropSlotTowardOtherInventoryAtIndex(SourceIndex, DestinationInventory, DestinationIndex, MaxAmount);
+    TWeakObjectPtr<USlotInventoryComponentBase> WeakDestination = DestinationInventory;
+    SubmitServerRequest(ESlotInventoryServerRequest::DropSlotTowardOtherInventoryAtIndex, 0, [this, SourceIndex, WeakDestination, DestinationIndex, MaxAmount]()
+    {
+        DropSlotTowardOtherInventoryAtIndex(SourceIndex, WeakDestination.Get(), DestinationIndex, MaxAmount);
+    });
 }
 
 void USlotInventoryComponent::Server_RequestDropSlotTowardOtherInventory_Implementation(int32 SourceIndex, USlotInventoryComponentBase* DestinationInventory)
 {
-    DropSlotTowardOtherInventory(SourceIndex, DestinationInventory);
+    const int32 WorkSlots = IsValid(DestinationInventory) ? DestinationInventory->GetContentCapacity() : 0;
+    TWeakObjectPtr<USlotInventoryComponentBase> WeakDestination = DestinationInventory;
+    SubmitServerRequest(ESlotInventoryServerRequest::DropSlotTowardOtherInventory, WorkSlots, [this, SourceIndex, WeakDestination]()
+    {
+        DropSlotTowardOtherInventory(SourceIndex, WeakDestination.Get());
+    });
 }
 
 void USlotInventoryComponent::Server_RequestDropSlotFromOtherInventoryAtIndex_Implementation(int32 DestinationIndex, USlotInventoryComponentBase* SourceInventory, int32 SourceIndex, int32 MaxAmount)
 {
-    if (IsValid(SourceInventory))
+    TWeakObjectPtr<USlotInventoryComponentBase> WeakSource = SourceInventory;
+    SubmitServerRequest(ESlotInventoryServerRequest::DropSlotFromOtherInventoryAtIndex, 0, [this, DestinationIndex, WeakSource, SourceIndex, MaxAmount]()
     {
-        SourceInventory->DropSlotTowardOtherInventoryAtIndex(SourceIndex, this, DestinationIndex, MaxAmount);
-    }
+        if (USlotInventoryComponentBase* Source = WeakSource.Get())
+        {
+            Source->DropSlotTowardOtherInventoryAtIndex(SourceIndex, this, DestinationIndex, MaxAmount);
+        }
+    });
 }
 
 void USlotInventoryComponent::Server_RequestDropSlotFromOtherInventory_Implementation(USlotInventoryComponentBase* SourceInventory, int32 SourceIndex)
 {
-    if (IsValid(SourceInventory))
+    TWeakObjectPtr<USlotInventoryComponentBase> WeakSource = SourceInventory;
+    SubmitServerRequest(ESlotInventoryServerRequest::DropSlotFromOtherInventory, GetContentCapacity(), [this, WeakSource, SourceIndex]()
     {
-        SourceInventory->DropSlotTowardOtherInventory(SourceIndex, this);
-    }
+        if (USlotInventoryComponentBase* Source = WeakSource.Get())
+        {
+            Source->DropSlotTowardOtherInventory(SourceIndex, this);
+        }
+    });
 }
 
 static AActor* GetLastValidOwner(AActor* Actor)
@@ -137,7 +259,53 @@ void USlotInventoryComponent::DropInventorySlotFromSourceToDestination(USlotInve
 
 void USlotInventoryComponent::Server_RequestRegroupSlotAtIndexWithSimilarIds_Implementation(int32 Index)
 {
-    RegroupSimilarItemsAtIndex(Index);
+    SubmitServerRequest(ESlotInventoryServerRequest::RegroupSlotAtIndexWithSimilarIds, GetContentCapacity(), [this, Index]()
+    {
+        RegroupSimilarItemsAtIndex(Index);
+    });
+}
+
+
+
+/** Background Maintenance */
+
+void USlotInventoryComponent::AcquireViewLock()
+{
+    const bool bWasLocked = IsViewLocked();
+    Super::AcquireViewLock();
+
+    if (!bWasLocked && IsOwnedByLocalClient())
+        Server_SetViewLocked(true);
+}
+
+void USlotInventoryComponent::ReleaseViewLock()
+{
+    if (!IsViewLocked())
+        return;
+
+    Super::ReleaseViewLock();
+
+    if (!IsViewLocked() && IsOwnedByLocalClient())
+        Server_SetViewLocked(false);
+}
+
+bool USlotInventoryComponent::IsOwnedByLocalClient() const
+{
+    /** Server RPCs of actors without an owning connection are dropped by the engine */
+    const AActor* Owner = GetOwner();
+    return !bHasAuthority && GetNetMode() == NM_Client && Owner && Owner->GetNetConnection() != nullptr;
+}
+
+void USlotInventoryComponent::Server_SetViewLocked_Implementation(bool bLocked)
+{
+    if (bLocked == bRemoteViewLocked)
+        return;
+
+    bRemoteViewLocked = bLocked;
+    if (bLocked)
+        Super::AcquireViewLock();
+    else
+        Super::ReleaseViewLock();
 }
 
 
@@ -155,11 +323,16 @@ void USlotInventoryComponent::Client_UpdateSlotsValues_Implementation(const TArr
 
 void USlotInventoryComponent::ReceievedUpdateSlotsValues(const TArray<int32>& Indices, const TArray<FInventorySlot>& Values)
 {
+    SLOTINVENTORY_SCOPE_CYCLE_COUNTER(ReceivedUpdateSlotsValues);
+
     checkf(Indices.Num() == Values.Num(), TEXT("SlotInventoryComponent_Networked::ReceievedUpdateSlotsValues: Received miss matching arrays"));
 
     if (bHasAuthority)
         return;
 
+    if (FSlotInventoryNetTelemetry* Telemetry = GetOrCreateNetTelemetry())
+        Telemetry->RecordSlotsUpdateReceived();
+
     for (int32 i = 0; i < Indices.Num(); i++)
     {
         SetSlotValueAtIndex(Indices[i], Values[i]);
@@ -173,16 +346,22 @@ void USlotInventoryComponent::OnCapacityChanged(USlotInventoryComponentBase* Slo
 {
     if (SlotInventoryComponent == this)
     {
-        NetMulticast_UpdateCapacity(NewCapacity);
+        /** Sent with the modified slots at the next content update */
+        bCapacityDirty = true;
+        MarkSlotsHaveBeenModified();
     }
 }
 
-void USlotInventoryComponent::NetMulticast_UpdateCapacity_Implementation(int32 NewCapacity)
+void USlotInventoryComponent::NetMulticast_UpdateCapacityAndSlotsValues_Implementation(int32 MinCapacity, int32 NewCapacity, const TArray<int32>& Indices, const TArray<FInventorySlot>& Values)
 {
     if (bHasAuthority)
         return;
 
+    /** Shrink first so the slots the server emptied in between are emptied here too */
+    if (MinCapacity < GetContentCapacity())
+        SetContentCapacity(MinCapacity);
     SetContentCapacity(NewCapacity);
+    ReceievedUpdateSlotsValues(Indices, Values);
 }
 
 
@@ -191,24 +370,192 @@ void USlotInventoryComponent::NetMulticast_UpdateCapacity_Implementation(int32 N
 void USlotInventoryComponent::BroadcastContentUpdate()
 {
     if (bHasAuthority)
+    {
         BroadcastModifiedSlotsToClients();
+        SendTelemetryAcks();
+        ScheduleNetDormancy();
+    }
 
     Super::BroadcastContentUpdate();
 }
 
 void USlotInventoryComponent::BroadcastModifiedSlotsToClients()
 {
-    TArray<int32> Indices;
-    TArray<FInventorySlot> Values;
+    SLOTINVENTORY_SCOPE_CYCLE_COUNTER(BroadcastModifiedSlotsToClients);
+
+    /** Reused between updates, resetting keeps their allocation */
+    TArray<int32>& Indices = UpdateIndicesScratch;
+    TArray<FInventorySlot>& Values = UpdateValuesScratch;
+    Indices.Reset();
+    Values.Reset();
 
     for (int32 DirtySlotIndex : DirtySlots)
     {
-        FInventorySlot SlotValue;
-        if (GetSlotValueAtIndex(DirtySlotIndex, SlotValue))
+        if (const FInventorySlot* Slot = Content.GetSlotConstPtrAtIndex(DirtySlotIndex))
         {
             Indices.Add(DirtySlotIndex);
-            Values.Add(SlotValue);
+            Values.Add(*Slot);
         }
     }
-    NetMulticast_UpdateSlotsValues(Indices, Values);
+
+    if (bCapacityDirty)
+    {
+        bCapacityDirty = false;
+        RecordSlotsUpdateSent(Indices, Values);
+        const int32 Capacity = GetContentCapacity();
+        const int32 MinCapacity = MinCapacitySinceUpdate != INDEX_NONE ? FMath::Min(MinCapacitySinceUpdate, Capacity) : Capacity;
+        NetMulticast_UpdateCapacityAndSlotsValues(MinCapacity, Capacity, Indices, Values);
+    }
+    else if (!Indices.IsEmpty())
+    {
+        RecordSlotsUpdateSent(Indices, Values);
+        NetMulticast_UpdateSlotsValues(Indices, Values);
+    }
+}
+
+
+/** Net Dormancy */
+
+void USlotInventoryComponent::MarkSlotsHaveBeenModified()
+{
+    Super::MarkSlotsHaveBeenModified();
+
+    if (bHasAuthority)
+        WakeFromNetDormancy();
+}
+
+void USlotInventoryComponent::WakeFromNetDormancy()
+{
+    AActor* Owner = GetOwner();
+    if (!bUseNetDormancy || Owner == nullptr || Owner->NetDormancy <= DORM_Awake)
+        return;
+
+    INC_DWORD_STAT(STAT_SlotInventory_DormancyWakes);
+
+    /** The channels are flushed right away, the update can be sent this frame and the owner stays dormant after it */
+    Owner->FlushNetDormancy();
+    Owner->ForceNetUpdate();
+}
+
+void USlotInventoryComponent::ScheduleNetDormancy()
+{
+    UWorld* World = GetWorld();
+    if (!bUseNetDormancy || World == nullptr)
+        return;
+
+    World->GetTimerManager().SetTimer(DormancyTimerHandle, this, &ThisClass::OnDormancyQuietPeriodElapsed, FMath::Max(DormancyQuietSeconds, 0.01f));
+}
+
+void USlotInventoryComponent::OnDormancyQuietPeriodElapsed()
+{
+    AActor* Owner = GetOwner();
+    if (!bUseNetDormancy || Owner == nullptr)
+        return;
+
+    /** An update is still pending, it reschedules the dormancy once sent */
+    if (!DirtySlots.IsEmpty() || bCapacityDirty)
+        return;
+
+    /** Reliable updates still unacknowledged are delivered before the channels close for dormancy */
+    Owner->SetNetDormancy(DORM_DormantAll);
+}
+
+
+/** Memory */
+
+void USlotInventoryComponent::CompactMemory()
+{
+    Super::CompactMemory();
+
+    UpdateIndicesScratch.Empty();
+    UpdateValuesScratch.Empty();
+}
+
+void USlotInventoryComponent::AccumulateMemoryUsage(FSlotInventoryMemoryUsage& Usage) const
+{
+    Super::AccumulateMemoryUsage(Usage);
+
+    Usage.Tracking += UpdateIndicesScratch.GetAllocatedSize() + UpdateValuesScratch.GetAllocatedSize();
+    Usage.Slack += UpdateIndicesScratch.GetAllocatedSize() + UpdateValuesScratch.GetAllocatedSize();
+    if (NetTelemetry.IsValid())
+        Usage.Tracking += sizeof(FSlotInventoryNetTelemetry);
+}
+
+
+/** Telemetry */
+
+FSlotInventoryNetTelemetry* USlotInventoryComponent::GetNetTelemetry() const
+{
+    return NetTelemetry.Get();
+}
+
+FSlotInventoryNetTelemetry* USlotInventoryComponent::GetOrCreateNetTelemetry()
+{
+    if (!FSlotInventoryNetTelemetry::IsEnabled())
+        return nullptr;
+
+    if (!NetTelemetry.IsValid())
+        NetTelemetry = MakeUnique<FSlotInventoryNetTelemetry>();
+
+    return NetTelemetry.Get();
+}
+
+void USlotInventoryComponent::RecordServerRequest(ESlotInventoryServerRequest Request)
+{
+    if (FSlotInventoryNetTelemetry* Telemetry = GetOrCreateNetTelemetry())
+        Telemetry->RecordServerRequest(Request);
+}
+
+void USlotInventoryComponent::Server_TagTelemetryRequest_Implementation(uint32 Sequence)
+{
+    TaggedTelemetryRequest = Sequence;
+}
+
+void USlotInventoryComponent::Client_AckTelemetryRequests_Implementation(const TArray<uint32>& Sequences)
+{
+    if (FSlotInventoryNetTelemetry* Telemetry = GetOrCreateNetTelemetry())
+    {
+        for (uint32 Sequence : Sequences)
+            Telemetry->RecordRequestAcknowledged(Sequence);
+    }
+}
+
+void USlotInventoryComponent::AcknowledgeTelemetryRequest(uint32 Sequence)
+{
+    PendingTelemetryAcks.Add(Sequence);
+
+    /** Nothing to send here, acknowledge right away */
+    if (DirtySlots.IsEmpty() && !bCapacityDirty)
+        SendTelemetryAcks();
+}
+
+void USlotInventoryComponent::SendTelemetryAcks()
+{
+    if (PendingTelemetryAcks.IsEmpty())
+        return;
+
+    Client_AckTelemetryRequests(PendingTelemetryAcks);
+    PendingTelemetryAcks.Reset();
+}
+
+void USlotInventoryComponent::RecordSlotsUpdateSent(const TArray<int32>& Indices, const TArray<FInventorySlot>& Values)
+{
+    FSlotInventoryNetTelemetry* Telemetry = GetOrCreateNetTelemetry();
+
+#if STATS
+    const bool bMeasure = true;
+#else
+    const bool bMeasure = Telemetry != nullptr;
+#endif
+
+    if (!bMeasure)
+        return;
+
+    const int32 NumBytes = FSlotInventoryNetTelemetry::EstimateSlotsUpdateSize(Indices, Values);
+
+    INC_DWORD_STAT_BY(STAT_SlotInventory_SlotUpdatesSent, Indices.Num());
+    INC_DWORD_STAT_BY(STAT_SlotInventory_SlotUpdateBytesSent, NumBytes);
+
+    if (Telemetry)
+        Telemetry->RecordSlotsUpdateSent(Indices.Num(), NumBytes);
 }
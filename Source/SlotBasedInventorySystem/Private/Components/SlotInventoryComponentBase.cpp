@@ -2,16 +2,114 @@
 
 
 #include "Components/SlotInventoryComponentBase.h"
+#include "Subsystems/SlotInventorySubsystem.h"
+#include "Debug/SlotInventoryJournal.h"
+#include "Persistence/SlotInventoryAsyncSave.h"
+#include "Transactions/SlotInventoryBatchEditScope.h"
+#include "Misc/App.h"
+#include "Engine/World.h"
+#include "SlotInventoryStats.h"
+#include "Async/ParallelFor.h"
+#include "Misc/MemStack.h"
 
 USlotInventoryComponentBase::USlotInventoryComponentBase()
 {
 	PrimaryComponentTick.bCanEverTick = true;
+
+	/** Only ticks the frame after play begins and the frame after a modification */
+	PrimaryComponentTick.bStartWithTickEnabled = false;
+}
+
+void USlotInventoryComponentBase::OnRegister()
+{
+	Super::OnRegister();
+
+	/** Sparse contents have no Slots to show in the details panel, editor worlds keep them dense */
+	const UWorld* World = GetWorld();
+	Content.SetSparse(bSparseContent && World && World->IsGameWorld());
+
+	/** Once per component, re-registering must not generate the content again */
+	if (bLazyContent && !bHydrationInitialized && World && World->IsGameWorld())
+	{
+		bHydrationInitialized = true;
+
+		bool bHasItems = false;
+		Content.ForEachStoredSlot([&bHasItems](int32 SlotIndex, const FInventorySlot& Slot)
+		{
+			bHasItems |= !Slot.IsEmpty();
+		});
+
+		if (!DehydratedContent.IsEmpty() || (LootSeed != 0 && !bHasItems))
+			bContentHydrated = false;
+	}
+}
+
+void USlotInventoryComponentBase::Serialize(FArchive& Ar)
+{
+#if WITH_EDITOR
+	/** Cooked lazy inventories only store their serialized content, loading them copies bytes */
+	if (bLazyContent && Ar.IsSaving() && Ar.IsCooking() && DehydratedContent.IsEmpty())
+	{
+		FInventoryContent AuthoredContent = MoveTemp(Content);
+		Content = FInventoryContent();
+		FSlotInventoryAsyncSave::SerializeContent(AuthoredContent, DehydratedContent, false);
+
+		Super::Serialize(Ar);
+
+		Content = MoveTemp(AuthoredContent);
+		DehydratedContent.Empty();
+		return;
+	}
+#endif
+
+	Super::Serialize(Ar);
+}
+
+void USlotInventoryComponentBase::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (USlotInventorySubsystem* Subsystem = GetWorld()->GetSubsystem<USlotInventorySubsystem>())
+		Subsystem->RegisterInventory(this);
+
+	/** Listeners bound before play still get the initial content update on the first tick */
+	SetComponentTickEnabled(true);
+
+	/** The initial content may already be fragmented */
+	QueueBackgroundMaintenance();
+}
+
+void USlotInventoryComponentBase::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (USlotInventorySubsystem* Subsystem = GetWorld()->GetSubsystem<USlotInventorySubsystem>())
+		Subsystem->UnregisterInventory(this);
+
+	Super::EndPlay(EndPlayReason);
+}
+
+FName USlotInventoryComponentBase::GetInventoryTag() const
+{
+	return InventoryTag;
+}
+
+void USlotInventoryComponentBase::GetResourceSizeEx(FResourceSizeEx& CumulativeResourceSize)
+{
+	Super::GetResourceSizeEx(CumulativeResourceSize);
+
+	CumulativeResourceSize.AddDedicatedSystemMemoryBytes(GetMemoryUsage().GetTotal());
 }
 
 void USlotInventoryComponentBase::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
 {
 	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
 
+	FlushContentUpdate();
+}
+
+void USlotInventoryComponentBase::FlushContentUpdate()
+{
+	SLOTINVENTORY_SCOPE_CYCLE_COUNTER(BroadcastContentUpdate);
+
 	SetComponentTickEnabled(false);
 	BroadcastContentUpdate();
 }
@@ -19,50 +117,136 @@ void USlotInventoryComponentBase::TickComponent(float DeltaTime, ELevelTick Tick
 
 const FInventoryContent& USlotInventoryComponentBase::GetContent() const
 {
+	EnsureContentHydrated();
 	return Content;
 }
 
 void USlotInventoryComponentBase::SetContent(const FInventoryContent& NewContent)
 {
-	if (NewContent.Slots.Num() != GetContentCapacity())
+	SLOTINVENTORY_SCOPE_CYCLE_COUNTER(SetContent);
+
+	if (NewContent.GetCapacity() != GetContentCapacity())
 	{
-		SetContentCapacity(NewContent.Slots.Num());
+		SetContentCapacity(NewContent.GetCapacity());
 	}
-	for (int32 SlotIndex = 0; SlotIndex < NewContent.Slots.Num(); SlotIndex++)
+
+	/** Slots empty in both contents are left untouched, so sparse pages are not allocated */
+	TArray<int32> ClearedSlots;
+	Content.ForEachStoredSlot([&NewContent, &ClearedSlots](int32 SlotIndex, const FInventorySlot& Slot)
+	{
+		if (!Slot.IsEmpty() && NewContent.GetSlotConstPtrAtIndex(SlotIndex)->IsEmpty())
+			ClearedSlots.Add(SlotIndex);
+	});
+	for (int32 SlotIndex : ClearedSlots)
 	{
-		SetSlotValueAtIndex(SlotIndex, NewContent.Slots[SlotIndex]);
+		ClearSlotAtIndex(SlotIndex);
 	}
+	NewContent.ForEachStoredSlot([this](int32 SlotIndex, const FInventorySlot& Slot)
+	{
+		if (!Slot.IsEmpty())
+			SetSlotValueAtIndex(SlotIndex, Slot);
+	});
 }
 
 int32 USlotInventoryComponentBase::GetContentCapacity() const
 {
-	return Content.Slots.Num();
+	EnsureContentHydrated();
+	return Content.GetCapacity();
 }
 
 void USlotInventoryComponentBase::SetContentCapacity(int32 NewCapacity)
 {
+	TArray<int32> EvictedIndices;
+	TArray<FInventorySlot> EvictedSlots;
+	SetContentCapacityWithEvictions(NewCapacity, EvictedIndices, EvictedSlots);
+}
+
+void USlotInventoryComponentBase::SetContentCapacityWithEvictions(int32 NewCapacity, TArray<int32>& EvictedIndices, TArray<FInventorySlot>& EvictedSlots)
+{
+	EnsureContentHydrated();
+	SLOTINVENTORY_SCOPE_CYCLE_COUNTER(SetContentCapacity);
+
+	if (FSlotInventoryJournal* Journal = FSlotInventoryJournal::GetRecording())
+		Journal->RecordSetCapacity(this, NewCapacity);
+
+	EvictedIndices.Reset();
+	EvictedSlots.Reset();
+
 	if (NewCapacity < 0)
 		NewCapacity = 0;
 
 	const int32 OldCapacity = GetContentCapacity();
+	if (NewCapacity == OldCapacity)
+		return;
+
+	for (int32 SlotIndex = NewCapacity; SlotIndex < OldCapacity; SlotIndex++)
+	{
+		const FInventorySlot* Slot = Content.GetSlotConstPtrAtIndex(SlotIndex);
+		if (!Slot->IsEmpty())
+		{
+			EvictedIndices.Add(SlotIndex);
+			EvictedSlots.Add(*Slot);
+		}
+	}
 
-	Content.Slots.SetNum(NewCapacity, true);
+	/** New slots are created empty, on clients as well, they don't need to be sent */
+	Content.SetCapacity(NewCapacity);
 
-	if (NewCapacity > OldCapacity)
+	if (NewCapacity < OldCapacity)
 	{
-		for (int32 NewSlotIndex = OldCapacity; NewSlotIndex < NewCapacity; NewSlotIndex++)
+		for (auto It = DirtySlots.CreateIterator(); It; ++It)
+		{
+			if (*It >= NewCapacity)
+				It.RemoveCurrent();
+		}
+		for (auto It = UnsavedSlots.CreateIterator(); It; ++It)
 		{
-			ClearSlotAtIndex(NewSlotIndex);
+			if (*It >= NewCapacity)
+				It.RemoveCurrent();
 		}
 	}
+
+	/** The update and the delta save only carry the final capacity, they also need the lowest one to empty the slots in between */
+	MinCapacitySinceUpdate = FMath::Min(MinCapacitySinceUpdate == INDEX_NONE ? OldCapacity : MinCapacitySinceUpdate, NewCapacity);
+	if (bTrackUnsavedSlots)
+		UnsavedMinCapacity = FMath::Min(UnsavedMinCapacity == INDEX_NONE ? OldCapacity : UnsavedMinCapacity, NewCapacity);
+
+	/** Listeners are told about the evicted slots in the next content update */
+	if (!EvictedIndices.IsEmpty())
+	{
+		EvictedSlotsSinceUpdate.Append(EvictedIndices);
+		MarkSlotsHaveBeenModified();
+	}
+
+	ContentRevision++;
+
+	if (SnapshotChannel.IsValid())
+		SnapshotChannel->Publish(Content, DirtySlots, ContentRevision);
+
+	SLOTINVENTORY_SCOPE_CYCLE_COUNTER(OnInventoryCapacityChanged);
 	OnInventoryCapacityChanged.Broadcast(this, NewCapacity);
 }
 
 
+bool USlotInventoryComponentBase::IsContentSparse() const
+{
+	return Content.IsSparse();
+}
+
+void USlotInventoryComponentBase::SetContentSparse(bool bNewSparse)
+{
+	EnsureContentHydrated();
+	bSparseContent = bNewSparse;
+	Content.SetSparse(bNewSparse);
+}
+
+
 /** Public Slot Management */
 
 bool USlotInventoryComponentBase::GetSlotValueAtIndex(int32 Index, FInventorySlot& SlotValue) const
 {
+	EnsureContentHydrated();
+
 	if (const FInventorySlot* SlotPtr = Content.GetSlotConstPtrAtIndex(Index))
 	{
 		SlotValue = *SlotPtr;
@@ -74,6 +258,11 @@ bool USlotInventoryComponentBase::GetSlotValueAtIndex(int32 Index, FInventorySlo
 
 bool USlotInventoryComponentBase::SetSlotValueAtIndex(int32 Index, const FInventorySlot& NewSlotValue)
 {
+	EnsureContentHydrated();
+
+	if (FSlotInventoryJournal* Journal = FSlotInventoryJournal::GetRecording())
+		Journal->RecordSetSlot(this, Index, NewSlotValue);
+
 	if (FInventorySlot* SlotPtr = Content.GetSlotPtrAtIndex(Index))
 	{
 		*SlotPtr = NewSlotValue;
@@ -86,31 +275,41 @@ bool USlotInventoryComponentBase::SetSlotValueAtIndex(int32 Index, const FInvent
 
 bool USlotInventoryComponentBase::ClearSlotAtIndex(int32 Index)
 {
-	if (FInventorySlot* SlotPtr = Content.GetSlotPtrAtIndex(Index))
-	{
-		bool bIsEmpty = SlotPtr->IsEmpty();
-		SlotPtr->Reset();
-		if (!bIsEmpty)
-		{
-			MarkDirtySlot(Index);
-			return true;
-		}
-	}
+	EnsureContentHydrated();
 
-	return false;
+	if (FSlotInventoryJournal* Journal = FSlotInventoryJournal::GetRecording())
+		Journal->RecordClearSlot(this, Index);
+
+	/** Clearing an empty slot does not allocate its sparse page */
+	const FInventorySlot* ConstSlotPtr = Content.GetSlotConstPtrAtIndex(Index);
+	if (ConstSlotPtr == nullptr || ConstSlotPtr->IsEmpty())
+		return false;
+
+	Content.GetSlotPtrAtIndex(Index)->Reset();
+	MarkDirtySlot(Index);
+	return true;
 }
 
 void USlotInventoryComponentBase::ModifySlotQuantityAtIndex(int32 Index, int32 ModifyAmount, bool bAllOrNothing, int32& Overflow)
 {
-	FInventorySlot* SlotPtr = Content.GetSlotPtrAtIndex(Index);
+	SLOTINVENTORY_SCOPE_CYCLE_COUNTER(ModifySlotQuantity);
+
+	EnsureContentHydrated();
+
+	if (FSlotInventoryJournal* Journal = FSlotInventoryJournal::GetRecording())
+		Journal->RecordModifySlotQuantity(this, Index, ModifyAmount, bAllOrNothing);
+
+	const FInventorySlot* ConstSlotPtr = Content.GetSlotConstPtrAtIndex(Index);
 
-    const bool bCanStack = SlotPtr && !SlotPtr->IsEmpty() && SlotPtr->Modifiers.IsEmpty();
+    const bool bCanStack = ConstSlotPtr && !ConstSlotPtr->IsEmpty() && ConstSlotPtr->Modifiers.IsEmpty();
 	if (!bCanStack)
 	{
 		Overflow = ModifyAmount;
 		return;
 	}
 
+	FInventorySlot* SlotPtr = Content.GetSlotPtrAtIndex(Index);
+
 	const int32 MaxStackSize = GetMaxStackSizeForID(SlotPtr->Item);
 
 	if (bAllOrNothing)
@@ -136,6 +335,11 @@ void USlotInventoryComponentBase::ModifySlotQuantityAtIndex(int32 Index, int32 M
 
 bool USlotInventoryComponentBase::AddModifierToSlotAtIndex(int32 Index, const FItemModifier& NewModifier)
 {
+    EnsureContentHydrated();
+
+    if (FSlotInventoryJournal* Journal = FSlotInventoryJournal::GetRecording())
+        Journal->RecordAddModifier(this, Index, NewModifier);
+
     FInventorySlot* SlotPtr = Content.GetSlotPtrAtIndex(Index);
     if (!SlotPtr)
         return false;
@@ -166,12 +370,26 @@ void USlotInventoryComponentBase::GetMaxStackSizeForIds(const TSet<FName>& Ids,
 
 bool USlotInventoryComponentBase::ModifyContent(const TMap<FName, int32>& Items, TMap<FName, int32>& Overflows)
 {
-	const TMap<FName, int32>& MaxStackSizes = GetMaxStackSizesFromIds(Items);
-	
-	Overflows = Items;
+	SLOTINVENTORY_SCOPE_CYCLE_COUNTER(ModifyContent);
+
+	EnsureContentHydrated();
+
+	if (FSlotInventoryJournal* Journal = FSlotInventoryJournal::GetRecording())
+		Journal->RecordModifyContent(this, Items, false);
+
+	const FInventoryContent::FMaxStackSizes MaxStackSizes = GetMaxStackSizesFromIds(Items);
+
+	/** Received stacks are removed, only the leftovers are written to Overflows */
+	FInventoryContent::FItemStacks Stacks(Items);
 	FInventoryContentTransactionRule Rule;
 	FInventoryContent::FContentModifications ModificationResult;
-	if (Content.ReceiveStacks(Overflows, Rule, MaxStackSizes, ModificationResult))
+	const bool bModified = Content.ReceiveStacks(Stacks, Rule, MaxStackSizes, ModificationResult);
+
+	Overflows.Reset();
+	for (const auto& [Item, Quantity] : Stacks)
+		Overflows.Add(Item, Quantity);
+
+	if (bModified)
 	{
 		for (int32 ModifiedSlotIndex : ModificationResult.ModifiedSlots)
 			MarkDirtySlot(ModifiedSlotIndex);
@@ -182,23 +400,37 @@ bool USlotInventoryComponentBase::ModifyContent(const TMap<FName, int32>& Items,
 
 bool USlotInventoryComponentBase::TryModifyContentWithoutOverflow(const TMap<FName, int32>& Items)
 {
-	const TMap<FName, int32>& MaxStackSizes = GetMaxStackSizesFromIds(Items);
+	SLOTINVENTORY_SCOPE_CYCLE_COUNTER(TryModifyContent);
+
+	EnsureContentHydrated();
 
-	FInventoryContent TmpContent = Content;
+	if (FSlotInventoryJournal* Journal = FSlotInventoryJournal::GetRecording())
+		Journal->RecordModifyContent(this, Items, true);
 
-	FInventoryContent::FItemStacks Stacks = Items;
+	const FInventoryContent::FMaxStackSizes MaxStackSizes = GetMaxStackSizesFromIds(Items);
+
+	/** Only the touched slots are saved to roll back */
+	FInventoryContent::FPreviousValues PreviousValues;
+	FInventoryContent::FItemStacks Stacks(Items);
 	FInventoryContent::FContentModifications Modifications;
+	Modifications.PreviousValues = &PreviousValues;
 
 	FInventoryContentTransactionRule Rule;
 	Rule.bAtomic = true;
-	if (!TmpContent.ReceiveStacks(Stacks, Rule, MaxStackSizes, Modifications))
+	if (!Content.ReceiveStacks(Stacks, Rule, MaxStackSizes, Modifications))
+	{
+		Content.RestorePreviousValues(PreviousValues);
 		return false;
+	}
 
 	for (const auto& QuantityLeft : Stacks)
+	{
 		if (QuantityLeft.Value != 0)
+		{
+			Content.RestorePreviousValues(PreviousValues);
 			return false;
-
-	Content = TmpContent;
+		}
+	}
 
 	for (int32 ModifiedSlotIndex : Modifications.ModifiedSlots)
 		MarkDirtySlot(ModifiedSlotIndex);
@@ -208,13 +440,25 @@ bool USlotInventoryComponentBase::TryModifyContentWithoutOverflow(const TMap<FNa
 
 bool USlotInventoryComponentBase::DropSlotTowardOtherInventoryAtIndex(int32 SourceIndex, USlotInventoryComponentBase* DestinationInventory, int32 DestinationIndex, int32 MaxAmount)
 {
+	SLOTINVENTORY_SCOPE_CYCLE_COUNTER(DropSlotAtIndex);
+
+	EnsureContentHydrated();
+
+	if (FSlotInventoryJournal* Journal = FSlotInventoryJournal::GetRecording())
+		Journal->RecordDropSlotAtIndex(this, SourceIndex, DestinationInventory, DestinationIndex, MaxAmount);
+
 	if (!IsValid(DestinationInventory))
 		return false;
+	DestinationInventory->EnsureContentHydrated();
 
-	FInventorySlot* SourceSlot = Content.GetSlotPtrAtIndex(SourceIndex);
-	if (SourceSlot == nullptr)
+	const FInventorySlot* SourceConstSlot = Content.GetSlotConstPtrAtIndex(SourceIndex);
+	if (SourceConstSlot == nullptr)
 		return false;
 
+	/** An empty source is only written, and its sparse page allocated, if the swap gives it a slot */
+	FInventorySlot EmptySourceSlot;
+	FInventorySlot* SourceSlot = SourceConstSlot->IsEmpty() ? &EmptySourceSlot : Content.GetSlotPtrAtIndex(SourceIndex);
+
 	const int32 MaxStackSize = DestinationInventory->GetMaxStackSizeForID(SourceSlot->Item);
 
 	FInventorySlotTransactionRule Rule;
@@ -222,6 +466,8 @@ bool USlotInventoryComponentBase::DropSlotTowardOtherInventoryAtIndex(int32 Sour
 	Rule.MaxTransferQuantity = MaxAmount;
 	if (DestinationInventory->Content.ReceiveSlotAtIndex(*SourceSlot, DestinationIndex, Rule, MaxStackSize))
 	{
+		if (SourceSlot == &EmptySourceSlot && !EmptySourceSlot.IsEmpty())
+			*Content.GetSlotPtrAtIndex(SourceIndex) = MoveTemp(EmptySourceSlot);
 		MarkDirtySlot(SourceIndex);
 		DestinationInventory->MarkDirtySlot(DestinationIndex);
 		return true;
@@ -232,18 +478,34 @@ bool USlotInventoryComponentBase::DropSlotTowardOtherInventoryAtIndex(int32 Sour
 
 bool USlotInventoryComponentBase::DropSlotTowardOtherInventory(int32 SourceIndex, USlotInventoryComponentBase* Destination)
 {
+	return DropSlotAmountTowardOtherInventory(SourceIndex, Destination, 0);
+}
+
+bool USlotInventoryComponentBase::DropSlotAmountTowardOtherInventory(int32 SourceIndex, USlotInventoryComponentBase* Destination, int32 MaxAmount)
+{
+	SLOTINVENTORY_SCOPE_CYCLE_COUNTER(DropSlot);
+
+	EnsureContentHydrated();
+
+	if (FSlotInventoryJournal* Journal = FSlotInventoryJournal::GetRecording())
+		Journal->RecordDropSlot(this, SourceIndex, Destination, MaxAmount);
+
 	if (!IsValid(Destination))
 		return false;
+	Destination->EnsureContentHydrated();
 
-	FInventorySlot* SourceSlotPtr = Content.GetSlotPtrAtIndex(SourceIndex);
-	if (SourceSlotPtr == nullptr || SourceSlotPtr->IsEmpty())
+	/** An empty source is not written, only a non empty one, which already has its sparse page, is taken mutable */
+	const FInventorySlot* SourceConstSlotPtr = Content.GetSlotConstPtrAtIndex(SourceIndex);
+	if (SourceConstSlotPtr == nullptr || SourceConstSlotPtr->IsEmpty())
 		return false;
 
+	FInventorySlot* SourceSlotPtr = Content.GetSlotPtrAtIndex(SourceIndex);
+
 	const int32 MaxStackSize = Destination->GetMaxStackSizeForID(SourceSlotPtr->Item);
 
 	FInventoryContentTransactionRule Rule;
 	FInventoryContent::FContentModifications Modifications;
-	if (Destination->Content.ReceiveSlot(*SourceSlotPtr, Rule, MaxStackSize, Modifications))
+	if (Destination->Content.ReceiveSlotAmount(*SourceSlotPtr, MaxAmount, Rule, MaxStackSize, Modifications))
 	{
 		for (int32 ModifiedSlotIndex : Modifications.ModifiedSlots)
 			Destination->MarkDirtySlot(ModifiedSlotIndex);
@@ -256,6 +518,13 @@ bool USlotInventoryComponentBase::DropSlotTowardOtherInventory(int32 SourceIndex
 
 bool USlotInventoryComponentBase::RegroupSimilarItemsAtIndex(int32 Index)
 {
+	SLOTINVENTORY_SCOPE_CYCLE_COUNTER(RegroupSimilarItems);
+
+	EnsureContentHydrated();
+
+	if (FSlotInventoryJournal* Journal = FSlotInventoryJournal::GetRecording())
+		Journal->RecordRegroupSimilarItems(this, Index);
+
 	FInventorySlot* Slot = Content.GetSlotPtrAtIndex(Index);
 
 	if (Slot == nullptr)
@@ -275,14 +544,416 @@ bool USlotInventoryComponentBase::RegroupSimilarItemsAtIndex(int32 Index)
 }
 
 
+/** Bulk Operations */
+
+int32 USlotInventoryComponentBase::ParallelModifyContents(TConstArrayView<USlotInventoryComponentBase*> Inventories, FParallelContentOperation Operation)
+{
+	SLOTINVENTORY_SCOPE_CYCLE_COUNTER(ParallelModifyContents);
+	check(IsInGameThread());
+
+	/** Each content must be given to a single worker */
+	/** Temporaries live on the game thread memory stack until the modified slots are marked dirty */
+	FMemMark MemMark(FMemStack::Get());
+
+#if DO_CHECK
+	TSet<USlotInventoryComponentBase*> UniqueInventories;
+	UniqueInventories.Reserve(Inventories.Num());
+	for (USlotInventoryComponentBase* Inventory : Inventories)
+	{
+		checkf(!UniqueInventories.Contains(Inventory), TEXT("ParallelModifyContents received the same inventory twice"));
+		UniqueInventories.Add(Inventory);
+	}
+#endif
+
+	/** Workers only see hydrated contents */
+	for (USlotInventoryComponentBase* Inventory : Inventories)
+	{
+		if (IsValid(Inventory))
+			Inventory->EnsureContentHydrated();
+	}
+
+	TArray<FInventoryContent::FContentModifications, TMemStackAllocator<>> Modifications;
+	Modifications.SetNum(Inventories.Num());
+	TArray<bool, TMemStackAllocator<>> Modified;
+	Modified.SetNumZeroed(Inventories.Num());
+
+	static constexpr int32 MinInventoriesPerTask = 16;
+	const EParallelForFlags Flags = Inventories.Num() < MinInventoriesPerTask ? EParallelForFlags::ForceSingleThread : EParallelForFlags::Unbalanced;
+
+	ParallelFor(Inventories.Num(), [&](int32 InventoryIndex)
+	{
+		USlotInventoryComponentBase* Inventory = Inventories[InventoryIndex];
+		if (IsValid(Inventory))
+			Modified[InventoryIndex] = Operation(InventoryIndex, Inventory->Content, Modifications[InventoryIndex]);
+	}, Flags);
+
+	FSlotInventoryJournal* Journal = FSlotInventoryJournal::GetRecording();
+
+	int32 NumModified = 0;
+	for (int32 InventoryIndex = 0; InventoryIndex < Inventories.Num(); InventoryIndex++)
+	{
+		if (!Modified[InventoryIndex])
+			continue;
+
+		NumModified++;
+		USlotInventoryComponentBase* Inventory = Inventories[InventoryIndex];
+		for (int32 ModifiedSlotIndex : Modifications[InventoryIndex].ModifiedSlots)
+			Inventory->MarkDirtySlot(ModifiedSlotIndex);
+
+		if (Journal)
+			Journal->RecordSlotValues(Inventory, Modifications[InventoryIndex].ModifiedSlots.Array());
+	}
+	return NumModified;
+}
+
+int32 USlotInventoryComponentBase::BulkModifyContent(const TArray<USlotInventoryComponentBase*>& Inventories, const TMap<FName, int32>& Items)
+{
+	/** Stack sizes may come from game code, resolve them on the game thread */
+	FMemMark MemMark(FMemStack::Get());
+	TArray<FInventoryContent::FMaxStackSizes, TMemStackAllocator<>> MaxStackSizes;
+	MaxStackSizes.Reserve(Inventories.Num());
+	for (USlotInventoryComponentBase* Inventory : Inventories)
+		MaxStackSizes.Add(IsValid(Inventory) ? Inventory->GetMaxStackSizesFromIds(Items) : FInventoryContent::FMaxStackSizes());
+
+	return ParallelModifyContents(Inventories, [&](int32 InventoryIndex, FInventoryContent& Content, FInventoryContent::FContentModifications& OutModifications)
+	{
+		FInventoryContent::FItemStacks Stacks(Items);
+		FInventoryContentTransactionRule Rule;
+		return Content.ReceiveStacks(Stacks, Rule, MaxStackSizes[InventoryIndex], OutModifications);
+	});
+}
+
+int32 USlotInventoryComponentBase::BulkRemoveItem(const TArray<USlotInventoryComponentBase*>& Inventories, FName Item)
+{
+	return ParallelModifyContents(Inventories, [Item](int32 InventoryIndex, FInventoryContent& Content, FInventoryContent::FContentModifications& OutModifications)
+	{
+		Content.ForEachStoredSlot([Item, &OutModifications](int32 SlotIndex, FInventorySlot& Slot)
+		{
+			if (Slot.Item == Item && !Slot.IsEmpty())
+			{
+				Slot.Reset();
+				OutModifications.ModifiedSlots.Add(SlotIndex);
+				OutModifications.bCreatedEmptySlot = true;
+			}
+		});
+		INC_DWORD_STAT_BY(STAT_SlotInventory_SlotsScanned, Content.GetStoredSlotCount());
+		return !OutModifications.ModifiedSlots.IsEmpty();
+	});
+}
+
+
+/** Persistence */
+
+uint32 USlotInventoryComponentBase::GetContentRevision() const
+{
+	return ContentRevision;
+}
+
+bool USlotInventoryComponentBase::HasUnsavedChanges() const
+{
+	return ContentRevision != SavedContentRevision;
+}
+
+void USlotInventoryComponentBase::MarkContentSaved(uint32 SavedRevision)
+{
+	SavedContentRevision = SavedRevision;
+}
+
+void USlotInventoryComponentBase::SetTrackUnsavedSlots(bool bTrack)
+{
+	bTrackUnsavedSlots = bTrack;
+	if (!bTrack)
+	{
+		UnsavedSlots.Empty();
+		UnsavedMinCapacity = INDEX_NONE;
+	}
+}
+
+void USlotInventoryComponentBase::TakeUnsavedSlots(TSet<int32>& OutSlots, int32& OutMinCapacity)
+{
+	OutSlots = MoveTemp(UnsavedSlots);
+	UnsavedSlots.Reset();
+	OutMinCapacity = UnsavedMinCapacity;
+	UnsavedMinCapacity = INDEX_NONE;
+}
+
+
+/** Snapshots */
+
+TSharedRef<FInventoryContentSnapshotChannel, ESPMode::ThreadSafe> USlotInventoryComponentBase::GetSnapshotChannel()
+{
+	check(IsInGameThread());
+
+	EnsureContentHydrated();
+
+	if (!SnapshotChannel.IsValid())
+	{
+		SnapshotChannel = MakeShared<FInventoryContentSnapshotChannel, ESPMode::ThreadSafe>();
+		SnapshotChannel->PublishFull(Content, ContentRevision);
+	}
+	return SnapshotChannel.ToSharedRef();
+}
+
+
+/** Memory */
+
+FSlotInventoryMemoryUsage USlotInventoryComponentBase::GetMemoryUsage() const
+{
+	FSlotInventoryMemoryUsage Usage;
+	AccumulateMemoryUsage(Usage);
+	return Usage;
+}
+
+void USlotInventoryComponentBase::AccumulateMemoryUsage(FSlotInventoryMemoryUsage& Usage) const
+{
+	Content.AccumulateMemoryUsage(Usage);
+	Usage.Dehydrated += DehydratedContent.GetAllocatedSize();
+	Usage.Slack += DehydratedContent.GetAllocatedSize() - DehydratedContent.Num();
+
+	Usage.Tracking += DirtySlots.GetAllocatedSize() + UnsavedSlots.GetAllocatedSize();
+	Usage.Tracking += BroadcastSlotValues.GetAllocatedSize();
+	Usage.Slack += (BroadcastSlotValues.Max() - BroadcastSlotValues.Num()) * sizeof(TPair<FName, int32>);
+	Usage.Tracking += SlotChanges.GetAllocatedSize();
+	Usage.Slack += (SlotChanges.Max() - SlotChanges.Num()) * sizeof(FInventorySlotChange);
+	Usage.Tracking += ChangedSlotsScratch.GetAllocatedSize() + EvictedSlotsScratch.GetAllocatedSize();
+	Usage.Slack += ChangedSlotsScratch.GetAllocatedSize() + EvictedSlotsScratch.GetAllocatedSize();
+	if (DirtySlots.IsEmpty())
+		Usage.Slack += DirtySlots.GetAllocatedSize();
+}
+
+void USlotInventoryComponentBase::CompactMemory()
+{
+	SLOTINVENTORY_SCOPE_CYCLE_COUNTER(CompactMemory);
+
+	Content.Compact();
+	DehydratedContent.Shrink();
+
+	/** Dirty slots are still pending while a content update is scheduled */
+	if (DirtySlots.IsEmpty())
+		DirtySlots.Empty();
+	else
+		DirtySlots.Shrink();
+
+	BroadcastSlotValues.Shrink();
+	SlotChanges.Empty();
+	ChangedSlotsScratch.Empty();
+	EvictedSlotsScratch.Empty();
+
+	CompactedContentRevision = ContentRevision;
+}
+
+bool USlotInventoryComponentBase::ShouldCompactMemory(double IdleSeconds) const
+{
+	return CompactedContentRevision != ContentRevision
+		&& DirtySlots.IsEmpty()
+		&& FPlatformTime::Seconds() - LastContentUpdateSeconds >= IdleSeconds;
+}
+
+
+/** Hydration */
+
+bool USlotInventoryComponentBase::IsContentHydrated() const
+{
+	return bContentHydrated;
+}
+
+void USlotInventoryComponentBase::EnsureContentHydrated() const
+{
+	LastContentAccessTime = FApp::GetCurrentTime();
+
+	/** Hydration does not change the content as seen from outside */
+	if (!bContentHydrated)
+		const_cast<USlotInventoryComponentBase*>(this)->HydrateContent();
+}
+
+void USlotInventoryComponentBase::HydrateContent()
+{
+	SLOTINVENTORY_SCOPE_CYCLE_COUNTER(HydrateContent);
+	INC_DWORD_STAT(STAT_SlotInventory_Hydrations);
+	check(IsInGameThread());
+
+	/** Set first, the generation may use the content functions */
+	bContentHydrated = true;
+
+	FInventoryContent HydratedContent;
+	if (!DehydratedContent.IsEmpty())
+	{
+		ensureMsgf(FSlotInventoryAsyncSave::DeserializeContent(DehydratedContent, HydratedContent),
+			TEXT("Failed to hydrate the content of %s"), *GetPathName());
+	}
+	else
+	{
+		HydratedContent.SetCapacity(Content.GetCapacity());
+		GenerateLazyContent(LootSeed, HydratedContent);
+	}
+
+	HydratedContent.SetSparse(bSparseContent);
+	Content = MoveTemp(HydratedContent);
+	DehydratedContent.Empty();
+
+	if (bTrackSlotChanges)
+		ResetBroadcastSlotValues();
+}
+
+void USlotInventoryComponentBase::GenerateLazyContent_Implementation(int32 Seed, FInventoryContent& OutContent)
+{
+}
+
+bool USlotInventoryComponentBase::DehydrateContent()
+{
+	if (!bContentHydrated)
+		return true;
+
+	/** Pending updates, maintenance and delta saves would hydrate it again right away */
+	if (!DirtySlots.IsEmpty() || !UnsavedSlots.IsEmpty() || IsViewLocked() || bMaintenanceQueued)
+		return false;
+
+	SLOTINVENTORY_SCOPE_CYCLE_COUNTER(DehydrateContent);
+
+	/** Every property is kept, hydrating must give back the exact content */
+	if (!FSlotInventoryAsyncSave::SerializeContent(Content, DehydratedContent, false))
+		return false;
+
+	Content = FInventoryContent();
+	Content.SetSparse(bSparseContent);
+	bContentHydrated = false;
+
+	INC_DWORD_STAT(STAT_SlotInventory_Dehydrations);
+	return true;
+}
+
+bool USlotInventoryComponentBase::ShouldDehydrateContent() const
+{
+	/** Clients keep what the server sent them */
+	return bLazyContent
+		&& bContentHydrated
+		&& DehydrateIdleSeconds > 0.0f
+		&& GetOwnerRole() == ROLE_Authority
+		&& FApp::GetCurrentTime() - LastContentAccessTime >= DehydrateIdleSeconds;
+}
+
+const TArray<uint8>& USlotInventoryComponentBase::GetDehydratedContent() const
+{
+	return DehydratedContent;
+}
+
+
+/** Background Maintenance */
+
+void USlotInventoryComponentBase::AcquireViewLock()
+{
+	ViewLockCount++;
+}
+
+void USlotInventoryComponentBase::ReleaseViewLock()
+{
+	if (ViewLockCount == 0)
+		return;
+
+	if (--ViewLockCount == 0)
+		QueueBackgroundMaintenance();
+}
+
+bool USlotInventoryComponentBase::IsViewLocked() const
+{
+	return ViewLockCount > 0;
+}
+
+void USlotInventoryComponentBase::QueueBackgroundMaintenance()
+{
+	if (!bBackgroundAutoStack || bMaintenanceQueued || IsViewLocked() || MaintainedContentRevision == ContentRevision)
+		return;
+
+	/** Clients receive the result from the server */
+	if (GetOwnerRole() != ROLE_Authority || !HasBegunPlay())
+		return;
+
+	if (USlotInventorySubsystem* Subsystem = GetWorld()->GetSubsystem<USlotInventorySubsystem>())
+	{
+		Subsystem->QueueMaintenance(this);
+		bMaintenanceQueued = true;
+	}
+}
+
+bool USlotInventoryComponentBase::RunBackgroundMaintenance(double EndSeconds)
+{
+	if (!bBackgroundAutoStack || !bContentHydrated || IsViewLocked() || MaintainedContentRevision == ContentRevision)
+	{
+		bMaintenanceQueued = false;
+		return true;
+	}
+
+	SLOTINVENTORY_SCOPE_CYCLE_COUNTER(BackgroundMaintenance);
+
+	/** Modified since the last step, the slots before the cursor may not be maintained anymore */
+	if (MaintenanceStepRevision != ContentRevision)
+	{
+		MaintenanceCursor = 0;
+		MaintenanceReadCursor = 0;
+		bMaintenanceCompacting = false;
+	}
+
+	FInventoryContent::FContentModifications Modifications;
+	const int32 Capacity = Content.GetCapacity();
+	bool bDone = false;
+	do
+	{
+		if (MaintenanceCursor >= Capacity)
+		{
+			if (!bMaintenanceCompacting && bBackgroundCompactToFront)
+			{
+				bMaintenanceCompacting = true;
+				MaintenanceCursor = 0;
+				MaintenanceReadCursor = 0;
+				continue;
+			}
+			bDone = true;
+			break;
+		}
+
+		if (bMaintenanceCompacting)
+		{
+			Content.MoveNextSlotToIndex(MaintenanceCursor, MaintenanceReadCursor, Modifications);
+		}
+		else if (const FInventorySlot* Slot = Content.GetSlotConstPtrAtIndex(MaintenanceCursor); !Slot->IsEmpty())
+		{
+			Content.MergeFollowingStacksAtIndex(MaintenanceCursor, Modifications, GetMaxStackSizeForID(Slot->Item));
+		}
+		MaintenanceCursor++;
+	}
+	while (FPlatformTime::Seconds() < EndSeconds);
+
+	if (!Modifications.ModifiedSlots.IsEmpty())
+	{
+		INC_DWORD_STAT_BY(STAT_SlotInventory_MaintenanceSlotsModified, Modifications.ModifiedSlots.Num());
+
+		if (FSlotInventoryJournal* Journal = FSlotInventoryJournal::GetRecording())
+			Journal->RecordSlotValues(this, Modifications.ModifiedSlots.Array());
+
+		for (int32 ModifiedSlotIndex : Modifications.ModifiedSlots)
+			MarkDirtySlot(ModifiedSlotIndex);
+	}
+	MaintenanceStepRevision = ContentRevision;
+
+	if (!bDone)
+		return false;
+
+	MaintainedContentRevision = ContentRevision;
+	MaintenanceCursor = 0;
+	MaintenanceReadCursor = 0;
+	bMaintenanceCompacting = false;
+	bMaintenanceQueued = false;
+	return true;
+}
+
+
 /** Private Content Management */
 
-const TMap<FName, int32> USlotInventoryComponentBase::GetMaxStackSizesFromIds(const TMap<FName, int32>& IdsAndCounts) const
+FInventoryContent::FMaxStackSizes USlotInventoryComponentBase::GetMaxStackSizesFromIds(const TMap<FName, int32>& IdsAndCounts) const
 {
-	TSet<FName> Ids;
-	IdsAndCounts.GetKeys(Ids);
-	TMap<FName, int32> MaxStackSizes;
-	GetMaxStackSizeForIds(Ids, MaxStackSizes);
+	FInventoryContent::FMaxStackSizes MaxStackSizes;
+	for (const auto& [Id, Count] : IdsAndCounts)
+		MaxStackSizes.Add(Id, GetMaxStackSizeForID(Id));
 	return MaxStackSizes;
 }
 
@@ -290,18 +961,147 @@ const TMap<FName, int32> USlotInventoryComponentBase::GetMaxStackSizesFromIds(co
 
 void USlotInventoryComponentBase::BroadcastContentUpdate()
 {
-	OnInventoryContentChanged.Broadcast(this, DirtySlots.Array());
+	INC_DWORD_STAT(STAT_SlotInventory_Flushes);
+	LastContentUpdateSeconds = FPlatformTime::Seconds();
+
+	Content.ReleaseEmptyPages(DirtySlots);
+
+	if (SnapshotChannel.IsValid())
+		SnapshotChannel->Publish(Content, DirtySlots, ContentRevision);
+
+	if (bTrackSlotChanges)
+		BroadcastSlotChanges();
+
+	if (OnInventoryContentChanged.IsBound() || OnInventorySlotsEvicted.IsBound())
+	{
+		SLOTINVENTORY_SCOPE_CYCLE_COUNTER(OnInventoryContentChanged);
+
+		/** Evicted slots that came back with a grow are empty slots of the content, possibly dirty as well */
+		const int32 Capacity = Content.GetCapacity();
+		ChangedSlotsScratch.Reset();
+		EvictedSlotsScratch.Reset();
+		for (int32 SlotIndex : DirtySlots)
+			ChangedSlotsScratch.Add(SlotIndex);
+		for (int32 SlotIndex : EvictedSlotsSinceUpdate)
+		{
+			if (SlotIndex >= Capacity)
+				EvictedSlotsScratch.Add(SlotIndex);
+			else if (!DirtySlots.Contains(SlotIndex))
+				ChangedSlotsScratch.Add(SlotIndex);
+		}
+		OnInventoryContentChanged.Broadcast(this, ChangedSlotsScratch);
+		if (!EvictedSlotsScratch.IsEmpty())
+			OnInventorySlotsEvicted.Broadcast(this, EvictedSlotsScratch);
+	}
 	DirtySlots.Reset();
+	EvictedSlotsSinceUpdate.Reset();
+	MinCapacitySinceUpdate = INDEX_NONE;
+
+	QueueBackgroundMaintenance();
+}
+
+static TPair<FName, int32> GetBroadcastSlotValue(const FInventorySlot& Slot)
+{
+	if (Slot.IsEmpty())
+		return TPair<FName, int32>(NAME_None, 0);
+	return TPair<FName, int32>(Slot.Item, Slot.Quantity);
+}
+
+FOnInventorySlotsChangedNative& USlotInventoryComponentBase::OnInventorySlotsChanged()
+{
+	if (!bTrackSlotChanges)
+	{
+		bTrackSlotChanges = true;
+
+		/** Binding does not hydrate, the values are read once the content is */
+		if (bContentHydrated)
+			ResetBroadcastSlotValues();
+	}
+	return OnInventorySlotsChangedNative;
+}
+
+void USlotInventoryComponentBase::ResetBroadcastSlotValues()
+{
+	/** A zeroed value is an empty slot */
+	BroadcastCapacity = Content.GetCapacity();
+	BroadcastSlotValues.Reset();
+	BroadcastSlotValues.SetNumZeroed(BroadcastCapacity);
+	Content.ForEachStoredSlot([this](int32 SlotIndex, const FInventorySlot& Slot)
+	{
+		BroadcastSlotValues[SlotIndex] = GetBroadcastSlotValue(Slot);
+	});
+}
+
+void USlotInventoryComponentBase::BroadcastSlotChanges()
+{
+	SLOTINVENTORY_SCOPE_CYCLE_COUNTER(OnInventorySlotsChanged);
+
+	const int32 Capacity = Content.GetCapacity();
+
+	/** Grown slots start empty, the evicted ones are dropped once reported below */
+	if (BroadcastSlotValues.Num() < Capacity)
+		BroadcastSlotValues.SetNumZeroed(Capacity, false);
+
+	SlotChanges.Reset();
+	for (int32 SlotIndex : DirtySlots)
+	{
+		const FInventorySlot* Slot = Content.GetSlotConstPtrAtIndex(SlotIndex);
+		if (Slot == nullptr)
+			continue;
+
+		TPair<FName, int32>& BroadcastValue = BroadcastSlotValues[SlotIndex];
+		FInventorySlotChange& Change = SlotChanges.AddDefaulted_GetRef();
+		Change.Index = SlotIndex;
+		Change.PreviousItem = BroadcastValue.Key;
+		Change.PreviousQuantity = BroadcastValue.Value;
+
+		BroadcastValue = GetBroadcastSlotValue(*Slot);
+		Change.NewItem = BroadcastValue.Key;
+		Change.NewQuantity = BroadcastValue.Value;
+	}
+
+	/**
+	 * Evicted slots are reported emptied, and start empty if the capacity grows again.
+	 * A shrink then grow before the update also emptied the slots above the lowest capacity.
+	 */
+	const int32 MinCapacity = MinCapacitySinceUpdate != INDEX_NONE ? FMath::Min(MinCapacitySinceUpdate, Capacity) : Capacity;
+	for (int32 SlotIndex = MinCapacity; SlotIndex < BroadcastCapacity; SlotIndex++)
+	{
+		/** Dirty slots were reported above with their new value */
+		TPair<FName, int32>& BroadcastValue = BroadcastSlotValues[SlotIndex];
+		if (BroadcastValue.Value == 0 || (SlotIndex < Capacity && DirtySlots.Contains(SlotIndex)))
+			continue;
+
+		FInventorySlotChange& Change = SlotChanges.AddDefaulted_GetRef();
+		Change.Index = SlotIndex;
+		Change.PreviousItem = BroadcastValue.Key;
+		Change.PreviousQuantity = BroadcastValue.Value;
+		BroadcastValue = TPair<FName, int32>(NAME_None, 0);
+	}
+	BroadcastSlotValues.SetNum(Capacity, false);
+	BroadcastCapacity = Capacity;
+
+	if (!SlotChanges.IsEmpty())
+		OnInventorySlotsChangedNative.Broadcast(this, SlotChanges);
 }
 
 void USlotInventoryComponentBase::MarkDirtySlot(int32 SlotIndex)
 {
 	checkf(Content.IsValidIndex(SlotIndex), TEXT("MarkDirtySlot recieve invalid SlotIndex"));
-	DirtySlots.Add(SlotIndex);
+	bool bAlreadyDirty = false;
+	DirtySlots.Add(SlotIndex, &bAlreadyDirty);
+	if (!bAlreadyDirty)
+		INC_DWORD_STAT(STAT_SlotInventory_SlotsDirtied);
+	if (bTrackUnsavedSlots)
+		UnsavedSlots.Add(SlotIndex);
+	ContentRevision++;
 	MarkSlotsHaveBeenModified();
 }
 
 void USlotInventoryComponentBase::MarkSlotsHaveBeenModified()
 {
-	SetComponentTickEnabled(true);
+	if (FSlotInventoryBatchEditScope::IsBatching())
+		FSlotInventoryBatchEditScope::AddModifiedInventory(this);
+	else
+		SetComponentTickEnabled(true);
 }
@@ -0,0 +1,230 @@
+// Amasson
+
+
+#include "Crafting/SlotInventoryCraftabilityEvaluator.h"
+#include "Math/VectorRegister.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+
+static constexpr int32 NumDoublesPerRegister = 4;
+
+
+/** Recipes */
+
+void FSlotInventoryCraftabilityEvaluator::Compile(TConstArrayView<FSlotInventoryRecipe> Recipes)
+{
+    ItemColumns.Reset();
+    for (const FSlotInventoryRecipe& Recipe : Recipes)
+    {
+        for (const auto& [Item, Quantity] : Recipe.Ingredients)
+        {
+            if (Quantity > 0 && !ItemColumns.Contains(Item))
+                ItemColumns.Add(Item, ItemColumns.Num());
+        }
+    }
+
+    NumColumns = FMath::Max(Align(ItemColumns.Num(), NumDoublesPerRegister), NumDoublesPerRegister);
+
+    Needs.Reset();
+    Needs.SetNumZeroed(Recipes.Num() * NumColumns);
+    RecipesByColumn.Reset();
+    RecipesByColumn.SetNum(NumColumns);
+
+    for (int32 RecipeIndex = 0; RecipeIndex < Recipes.Num(); RecipeIndex++)
+    {
+        double* Row = Needs.GetData() + RecipeIndex * NumColumns;
+        for (const auto& [Item, Quantity] : Recipes[RecipeIndex].Ingredients)
+        {
+            if (Quantity <= 0)
+                continue;
+
+            const int32 Column = ItemColumns[Item];
+            Row[Column] += Quantity;
+            RecipesByColumn[Column].AddUnique(RecipeIndex);
+        }
+    }
+
+    Quantities.Reset();
+    Quantities.SetNumZeroed(NumColumns);
+    EvaluatedQuantities.Reset();
+    EvaluatedQuantities.Init(0.5, NumColumns);
+    ChangedColumns.Init(false, NumColumns);
+    CraftableCounts.Reset();
+    CraftableCounts.SetNumZeroed(Recipes.Num());
+
+    /** Sources have to be counted again with the new columns */
+    Sources.Reset();
+}
+
+int32 FSlotInventoryCraftabilityEvaluator::GetNumRecipes() const
+{
+    return CraftableCounts.Num();
+}
+
+
+/** Sources */
+
+int32 FSlotInventoryCraftabilityEvaluator::AddSource(const FInventoryContent& Content)
+{
+    const int32 SourceId = Sources.AddDefaulted();
+    RefreshSource(SourceId, Content);
+    return SourceId;
+}
+
+void FSlotInventoryCraftabilityEvaluator::UpdateSourceSlots(int32 SourceId, const FInventoryContent& Content, TConstArrayView<int32> ChangedSlots)
+{
+    check(Sources.IsValidIndex(SourceId));
+    FSource& Source = Sources[SourceId];
+
+    const int32 Capacity = Content.GetCapacity();
+    if (Source.SlotColumns.Num() != Capacity)
+    {
+        for (int32 SlotIndex = Capacity; SlotIndex < Source.SlotColumns.Num(); SlotIndex++)
+            SetSlotContribution(SourceId, SlotIndex, nullptr);
+
+        const int32 PreviousCapacity = Source.SlotColumns.Num();
+        Source.SlotColumns.SetNum(Capacity);
+        Source.SlotQuantities.SetNum(Capacity);
+        for (int32 SlotIndex = PreviousCapacity; SlotIndex < Capacity; SlotIndex++)
+        {
+            Source.SlotColumns[SlotIndex] = INDEX_NONE;
+            Source.SlotQuantities[SlotIndex] = 0;
+            SetSlotContribution(SourceId, SlotIndex, Content.GetSlotConstPtrAtIndex(SlotIndex));
+        }
+    }
+
+    for (int32 SlotIndex : ChangedSlots)
+        SetSlotContribution(SourceId, SlotIndex, Content.GetSlotConstPtrAtIndex(SlotIndex));
+}
+
+void FSlotInventoryCraftabilityEvaluator::RefreshSource(int32 SourceId, const FInventoryContent& Content)
+{
+    check(Sources.IsValidIndex(SourceId));
+    FSource& Source = Sources[SourceId];
+
+    for (int32 SlotIndex = 0; SlotIndex < Source.SlotColumns.Num(); SlotIndex++)
+        SetSlotContribution(SourceId, SlotIndex, nullptr);
+
+    Source.SlotColumns.Init(INDEX_NONE, Content.GetCapacity());
+    Source.SlotQuantities.Init(0, Content.GetCapacity());
+
+    Content.ForEachStoredSlot([this, SourceId](int32 SlotIndex, const FInventorySlot& Slot)
+    {
+        SetSlotContribution(SourceId, SlotIndex, &Slot);
+    });
+}
+
+void FSlotInventoryCraftabilityEvaluator::RemoveAllSources()
+{
+    Sources.Reset();
+    for (int32 Column = 0; Column < NumColumns; Column++)
+    {
+        if (Quantities[Column] != 0)
+            AddToColumn(Column, -Quantities[Column]);
+    }
+}
+
+int64 FSlotInventoryCraftabilityEvaluator::GetIngredientQuantity(const FName& Item) const
+{
+    const int32* Column = ItemColumns.Find(Item);
+    return Column ? Quantities[*Column] : 0;
+}
+
+void FSlotInventoryCraftabilityEvaluator::SetSlotContribution(int32 SourceId, int32 SlotIndex, const FInventorySlot* Slot)
+{
+    FSource& Source = Sources[SourceId];
+    if (!Source.SlotColumns.IsValidIndex(SlotIndex))
+        return;
+
+    int32 NewColumn = INDEX_NONE;
+    int32 NewQuantity = 0;
+    if (Slot && !Slot->IsEmpty())
+    {
+        if (const int32* Column = ItemColumns.Find(Slot->Item))
+        {
+            NewColumn = *Column;
+            NewQuantity = Slot->Quantity;
+        }
+    }
+
+    int32& OldColumn = Source.SlotColumns[SlotIndex];
+    int32& OldQuantity = Source.SlotQuantities[SlotIndex];
+    if (OldColumn == NewColumn && OldQuantity == NewQuantity)
+        return;
+
+    if (OldColumn != INDEX_NONE)
+        AddToColumn(OldColumn, -OldQuantity);
+    if (NewColumn != INDEX_NONE)
+        AddToColumn(NewColumn, NewQuantity);
+
+    OldColumn = NewColumn;
+    OldQuantity = NewQuantity;
+}
+
+void FSlotInventoryCraftabilityEvaluator::AddToColumn(int32 Column, int64 Quantity)
+{
+    Quantities[Column] += Quantity;
+    EvaluatedQuantities[Column] = FMath::Max<int64>(Quantities[Column], 0) + 0.5;
+    ChangedColumns[Column] = true;
+}
+
+
+/** Evaluation */
+
+const TArray<int32>& FSlotInventoryCraftabilityEvaluator::Evaluate()
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(SlotInventory_EvaluateCraftability);
+
+    for (int32 RecipeIndex = 0; RecipeIndex < CraftableCounts.Num(); RecipeIndex++)
+        CraftableCounts[RecipeIndex] = EvaluateRecipe(RecipeIndex);
+
+    ChangedColumns.Init(false, NumColumns);
+    return CraftableCounts;
+}
+
+const TArray<int32>& FSlotInventoryCraftabilityEvaluator::EvaluateChanged(TArray<int32>* OutChangedRecipes)
+{
+    TRACE_CPUPROFILER_EVENT_SCOPE(SlotInventory_EvaluateCraftability);
+
+    TBitArray<> RecipesToEvaluate(false, CraftableCounts.Num());
+    for (TConstSetBitIterator<> It(ChangedColumns); It; ++It)
+    {
+        for (int32 RecipeIndex : RecipesByColumn[It.GetIndex()])
+            RecipesToEvaluate[RecipeIndex] = true;
+    }
+
+    for (TConstSetBitIterator<> It(RecipesToEvaluate); It; ++It)
+    {
+        const int32 RecipeIndex = It.GetIndex();
+        const int32 CraftableCount = EvaluateRecipe(RecipeIndex);
+        if (CraftableCount != CraftableCounts[RecipeIndex] && OutChangedRecipes)
+            OutChangedRecipes->Add(RecipeIndex);
+        CraftableCounts[RecipeIndex] = CraftableCount;
+    }
+
+    ChangedColumns.Init(false, NumColumns);
+    return CraftableCounts;
+}
+
+const TArray<int32>& FSlotInventoryCraftabilityEvaluator::GetCraftableCounts() const
+{
+    return CraftableCounts;
+}
+
+int32 FSlotInventoryCraftabilityEvaluator::EvaluateRecipe(int32 RecipeIndex) const
+{
+    const double* Row = Needs.GetData() + RecipeIndex * NumColumns;
+    const double* Available = EvaluatedQuantities.GetData();
+
+    /** Non ingredient columns need 0 and divide to +inf, so they never are the minimum */
+    VectorRegister4Double MinRatio = VectorDivide(VectorLoad(Available), VectorLoad(Row));
+    for (int32 Column = NumDoublesPerRegister; Column < NumColumns; Column += NumDoublesPerRegister)
+        MinRatio = VectorMin(MinRatio, VectorDivide(VectorLoad(Available + Column), VectorLoad(Row + Column)));
+
+    double Lanes[NumDoublesPerRegister];
+    VectorStore(MinRatio, Lanes);
+    const double Ratio = FMath::Min(FMath::Min(Lanes[0], Lanes[1]), FMath::Min(Lanes[2], Lanes[3]));
+
+    /** A recipe without ingredient can be crafted without limit */
+    return (int32)FMath::Min<double>(FMath::FloorToDouble(Ratio), MAX_int32);
+}
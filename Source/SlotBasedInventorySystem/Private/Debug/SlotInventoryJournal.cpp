@@ -0,0 +1,747 @@
+// Amasson
+
+
+#include "Debug/SlotInventoryJournal.h"
+#include "Components/SlotInventoryComponentBase.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "Serialization/ObjectAndNameAsStringProxyArchive.h"
+
+
+namespace SlotInventoryJournal
+{
+    static constexpr int32 MaxSegments = 8;
+    static constexpr int64 MinSegmentBytes = 4 * 1024;
+
+    static TUniquePtr<FSlotInventoryJournal> RecordingJournal;
+
+    /** Names are written as a string the first time they appear in a segment, then as an index */
+    class FJournalArchive : public FObjectAndNameAsStringProxyArchive
+    {
+    public:
+
+        FJournalArchive(FArchive& InInnerArchive, TMap<FName, int32>* InNameIndices, TArray<FName>* InNames)
+            : FObjectAndNameAsStringProxyArchive(InInnerArchive, true)
+            , NameIndices(InNameIndices)
+            , Names(InNames)
+        {
+            ArIsSaveGame = true;
+        }
+
+        virtual FArchive& operator<<(FName& Name) override
+        {
+            if (IsSaving())
+            {
+                int32 Index = INDEX_NONE;
+                if (const int32* FoundIndex = NameIndices->Find(Name))
+                {
+                    Index = *FoundIndex;
+                    InnerArchive << Index;
+                    return *this;
+                }
+                InnerArchive << Index;
+                FString NameString = Name.ToString();
+                InnerArchive << NameString;
+                NameIndices->Add(Name, NameIndices->Num());
+                return *this;
+            }
+
+            int32 Index = INDEX_NONE;
+            InnerArchive << Index;
+            if (Index == INDEX_NONE)
+            {
+                FString NameString;
+                InnerArchive << NameString;
+                Name = FName(*NameString);
+                Names->Add(Name);
+            }
+            else
+            {
+                Name = Names->IsValidIndex(Index) ? (*Names)[Index] : NAME_None;
+            }
+            return *this;
+        }
+
+    private:
+
+        TMap<FName, int32>* NameIndices;
+        TArray<FName>* Names;
+    };
+
+    static void SerializeSlot(FJournalArchive& Ar, FInventorySlot& Slot)
+    {
+        FInventorySlot::StaticStruct()->SerializeItem(Ar, &Slot, nullptr);
+    }
+
+    static FString GetInventoryName(const USlotInventoryComponentBase* Inventory)
+    {
+        const AActor* Owner = Inventory->GetOwner();
+        return Owner ? FString::Printf(TEXT("%s.%s"), *Owner->GetName(), *Inventory->GetName()) : Inventory->GetName();
+    }
+}
+
+const TCHAR* LexToString(ESlotInventoryJournalOp Op)
+{
+    switch (Op)
+    {
+    case ESlotInventoryJournalOp::Snapshot: return TEXT("Snapshot");
+    case ESlotInventoryJournalOp::StateHash: return TEXT("StateHash");
+    case ESlotInventoryJournalOp::SetCapacity: return TEXT("SetCapacity");
+    case ESlotInventoryJournalOp::SetSlot: return TEXT("SetSlot");
+    case ESlotInventoryJournalOp::ClearSlot: return TEXT("ClearSlot");
+    case ESlotInventoryJournalOp::ModifySlotQuantity: return TEXT("ModifySlotQuantity");
+    case ESlotInventoryJournalOp::AddModifier: return TEXT("AddModifier");
+    case ESlotInventoryJournalOp::ModifyContent: return TEXT("ModifyContent");
+    case ESlotInventoryJournalOp::TryModifyContent: return TEXT("TryModifyContent");
+    case ESlotInventoryJournalOp::DropSlotAtIndex: return TEXT("DropSlotAtIndex");
+    case ESlotInventoryJournalOp::DropSlot: return TEXT("DropSlot");
+    case ESlotInventoryJournalOp::RegroupSimilarItems: return TEXT("RegroupSimilarItems");
+    case ESlotInventoryJournalOp::DropSlotAmount: return TEXT("DropSlotAmount");
+    default: return TEXT("Unknown");
+    }
+}
+
+
+/** Recording */
+
+FSlotInventoryJournal::FSlotInventoryJournal(int64 InMaxBytes)
+    : MaxBytes(InMaxBytes)
+    , SegmentBytes(FMath::Max(InMaxBytes / SlotInventoryJournal::MaxSegments, SlotInventoryJournal::MinSegmentBytes))
+{
+}
+
+FSlotInventoryJournal* FSlotInventoryJournal::GetRecording()
+{
+    return SlotInventoryJournal::RecordingJournal.Get();
+}
+
+void FSlotInventoryJournal::StartRecording(int64 MaxBytes)
+{
+    check(IsInGameThread());
+    SlotInventoryJournal::RecordingJournal = TUniquePtr<FSlotInventoryJournal>(new FSlotInventoryJournal(MaxBytes));
+}
+
+void FSlotInventoryJournal::StopRecording()
+{
+    check(IsInGameThread());
+    SlotInventoryJournal::RecordingJournal.Reset();
+}
+
+uint32 FSlotInventoryJournal::HashContent(const FInventoryContent& Content)
+{
+    /** Names are hashed by string, their indices differ between processes */
+    uint32 Hash = GetTypeHash(Content.GetCapacity());
+    Content.ForEachStoredSlot([&Hash](int32 SlotIndex, const FInventorySlot& Slot)
+    {
+        if (Slot.IsEmpty())
+            return;
+
+        Hash = HashCombine(Hash, GetTypeHash(SlotIndex));
+        Hash = HashCombine(Hash, FCrc::StrCrc32(*Slot.Item.ToString()));
+        Hash = HashCombine(Hash, GetTypeHash(Slot.Quantity));
+        for (const FItemModifier& Modifier : Slot.Modifiers)
+            Hash = HashCombine(Hash, FCrc::StrCrc32(*Modifier.Type.ToString()));
+    });
+    return Hash;
+}
+
+template<typename FunctionType>
+void FSlotInventoryJournal::Record(ESlotInventoryJournalOp Op, USlotInventoryComponentBase* Inventory, USlotInventoryComponentBase* OtherInventory, FunctionType&& WritePayload)
+{
+    check(IsInGameThread());
+
+    if (!IsValid(Inventory))
+        return;
+
+    FSegment& Segment = GetRecordSegment();
+
+    uint32 InventoryId = GetInventoryId(Inventory);
+    EnsureSnapshot(Segment, Inventory, InventoryId);
+    if (IsValid(OtherInventory))
+        EnsureSnapshot(Segment, OtherInventory, GetInventoryId(OtherInventory));
+
+    FMemoryWriter Writer(Segment.Bytes, true, true);
+    SlotInventoryJournal::FJournalArchive Ar(Writer, &Segment.NameIndices, nullptr);
+
+    uint8 OpValue = (uint8)Op;
+    Ar << OpValue << InventoryId;
+    WritePayload(Ar);
+    NumRecords++;
+}
+
+FSlotInventoryJournal::FSegment& FSlotInventoryJournal::GetRecordSegment()
+{
+    if (Segments.IsEmpty() || Segments.Last().Bytes.Num() >= SegmentBytes)
+    {
+        if (Segments.Num() >= SlotInventoryJournal::MaxSegments)
+            Segments.RemoveAt(0);
+
+        Segments.AddDefaulted_GetRef().Bytes.Reserve(SegmentBytes);
+    }
+    return Segments.Last();
+}
+
+uint32 FSlotInventoryJournal::GetInventoryId(USlotInventoryComponentBase* Inventory)
+{
+    if (const uint32* InventoryId = InventoryIds.Find(Inventory))
+        return *InventoryId;
+
+    const uint32 NewInventoryId = Inventories.Add(Inventory);
+    InventoryIds.Add(Inventory, NewInventoryId);
+    return NewInventoryId;
+}
+
+void FSlotInventoryJournal::EnsureSnapshot(FSegment& Segment, USlotInventoryComponentBase* Inventory, uint32 InventoryId)
+{
+    bool bAlreadyInSegment = false;
+    Segment.SnapshotInventories.Add(InventoryId, &bAlreadyInSegment);
+    if (bAlreadyInSegment)
+        return;
+
+    FMemoryWriter Writer(Segment.Bytes, true, true);
+    SlotInventoryJournal::FJournalArchive Ar(Writer, &Segment.NameIndices, nullptr);
+
+    uint8 OpValue = (uint8)ESlotInventoryJournalOp::Snapshot;
+    FString InventoryName = SlotInventoryJournal::GetInventoryName(Inventory);
+    Ar << OpValue << InventoryId << InventoryName;
+    FInventoryContent::StaticStruct()->SerializeItem(Ar, const_cast<FInventoryContent*>(&Inventory->GetContent()), nullptr);
+}
+
+void FSlotInventoryJournal::RecordSetCapacity(USlotInventoryComponentBase* Inventory, int32 NewCapacity)
+{
+    Record(ESlotInventoryJournalOp::SetCapacity, Inventory, nullptr, [NewCapacity](SlotInventoryJournal::FJournalArchive& Ar) mutable
+    {
+        Ar << NewCapacity;
+    });
+}
+
+void FSlotInventoryJournal::RecordSetSlot(USlotInventoryComponentBase* Inventory, int32 Index, const FInventorySlot& Value)
+{
+    Record(ESlotInventoryJournalOp::SetSlot, Inventory, nullptr, [Index, &Value](SlotInventoryJournal::FJournalArchive& Ar) mutable
+    {
+        Ar << Index;
+        SlotInventoryJournal::SerializeSlot(Ar, const_cast<FInventorySlot&>(Value));
+    });
+}
+
+void FSlotInventoryJournal::RecordClearSlot(USlotInventoryComponentBase* Inventory, int32 Index)
+{
+    Record(ESlotInventoryJournalOp::ClearSlot, Inventory, nullptr, [Index](SlotInventoryJournal::FJournalArchive& Ar) mutable
+    {
+        Ar << Index;
+    });
+}
+
+void FSlotInventoryJournal::RecordModifySlotQuantity(USlotInventoryComponentBase* Inventory, int32 Index, int32 ModifyAmount, bool bAllOrNothing)
+{
+    if (!IsValid(Inventory))
+        return;
+
+    const FInventorySlot* Slot = Inventory->GetContent().GetSlotConstPtrAtIndex(Index);
+    int32 MaxStackSize = Slot ? Inventory->GetMaxStackSizeForID(Slot->Item) : 0;
+
+    Record(ESlotInventoryJournalOp::ModifySlotQuantity, Inventory, nullptr, [=](SlotInventoryJournal::FJournalArchive& Ar) mutable
+    {
+        Ar << Index << ModifyAmount << bAllOrNothing << MaxStackSize;
+    });
+}
+
+void FSlotInventoryJournal::RecordAddModifier(USlotInventoryComponentBase* Inventory, int32 Index, const FItemModifier& Modifier)
+{
+    Record(ESlotInventoryJournalOp::AddModifier, Inventory, nullptr, [Index, &Modifier](SlotInventoryJournal::FJournalArchive& Ar) mutable
+    {
+        Ar << Index;
+        FItemModifier::StaticStruct()->SerializeItem(Ar, const_cast<FItemModifier*>(&Modifier), nullptr);
+    });
+}
+
+void FSlotInventoryJournal::RecordModifyContent(USlotInventoryComponentBase* Inventory, const TMap<FName, int32>& Items, bool bWithoutOverflow)
+{
+    const ESlotInventoryJournalOp Op = bWithoutOverflow ? ESlotInventoryJournalOp::TryModifyContent : ESlotInventoryJournalOp::ModifyContent;
+    Record(Op, Inventory, nullptr, [Inventory, &Items](SlotInventoryJournal::FJournalArchive& Ar)
+    {
+        int32 NumItems = Items.Num();
+        Ar << NumItems;
+        for (const auto& [Item, Quantity] : Items)
+        {
+            FName ItemName = Item;
+            int32 ItemQuantity = Quantity;
+            int32 MaxStackSize = Inventory->GetMaxStackSizeForID(Item);
+            Ar << ItemName << ItemQuantity << MaxStackSize;
+        }
+    });
+}
+
+void FSlotInventoryJournal::RecordDropSlotAtIndex(USlotInventoryComponentBase* Source, int32 SourceIndex, USlotInventoryComponentBase* Destination, int32 DestinationIndex, int32 MaxAmount)
+{
+    if (!IsValid(Source) || !IsValid(Destination))
+        return;
+
+    const FInventorySlot* SourceSlot = Source->GetContent().GetSlotConstPtrAtIndex(SourceIndex);
+    int32 MaxStackSize = SourceSlot ? Destination->GetMaxStackSizeForID(SourceSlot->Item) : 0;
+    uint32 DestinationId = GetInventoryId(Destination);
+
+    Record(ESlotInventoryJournalOp::DropSlotAtIndex, Source, Destination, [=](SlotInventoryJournal::FJournalArchive& Ar) mutable
+    {
+        Ar << DestinationId << SourceIndex << DestinationIndex << MaxAmount << MaxStackSize;
+    });
+}
+
+void FSlotInventoryJournal::RecordDropSlot(USlotInventoryComponentBase* Source, int32 SourceIndex, USlotInventoryComponentBase* Destination, int32 MaxAmount)
+{
+    if (!IsValid(Source) || !IsValid(Destination))
+        return;
+
+    const FInventorySlot* SourceSlot = Source->GetContent().GetSlotConstPtrAtIndex(SourceIndex);
+    int32 MaxStackSize = SourceSlot ? Destination->GetMaxStackSizeForID(SourceSlot->Item) : 0;
+    uint32 DestinationId = GetInventoryId(Destination);
+
+    /** Whole slot drops keep the record of earlier journals */
+    if (MaxAmount <= 0)
+    {
+        Record(ESlotInventoryJournalOp::DropSlot, Source, Destination, [=](SlotInventoryJournal::FJournalArchive& Ar) mutable
+        {
+            Ar << DestinationId << SourceIndex << MaxStackSize;
+        });
+        return;
+    }
+
+    Record(ESlotInventoryJournalOp::DropSlotAmount, Source, Destination, [=](SlotInventoryJournal::FJournalArchive& Ar) mutable
+    {
+        Ar << DestinationId << SourceIndex << MaxAmount << MaxStackSize;
+    });
+}
+
+void FSlotInventoryJournal::RecordRegroupSimilarItems(USlotInventoryComponentBase* Inventory, int32 Index)
+{
+    if (!IsValid(Inventory))
+        return;
+
+    const FInventorySlot* Slot = Inventory->GetContent().GetSlotConstPtrAtIndex(Index);
+    int32 MaxStackSize = Slot ? Inventory->GetMaxStackSizeForID(Slot->Item) : 0;
+
+    Record(ESlotInventoryJournalOp::RegroupSimilarItems, Inventory, nullptr, [=](SlotInventoryJournal::FJournalArchive& Ar) mutable
+    {
+        Ar << Index << MaxStackSize;
+    });
+}
+
+void FSlotInventoryJournal::RecordSlotValues(USlotInventoryComponentBase* Inventory, TConstArrayView<int32> Indices)
+{
+    if (!IsValid(Inventory))
+        return;
+
+    /** A snapshot taken by the first record already holds the values, setting them again is harmless */
+    for (int32 Index : Indices)
+    {
+        if (const FInventorySlot* Slot = Inventory->GetContent().GetSlotConstPtrAtIndex(Index))
+            RecordSetSlot(Inventory, Index, *Slot);
+    }
+}
+
+bool FSlotInventoryJournal::SaveToFile(const FString& FilePath) const
+{
+    TArray<uint8> FinalHashes;
+    {
+        FMemoryWriter Writer(FinalHashes, true);
+        for (int32 InventoryId = 0; InventoryId < Inventories.Num(); InventoryId++)
+        {
+            const USlotInventoryComponentBase* Inventory = Inventories[InventoryId].Get();
+            if (!IsValid(Inventory))
+                continue;
+
+            uint8 OpValue = (uint8)ESlotInventoryJournalOp::StateHash;
+            uint32 Id = InventoryId;
+            uint32 Hash = HashContent(Inventory->GetContent());
+            Writer << OpValue << Id << Hash;
+        }
+    }
+
+    TArray<uint8> FileBytes;
+    FMemoryWriter Writer(FileBytes, true);
+
+    uint32 Magic = FileMagic;
+    uint32 Version = FileVersion;
+    int32 NumSegments = Segments.Num();
+    Writer << Magic << Version << NumSegments;
+    for (const FSegment& Segment : Segments)
+        Writer << const_cast<TArray<uint8>&>(Segment.Bytes);
+    Writer << FinalHashes;
+
+    return !Writer.IsError() && FFileHelper::SaveArrayToFile(FileBytes, *FilePath);
+}
+
+int64 FSlotInventoryJournal::GetRecordedBytes() const
+{
+    int64 Bytes = 0;
+    for (const FSegment& Segment : Segments)
+        Bytes += Segment.Bytes.Num();
+    return Bytes;
+}
+
+
+/** Replay */
+
+struct FSlotInventoryJournalReplayer::FReplayState
+{
+    TMap<uint32, FInventoryContent> Contents;
+    TMap<uint32, FString> Names;
+    int32 RecordNumber = 0;
+};
+
+bool FSlotInventoryJournalReplayer::LoadFromFile(const FString& FilePath)
+{
+    Segments.Reset();
+    FinalHashes.Reset();
+
+    TArray<uint8> FileBytes;
+    if (!FFileHelper::LoadFileToArray(FileBytes, *FilePath))
+        return false;
+
+    FMemoryReader Reader(FileBytes, true);
+
+    uint32 Magic = 0;
+    uint32 Version = 0;
+    int32 NumSegments = 0;
+    Reader << Magic << Version << NumSegments;
+    if (Reader.IsError() || Magic != FSlotInventoryJournal::FileMagic || Version > FSlotInventoryJournal::FileVersion || NumSegments < 0)
+        return false;
+
+    Segments.SetNum(NumSegments);
+    for (TArray<uint8>& Segment : Segments)
+        Reader << Segment;
+    Reader << FinalHashes;
+
+    return !Reader.IsError();
+}
+
+FSlotInventoryReplayReport FSlotInventoryJournalReplayer::Replay() const
+{
+    FSlotInventoryReplayReport Report;
+    FReplayState State;
+
+    const double StartSeconds = FPlatformTime::Seconds();
+    for (const TArray<uint8>& Segment : Segments)
+        ReplaySegment(Segment, State, Report);
+    ReplaySegment(FinalHashes, State, Report);
+    Report.TotalSeconds = FPlatformTime::Seconds() - StartSeconds;
+
+    return Report;
+}
+
+void FSlotInventoryJournalReplayer::ReplaySegment(const TArray<uint8>& Bytes, FReplayState& State, FSlotInventoryReplayReport& Report) const
+{
+    TArray<FName> Names;
+    FMemoryReader Reader(Bytes, true);
+    SlotInventoryJournal::FJournalArchive Ar(Reader, nullptr, &Names);
+
+    auto CheckHash = [&State, &Report](uint32 InventoryId, uint32 ExpectedHash)
+    {
+        const FInventoryContent* Content = State.Contents.Find(InventoryId);
+        if (Content == nullptr)
+            return;
+
+        Report.NumHashChecks++;
+        if (FSlotInventoryJournal::HashContent(*Content) != ExpectedHash)
+            Report.Mismatches.Add(FString::Printf(TEXT("%s diverged before record %d"), *State.Names.FindRef(InventoryId), State.RecordNumber));
+    };
+
+    while (!Ar.AtEnd() && !Ar.IsError())
+    {
+        uint8 OpValue = 0;
+        uint32 InventoryId = 0;
+        Ar << OpValue << InventoryId;
+        const ESlotInventoryJournalOp Op = (ESlotInventoryJournalOp)OpValue;
+        State.RecordNumber++;
+
+        if (Op == ESlotInventoryJournalOp::Snapshot)
+        {
+            FString InventoryName;
+            FInventoryContent Snapshot;
+            Ar << InventoryName;
+            FInventoryContent::StaticStruct()->SerializeItem(Ar, &Snapshot, nullptr);
+
+            /** Later snapshots of an inventory are checkpoints, then resynchronize so one divergence is reported once */
+            CheckHash(InventoryId, FSlotInventoryJournal::HashContent(Snapshot));
+            State.Names.Add(InventoryId, InventoryName);
+            State.Contents.Add(InventoryId, MoveTemp(Snapshot));
+            continue;
+        }
+
+        if (Op == ESlotInventoryJournalOp::StateHash)
+        {
+            uint32 Hash = 0;
+            Ar << Hash;
+            CheckHash(InventoryId, Hash);
+            continue;
+        }
+
+        if (Op >= ESlotInventoryJournalOp::Count)
+        {
+            Report.Mismatches.Add(FString::Printf(TEXT("Unknown record %d, replay stopped"), State.RecordNumber));
+            return;
+        }
+
+        /** Payloads are read first so only the operation is timed */
+        int32 Index = 0;
+        int32 OtherIndex = 0;
+        int32 Amount = 0;
+        int32 MaxStackSize = 0;
+        bool bAllOrNothing = false;
+        uint32 OtherInventoryId = 0;
+        FInventorySlot SlotValue;
+        FItemModifier Modifier;
+        FInventoryContent::FItemStacks Stacks;
+        FInventoryContent::FMaxStackSizes MaxStackSizes;
+
+        switch (Op)
+        {
+        case ESlotInventoryJournalOp::SetCapacity:
+            Ar << Amount;
+            break;
+        case ESlotInventoryJournalOp::SetSlot:
+            Ar << Index;
+            SlotInventoryJournal::SerializeSlot(Ar, SlotValue);
+            break;
+        case ESlotInventoryJournalOp::ClearSlot:
+            Ar << Index;
+            break;
+        case ESlotInventoryJournalOp::ModifySlotQuantity:
+            Ar << Index << Amount << bAllOrNothing << MaxStackSize;
+            break;
+        case ESlotInventoryJournalOp::AddModifier:
+            Ar << Index;
+            FItemModifier::StaticStruct()->SerializeItem(Ar, &Modifier, nullptr);
+            break;
+        case ESlotInventoryJournalOp::ModifyContent:
+        case ESlotInventoryJournalOp::TryModifyContent:
+        {
+            int32 NumItems = 0;
+            Ar << NumItems;
+            for (int32 ItemIndex = 0; ItemIndex < NumItems && !Ar.IsError(); ItemIndex++)
+            {
+                FName Item;
+                int32 Quantity = 0;
+                Ar << Item << Quantity << MaxStackSize;
+                Stacks.Add(Item, Quantity);
+                MaxStackSizes.Add(Item, MaxStackSize);
+            }
+            break;
+        }
+        case ESlotInventoryJournalOp::DropSlotAtIndex:
+            Ar << OtherInventoryId << Index << OtherIndex << Amount << MaxStackSize;
+            break;
+        case ESlotInventoryJournalOp::DropSlot:
+            Ar << OtherInventoryId << Index << MaxStackSize;
+            break;
+        case ESlotInventoryJournalOp::DropSlotAmount:
+            Ar << OtherInventoryId << Index << Amount << MaxStackSize;
+            break;
+        case ESlotInventoryJournalOp::RegroupSimilarItems:
+            Ar << Index << MaxStackSize;
+            break;
+        default:
+            break;
+        }
+
+        FInventoryContent* Content = State.Contents.Find(InventoryId);
+        if (Content == nullptr || Ar.IsError())
+            continue;
+
+        const uint64 StartCycles = FPlatformTime::Cycles64();
+
+        switch (Op)
+        {
+        case ESlotInventoryJournalOp::SetCapacity:
+            Content->SetCapacity(FMath::Max(Amount, 0));
+            break;
+        case ESlotInventoryJournalOp::SetSlot:
+            if (FInventorySlot* Slot = Content->GetSlotPtrAtIndex(Index))
+                *Slot = MoveTemp(SlotValue);
+            break;
+        case ESlotInventoryJournalOp::ClearSlot:
+            if (FInventorySlot* Slot = Content->GetSlotPtrAtIndex(Index))
+                Slot->Reset();
+            break;
+        case ESlotInventoryJournalOp::ModifySlotQuantity:
+        {
+            FInventorySlot* Slot = Content->GetSlotPtrAtIndex(Index);
+            if (Slot && !Slot->IsEmpty() && Slot->Modifiers.IsEmpty())
+            {
+                const FInventorySlotTransactionRule Rule = bAllOrNothing ? FInventorySlotTransactionRule(true, true, false, 0) : FInventorySlotTransactionRule();
+                Slot->ReceiveStack(Slot->Item, Amount, Rule, MaxStackSize);
+            }
+            break;
+        }
+        case ESlotInventoryJournalOp::AddModifier:
+            if (FInventorySlot* Slot = Content->GetSlotPtrAtIndex(Index))
+                Slot->Modifiers.Add(MoveTemp(Modifier));
+            break;
+        case ESlotInventoryJournalOp::ModifyContent:
+        {
+            FInventoryContent::FContentModifications Modifications;
+            Content->ReceiveStacks(Stacks, FInventoryContentTransactionRule(), MaxStackSizes, Modifications);
+            break;
+        }
+        case ESlotInventoryJournalOp::TryModifyContent:
+        {
+            FInventoryContent::FPreviousValues PreviousValues;
+            FInventoryContent::FContentModifications Modifications;
+            Modifications.PreviousValues = &PreviousValues;
+
+            FInventoryContentTransactionRule Rule;
+            Rule.bAtomic = true;
+            bool bSucceeded = Content->ReceiveStacks(Stacks, Rule, MaxStackSizes, Modifications);
+            for (const auto& [Item, QuantityLeft] : Stacks)
+                bSucceeded &= QuantityLeft == 0;
+            if (!bSucceeded)
+                Content->RestorePreviousValues(PreviousValues);
+            break;
+        }
+        case ESlotInventoryJournalOp::DropSlotAtIndex:
+        {
+            FInventoryContent* Destination = State.Contents.Find(OtherInventoryId);
+            FInventorySlot* SourceSlot = Content->GetSlotPtrAtIndex(Index);
+            if (Destination && SourceSlot)
+            {
+                FInventorySlotTransactionRule Rule;
+                Rule.bAllowSwap = true;
+                Rule.MaxTransferQuantity = Amount;
+                Destination->ReceiveSlotAtIndex(*SourceSlot, OtherIndex, Rule, MaxStackSize);
+            }
+            break;
+        }
+        case ESlotInventoryJournalOp::DropSlot:
+        case ESlotInventoryJournalOp::DropSlotAmount:
+        {
+            FInventoryContent* Destination = State.Contents.Find(OtherInventoryId);
+            FInventorySlot* SourceSlot = Content->GetSlotPtrAtIndex(Index);
+            if (Destination && SourceSlot && !SourceSlot->IsEmpty())
+            {
+                FInventoryContent::FContentModifications Modifications;
+                Destination->ReceiveSlotAmount(*SourceSlot, Amount, FInventoryContentTransactionRule(), MaxStackSize, Modifications);
+            }
+            break;
+        }
+        case ESlotInventoryJournalOp::RegroupSimilarItems:
+            if (Content->IsValidIndex(Index))
+            {
+                FInventoryContent::FContentModifications Modifications;
+                Content->RegroupSimilarItemsAtIndex(Index, Modifications, MaxStackSize);
+            }
+            break;
+        default:
+            break;
+        }
+
+        const double Seconds = FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - StartCycles);
+        FSlotInventoryReplayOpStats& OpStats = Report.OpStats[(int32)Op];
+        OpStats.Count++;
+        OpStats.TotalSeconds += Seconds;
+        OpStats.MaxSeconds = FMath::Max(OpStats.MaxSeconds, Seconds);
+        Report.NumOperations++;
+    }
+}
+
+void FSlotInventoryReplayReport::Log(FOutputDevice& Ar) const
+{
+    Ar.Logf(TEXT("Replayed %d operations in %.2f ms, %d hash checks, %d mismatches"),
+        NumOperations, TotalSeconds * 1000.0, NumHashChecks, Mismatches.Num());
+
+    Ar.Logf(TEXT("%-20s %8s %10s %10s %10s"), TEXT("Operation"), TEXT("Count"), TEXT("AvgUs"), TEXT("MaxUs"), TEXT("TotalMs"));
+    for (int32 OpIndex = 0; OpIndex < (int32)ESlotInventoryJournalOp::Count; OpIndex++)
+    {
+        const FSlotInventoryReplayOpStats& Stats = OpStats[OpIndex];
+        if (Stats.Count == 0)
+            continue;
+
+        Ar.Logf(TEXT("%-20s %8d %10.2f %10.2f %10.3f"), LexToString((ESlotInventoryJournalOp)OpIndex), Stats.Count,
+            Stats.TotalSeconds * 1e6 / Stats.Count, Stats.MaxSeconds * 1e6, Stats.TotalSeconds * 1000.0);
+    }
+
+    for (const FString& Mismatch : Mismatches)
+        Ar.Logf(ELogVerbosity::Warning, TEXT("%s"), *Mismatch);
+}
+
+
+/** Console Commands */
+
+static FString GetJournalFilePath(const TArray<FString>& Args)
+{
+    const FString FileName = Args.Num() > 0 ? Args[0] : FString::Printf(TEXT("SlotInventoryJournal-%s.sij"), *FDateTime::Now().ToString());
+    return FPaths::IsRelative(FileName) ? FPaths::ProfilingDir() / TEXT("SlotInventory") / FileName : FileName;
+}
+
+static void StartJournal(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+{
+    const int64 MaxKilobytes = Args.Num() > 0 ? FCString::Atoi64(*Args[0]) : 8 * 1024;
+    FSlotInventoryJournal::StartRecording(FMath::Max<int64>(MaxKilobytes, 1) * 1024);
+    Ar.Logf(TEXT("Recording inventory journal, keeping the last %lld KB"), MaxKilobytes);
+}
+
+static void StopJournal(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+{
+    FSlotInventoryJournal::StopRecording();
+}
+
+static void SaveJournal(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+{
+    const FSlotInventoryJournal* Journal = FSlotInventoryJournal::GetRecording();
+    if (Journal == nullptr)
+    {
+        Ar.Logf(ELogVerbosity::Warning, TEXT("No inventory journal is being recorded"));
+        return;
+    }
+
+    const FString FilePath = GetJournalFilePath(Args);
+    if (Journal->SaveToFile(FilePath))
+        Ar.Logf(TEXT("Saved %d records (%.1f KB) to %s"), Journal->GetNumRecords(), Journal->GetRecordedBytes() / 1024.0, *FilePath);
+    else
+        Ar.Logf(ELogVerbosity::Error, TEXT("Failed to save the inventory journal to %s"), *FilePath);
+}
+
+static void ReplayJournal(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+{
+    if (Args.IsEmpty())
+    {
+        Ar.Logf(ELogVerbosity::Warning, TEXT("Usage: SlotInventory.Journal.Replay <File> [Iterations]"));
+        return;
+    }
+
+    FSlotInventoryJournalReplayer Replayer;
+    const FString FilePath = GetJournalFilePath(Args);
+    if (!Replayer.LoadFromFile(FilePath))
+    {
+        Ar.Logf(ELogVerbosity::Error, TEXT("Failed to load the inventory journal %s"), *FilePath);
+        return;
+    }
+
+    const int32 Iterations = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 1;
+    for (int32 Iteration = 0; Iteration < Iterations; Iteration++)
+        Replayer.Replay().Log(Ar);
+}
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice CmdSlotInventoryJournalStart(
+    TEXT("SlotInventory.Journal.Start"),
+    TEXT("Records the mutations of every inventory. Optional argument: size of the kept journal in KB, 8192 by default."),
+    FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateStatic(&StartJournal));
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice CmdSlotInventoryJournalStop(
+    TEXT("SlotInventory.Journal.Stop"),
+    TEXT("Stops recording the inventory journal and discards it."),
+    FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateStatic(&StopJournal));
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice CmdSlotInventoryJournalSave(
+    TEXT("SlotInventory.Journal.Save"),
+    TEXT("Writes the recorded inventory journal to a file. Optional argument: file name, relative to Saved/Profiling/SlotInventory."),
+    FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateStatic(&SaveJournal));
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice CmdSlotInventoryJournalReplay(
+    TEXT("SlotInventory.Journal.Replay"),
+    TEXT("Replays an inventory journal file, verifies its state hashes and logs the timings of each operation. Arguments: file name, optional number of iterations."),
+    FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateStatic(&ReplayJournal));
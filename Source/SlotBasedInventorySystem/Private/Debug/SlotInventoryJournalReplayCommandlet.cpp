@@ -0,0 +1,36 @@
+// Amasson
+
+
+#include "Debug/SlotInventoryJournalReplayCommandlet.h"
+#include "Debug/SlotInventoryJournal.h"
+#include "Misc/Parse.h"
+
+
+int32 USlotInventoryJournalReplayCommandlet::Main(const FString& Params)
+{
+    FString FilePath;
+    if (!FParse::Value(*Params, TEXT("Journal="), FilePath))
+    {
+        GLog->Logf(ELogVerbosity::Error, TEXT("Missing -Journal=<File>"));
+        return 1;
+    }
+
+    int32 Iterations = 1;
+    FParse::Value(*Params, TEXT("Iterations="), Iterations);
+
+    FSlotInventoryJournalReplayer Replayer;
+    if (!Replayer.LoadFromFile(FilePath))
+    {
+        GLog->Logf(ELogVerbosity::Error, TEXT("Failed to load the inventory journal %s"), *FilePath);
+        return 1;
+    }
+
+    bool bSucceeded = true;
+    for (int32 Iteration = 0; Iteration < FMath::Max(Iterations, 1); Iteration++)
+    {
+        const FSlotInventoryReplayReport Report = Replayer.Replay();
+        Report.Log(*GLog);
+        bSucceeded &= Report.Succeeded();
+    }
+    return bSucceeded ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+// Amasson
+
+
+#include "CoreMinimal.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "Structures/SlotInventoryTransactionKernels.h"
+
+
+namespace SlotInventoryKernelBenchmark
+{
+    static constexpr int32 MaxStackSize = 64;
+
+    /** A mix of empty slots, stacks of the received item, other items and stacks with modifiers */
+    static void MakeSlots(int32 NumSlots, const FName& Item, TArray<FInventorySlot>& OutSlots)
+    {
+        const FName OtherItem(TEXT("SlotInventoryBenchmark_Other"));
+        FRandomStream Random(NumSlots);
+
+        OutSlots.SetNum(NumSlots);
+        for (FInventorySlot& Slot : OutSlots)
+        {
+            const int32 Kind = Random.RandRange(0, 9);
+            if (Kind < 3)
+                continue;
+
+            Slot.Item = Kind < 7 ? Item : OtherItem;
+            Slot.Quantity = Random.RandRange(1, MaxStackSize);
+            if (Kind == 9)
+                Slot.Modifiers.AddDefaulted();
+        }
+    }
+
+    /** One scan of a content receiving a stack larger than what it can hold, so every slot is visited. Returns the leftover. */
+    template<typename PolicyType>
+    static int32 Scan(TArray<FInventorySlot>& Slots, const FName& Item, const PolicyType& Policy)
+    {
+        FInventorySlot Source;
+        Source.Item = Item;
+        Source.Quantity = Slots.Num() * MaxStackSize;
+
+        for (FInventorySlot& Slot : Slots)
+        {
+            int32 Quantity = Source.Quantity;
+            SlotInventoryKernels::ReceiveStack(Slot, Item, Quantity, Policy, MaxStackSize);
+            SlotInventoryKernels::ReceiveSlot(Slot, Source, Policy, MaxStackSize);
+        }
+        return Source.Quantity;
+    }
+
+    static bool AreSameSlots(const TArray<FInventorySlot>& A, const TArray<FInventorySlot>& B)
+    {
+        if (A.Num() != B.Num())
+            return false;
+        for (int32 SlotIndex = 0; SlotIndex < A.Num(); SlotIndex++)
+        {
+            if (A[SlotIndex].Item != B[SlotIndex].Item || A[SlotIndex].Quantity != B[SlotIndex].Quantity || A[SlotIndex].Modifiers.Num() != B[SlotIndex].Modifiers.Num())
+                return false;
+        }
+        return true;
+    }
+
+    /** Time the scans of a content, restored before each iteration */
+    template<typename PolicyType>
+    static double TimeScan(const TArray<FInventorySlot>& SourceSlots, const FName& Item, const PolicyType& Policy, int32 Iterations, int64& InoutChecksum)
+    {
+        TArray<FInventorySlot> Slots;
+        double Seconds = 0.0;
+        for (int32 Iteration = 0; Iteration < Iterations; Iteration++)
+        {
+            Slots = SourceSlots;
+
+            const uint64 StartCycles = FPlatformTime::Cycles64();
+            const int32 Leftover = Scan(Slots, Item, Policy);
+            Seconds += FPlatformTime::ToSeconds64(FPlatformTime::Cycles64() - StartCycles);
+            InoutChecksum += Leftover;
+        }
+        return Seconds;
+    }
+}
+
+static void BenchmarkReceiveKernels(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+{
+    using namespace SlotInventoryKernelBenchmark;
+
+    const int32 NumSlots = Args.Num() > 0 ? FMath::Max(FCString::Atoi(*Args[0]), 1) : 4096;
+    const int32 Iterations = Args.Num() > 1 ? FMath::Max(FCString::Atoi(*Args[1]), 1) : 200;
+
+    const FName Item(TEXT("SlotInventoryBenchmark_Item"));
+    TArray<FInventorySlot> SourceSlots;
+    MakeSlots(NumSlots, Item, SourceSlots);
+
+    int64 Checksum = 0;
+    int32 NumMismatches = 0;
+    Ar.Logf(TEXT("Receive kernels, %d slots, %d iterations"), NumSlots, Iterations);
+    Ar.Logf(TEXT("%-10s %-7s %-10s %-6s %12s %12s %8s"), TEXT("OnlyMerge"), TEXT("Atomic"), TEXT("AllowSwap"), TEXT("Limit"), TEXT("RuntimeMs"), TEXT("PolicyMs"), TEXT("Gain"));
+
+    for (int32 Combination = 0; Combination < 16; Combination++)
+    {
+        FInventorySlotTransactionRule Rule;
+        Rule.bOnlyMerge = (Combination & 1) != 0;
+        Rule.bAtomic = (Combination & 2) != 0;
+        Rule.bAllowSwap = (Combination & 4) != 0;
+        Rule.MaxTransferQuantity = (Combination & 8) != 0 ? MaxStackSize / 2 : 0;
+
+        /** Both paths must leave the same slots and the same leftover before their timings mean anything */
+        TArray<FInventorySlot> RuntimeSlots = SourceSlots;
+        const int32 RuntimeLeftover = Scan(RuntimeSlots, Item, SlotInventoryKernels::FRuntimeSlotTransactionPolicy(Rule));
+        TArray<FInventorySlot> PolicySlots = SourceSlots;
+        const int32 PolicyLeftover = SlotInventoryKernels::DispatchSlotRule(Rule, [&](const auto& Policy)
+        {
+            return Scan(PolicySlots, Item, Policy);
+        });
+        if (RuntimeLeftover != PolicyLeftover || !AreSameSlots(RuntimeSlots, PolicySlots))
+        {
+            NumMismatches++;
+            Ar.Logf(TEXT("Mismatch: OnlyMerge %d, Atomic %d, AllowSwap %d, Limit %d, leftover %d with runtime flags and %d with the policy"),
+                Rule.bOnlyMerge, Rule.bAtomic, Rule.bAllowSwap, Rule.MaxTransferQuantity > 0, RuntimeLeftover, PolicyLeftover);
+        }
+
+        const double RuntimeSeconds = TimeScan(SourceSlots, Item, SlotInventoryKernels::FRuntimeSlotTransactionPolicy(Rule), Iterations, Checksum);
+        const double PolicySeconds = SlotInventoryKernels::DispatchSlotRule(Rule, [&](const auto& Policy)
+        {
+            return TimeScan(SourceSlots, Item, Policy, Iterations, Checksum);
+        });
+
+        Ar.Logf(TEXT("%-10d %-7d %-10d %-6d %12.3f %12.3f %7.2fx"),
+            Rule.bOnlyMerge, Rule.bAtomic, Rule.bAllowSwap, Rule.MaxTransferQuantity > 0,
+            RuntimeSeconds * 1000.0, PolicySeconds * 1000.0, PolicySeconds > 0.0 ? RuntimeSeconds / PolicySeconds : 0.0);
+    }
+    Ar.Logf(TEXT("Checksum %lld, %d of 16 rule combinations differ between the runtime flags and the policy"), Checksum, NumMismatches);
+}
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice CmdSlotInventoryBenchReceiveKernels(
+    TEXT("SlotInventory.Bench.ReceiveKernels"),
+    TEXT("Times the slot receive loop with runtime rule flags and with the specialized policy, for each rule combination, after checking that both leave the same slots and leftover. Optional arguments: number of slots, iterations."),
+    FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateStatic(&BenchmarkReceiveKernels));
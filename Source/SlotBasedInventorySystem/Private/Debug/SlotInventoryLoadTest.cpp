@@ -0,0 +1,695 @@
+// Amasson
+
+
+#include "Debug/SlotInventoryLoadTest.h"
+#include "Components/SlotInventoryComponent.h"
+#include "Engine/NetConnection.h"
+#include "Engine/NetDriver.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/GameModeBase.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/CommandLine.h"
+#include "Misc/CoreDelegates.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+#include "Net/UnrealNetwork.h"
+#include "UObject/UObjectIterator.h"
+
+
+const TCHAR* LexToString(ESlotInventoryLoadTestAction Action)
+{
+    switch (Action)
+    {
+    case ESlotInventoryLoadTestAction::DragDrop: return TEXT("DragDrop");
+    case ESlotInventoryLoadTestAction::LootAll: return TEXT("LootAll");
+    case ESlotInventoryLoadTestAction::RegroupSlot: return TEXT("RegroupSlot");
+    case ESlotInventoryLoadTestAction::Trade: return TEXT("Trade");
+    default: return TEXT("Unknown");
+    }
+}
+
+namespace SlotInventoryLoadTest
+{
+    static FString GetReportDirectory()
+    {
+        return FPaths::ProfilingDir() / TEXT("SlotInventory");
+    }
+
+    static FName GetItemName(int32 ItemIndex)
+    {
+        return FName(TEXT("LoadTestItem"), ItemIndex + 1);
+    }
+
+    static float GetPercentile(const TArray<float>& SortedValues, double Percentile)
+    {
+        if (SortedValues.IsEmpty())
+            return 0.0f;
+
+        const int32 Index = FMath::Clamp(FMath::CeilToInt(SortedValues.Num() * Percentile) - 1, 0, SortedValues.Num() - 1);
+        return SortedValues[Index];
+    }
+
+    static FString BuildLatencyCsvHeader()
+    {
+        FString Header = TEXT("Samples,TotalMs,MaxMs,ExpiredRequests");
+        for (int32 BucketIndex = 0; BucketIndex < FSlotInventoryLatencyHistogram::NumBuckets; BucketIndex++)
+            Header += FString::Printf(TEXT(",Bucket%d"), BucketIndex);
+        return Header;
+    }
+
+    static FString BuildLatencyCsvRow(const FSlotInventoryLatencyHistogram& Latency, uint32 ExpiredRequests)
+    {
+        FString Row = FString::Printf(TEXT("%u,%.3f,%.3f,%u"), Latency.NumSamples, Latency.TotalMs, Latency.MaxMs, ExpiredRequests);
+        for (int32 BucketIndex = 0; BucketIndex < FSlotInventoryLatencyHistogram::NumBuckets; BucketIndex++)
+            Row += FString::Printf(TEXT(",%u"), Latency.Buckets[BucketIndex]);
+        return Row;
+    }
+
+    static bool ParseLatencyCsvRow(const FString& Row, FSlotInventoryLatencyHistogram& OutLatency, uint32& OutExpiredRequests)
+    {
+        TArray<FString> Values;
+        Row.ParseIntoArray(Values, TEXT(","));
+        if (Values.Num() != 4 + FSlotInventoryLatencyHistogram::NumBuckets)
+            return false;
+
+        OutLatency.NumSamples = FCString::Atoi(*Values[0]);
+        OutLatency.TotalMs = FCString::Atod(*Values[1]);
+        OutLatency.MaxMs = FCString::Atod(*Values[2]);
+        OutExpiredRequests = FCString::Atoi(*Values[3]);
+        for (int32 BucketIndex = 0; BucketIndex < FSlotInventoryLatencyHistogram::NumBuckets; BucketIndex++)
+            OutLatency.Buckets[BucketIndex] = FCString::Atoi(*Values[4 + BucketIndex]);
+        return true;
+    }
+}
+
+
+/** Settings */
+
+void FSlotInventoryLoadTestSettings::ParseCommandLine(const TCHAR* CommandLine)
+{
+    FParse::Value(CommandLine, TEXT("LoadTestDuration="), DurationSeconds);
+    FParse::Value(CommandLine, TEXT("LoadTestContainers="), NumContainers);
+    FParse::Value(CommandLine, TEXT("LoadTestContainerCapacity="), ContainerCapacity);
+    FParse::Value(CommandLine, TEXT("LoadTestPlayerCapacity="), PlayerCapacity);
+    FParse::Value(CommandLine, TEXT("LoadTestItemTypes="), NumItemTypes);
+    FParse::Value(CommandLine, TEXT("LoadTestRate="), ActionsPerSecond);
+
+    NumContainers = FMath::Max(NumContainers, 0);
+    ContainerCapacity = FMath::Max(ContainerCapacity, 1);
+    PlayerCapacity = FMath::Max(PlayerCapacity, 1);
+    NumItemTypes = FMath::Max(NumItemTypes, 1);
+    ActionsPerSecond = FMath::Max(ActionsPerSecond, 0.0f);
+
+    FString Mix;
+    if (!FParse::Value(CommandLine, TEXT("LoadTestMix="), Mix, false))
+        return;
+
+    /** Actions missing from the mix are not run */
+    for (float& Weight : ActionWeights)
+        Weight = 0.0f;
+
+    TArray<FString> Entries;
+    Mix.ParseIntoArray(Entries, TEXT(","));
+    for (const FString& Entry : Entries)
+    {
+        FString ActionName, WeightString;
+        if (!Entry.Split(TEXT(":"), &ActionName, &WeightString))
+        {
+            ActionName = Entry;
+            WeightString = TEXT("1");
+        }
+
+        for (int32 ActionIndex = 0; ActionIndex < (int32)ESlotInventoryLoadTestAction::Count; ActionIndex++)
+        {
+            if (ActionName.Equals(LexToString((ESlotInventoryLoadTestAction)ActionIndex), ESearchCase::IgnoreCase))
+                ActionWeights[ActionIndex] = FMath::Max(FCString::Atof(*WeightString), 0.0f);
+        }
+    }
+}
+
+
+/** Actor */
+
+ASlotInventoryLoadTestActor::ASlotInventoryLoadTestActor()
+{
+    PrimaryActorTick.bCanEverTick = false;
+    bReplicates = true;
+    bAlwaysRelevant = true;
+
+    /** Only bContainer is replicated as a property, inventory updates are RPCs */
+    NetUpdateFrequency = 1.0f;
+
+    Inventory = CreateDefaultSubobject<USlotInventoryComponent>(TEXT("Inventory"));
+}
+
+void ASlotInventoryLoadTestActor::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+    Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+    DOREPLIFETIME_CONDITION(ThisClass, bContainer, COND_InitialOnly);
+}
+
+
+/** Subsystem */
+
+bool USlotInventoryLoadTestSubsystem::IsLoadTestEnabled()
+{
+    return FParse::Param(FCommandLine::Get(), TEXT("SlotInventoryLoadTest"));
+}
+
+bool USlotInventoryLoadTestSubsystem::ShouldCreateSubsystem(UObject* Outer) const
+{
+    if (!IsLoadTestEnabled() || !Super::ShouldCreateSubsystem(Outer))
+        return false;
+
+    const UWorld* World = Cast<UWorld>(Outer);
+    return World && World->IsGameWorld();
+}
+
+void USlotInventoryLoadTestSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+    Super::Initialize(Collection);
+
+    Settings.ParseCommandLine(FCommandLine::Get());
+    Random.Initialize(FPlatformProcess::GetCurrentProcessId());
+
+    if (IConsoleVariable* TelemetryEnable = IConsoleManager::Get().FindConsoleVariable(TEXT("SlotInventory.Telemetry.Enable")))
+        TelemetryEnable->Set(true, ECVF_SetByCommandline);
+}
+
+void USlotInventoryLoadTestSubsystem::Deinitialize()
+{
+    FGameModeEvents::GameModePostLoginEvent.Remove(PostLoginHandle);
+    FGameModeEvents::GameModeLogoutEvent.Remove(LogoutHandle);
+    FWorldDelegates::OnWorldTickStart.Remove(WorldTickStartHandle);
+    FCoreDelegates::OnEndFrame.Remove(EndFrameHandle);
+    if (GEngine)
+        GEngine->OnNetworkFailure().Remove(NetworkFailureHandle);
+
+    Super::Deinitialize();
+}
+
+void USlotInventoryLoadTestSubsystem::OnWorldBeginPlay(UWorld& InWorld)
+{
+    Super::OnWorldBeginPlay(InWorld);
+
+    StartSeconds = FPlatformTime::Seconds();
+    StartDateTime = FDateTime::UtcNow();
+    NextSampleSeconds = StartSeconds + 1.0;
+
+    const ENetMode NetMode = InWorld.GetNetMode();
+    if (NetMode == NM_DedicatedServer || NetMode == NM_ListenServer)
+    {
+        PostLoginHandle = FGameModeEvents::GameModePostLoginEvent.AddUObject(this, &ThisClass::OnGameModePostLogin);
+        LogoutHandle = FGameModeEvents::GameModeLogoutEvent.AddUObject(this, &ThisClass::OnGameModeLogout);
+        WorldTickStartHandle = FWorldDelegates::OnWorldTickStart.AddUObject(this, &ThisClass::OnWorldTickStart);
+        EndFrameHandle = FCoreDelegates::OnEndFrame.AddUObject(this, &ThisClass::OnEndFrame);
+
+        for (int32 ContainerIndex = 0; ContainerIndex < Settings.NumContainers; ContainerIndex++)
+        {
+            if (ASlotInventoryLoadTestActor* Container = SpawnInventory(nullptr, true, Settings.ContainerCapacity))
+                Containers.Add(Container);
+        }
+        RefillContainers();
+
+        GLog->Logf(TEXT("SlotInventory load test server started with %d containers"), Containers.Num());
+    }
+    else if (NetMode == NM_Client)
+    {
+        if (GEngine)
+            NetworkFailureHandle = GEngine->OnNetworkFailure().AddUObject(this, &ThisClass::OnNetworkFailure);
+
+        GLog->Logf(TEXT("SlotInventory load test client started, %.1f actions per second"), Settings.ActionsPerSecond);
+    }
+}
+
+void USlotInventoryLoadTestSubsystem::Tick(float DeltaTime)
+{
+    Super::Tick(DeltaTime);
+
+    UWorld* World = GetWorld();
+    if (bFinished || World == nullptr || !World->HasBegunPlay())
+        return;
+
+    const ENetMode NetMode = World->GetNetMode();
+    const bool bServer = NetMode == NM_DedicatedServer || NetMode == NM_ListenServer;
+    const bool bClient = NetMode == NM_Client;
+    if (!bServer && !bClient)
+        return;
+
+    const double Now = FPlatformTime::Seconds();
+    if (Now >= NextSampleSeconds)
+    {
+        NextSampleSeconds = Now + 1.0;
+        if (bServer)
+        {
+            SampleConnections();
+            RefillContainers();
+        }
+        else
+        {
+            RefreshClientTargets();
+
+            /** Every few seconds, so the server report finds recent values even if this client is killed */
+            if (FMath::FloorToInt(Now - StartSeconds) % 5 == 0)
+                WriteClientLatency();
+        }
+    }
+
+    if (bClient && OwnInventory.IsValid())
+    {
+        PendingActions += Settings.ActionsPerSecond * DeltaTime;
+        while (PendingActions >= 1.0f)
+        {
+            PendingActions -= 1.0f;
+            RunAction(PickAction());
+        }
+    }
+
+    if (Settings.DurationSeconds > 0.0 && Now - StartSeconds >= Settings.DurationSeconds)
+    {
+        bFinished = true;
+        WriteReport(*GLog);
+        FPlatformMisc::RequestExit(false);
+    }
+}
+
+TStatId USlotInventoryLoadTestSubsystem::GetStatId() const
+{
+    RETURN_QUICK_DECLARE_CYCLE_STAT(USlotInventoryLoadTestSubsystem, STATGROUP_Tickables);
+}
+
+
+/** Server */
+
+void USlotInventoryLoadTestSubsystem::OnGameModePostLogin(AGameModeBase* GameMode, APlayerController* NewPlayer)
+{
+    if (GameMode == nullptr || GameMode->GetWorld() != GetWorld() || NewPlayer == nullptr)
+        return;
+
+    if (ASlotInventoryLoadTestActor* PlayerInventory = SpawnInventory(NewPlayer, false, Settings.PlayerCapacity))
+    {
+        FillInventory(PlayerInventory->GetInventory(), 0.5f);
+        PlayerInventories.Add(NewPlayer, PlayerInventory);
+        MaxPlayers = FMath::Max(MaxPlayers, PlayerInventories.Num());
+    }
+}
+
+void USlotInventoryLoadTestSubsystem::OnGameModeLogout(AGameModeBase* GameMode, AController* Exiting)
+{
+    APlayerController* PlayerController = Cast<APlayerController>(Exiting);
+    if (PlayerController == nullptr)
+        return;
+
+    TObjectPtr<ASlotInventoryLoadTestActor> PlayerInventory;
+    if (PlayerInventories.RemoveAndCopyValue(PlayerController, PlayerInventory) && IsValid(PlayerInventory))
+        PlayerInventory->Destroy();
+}
+
+ASlotInventoryLoadTestActor* USlotInventoryLoadTestSubsystem::SpawnInventory(AActor* Owner, bool bContainer, int32 Capacity)
+{
+    UWorld* World = GetWorld();
+    if (World == nullptr)
+        return nullptr;
+
+    FActorSpawnParameters SpawnParameters;
+    SpawnParameters.Owner = Owner;
+    SpawnParameters.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+
+    ASlotInventoryLoadTestActor* Actor = World->SpawnActor<ASlotInventoryLoadTestActor>(SpawnParameters);
+    if (Actor == nullptr)
+        return nullptr;
+
+    Actor->bContainer = bContainer;
+    Actor->GetInventory()->SetContentCapacity(Capacity);
+    return Actor;
+}
+
+void USlotInventoryLoadTestSubsystem::FillInventory(USlotInventoryComponent* Inventory, float FillRatio)
+{
+    const int32 Capacity = Inventory->GetContentCapacity();
+
+    int32 NumStored = 0;
+    Inventory->GetContent().ForEachStoredSlot([&NumStored](int32 Index, const FInventorySlot& Slot)
+    {
+        NumStored += Slot.IsEmpty() ? 0 : 1;
+    });
+
+    const int32 TargetStored = FMath::CeilToInt(Capacity * FillRatio);
+    for (int32 Index = 0; Index < Capacity && NumStored < TargetStored; Index++)
+    {
+        FInventorySlot Slot;
+        if (Inventory->GetSlotValueAtIndex(Index, Slot) && !Slot.IsEmpty())
+            continue;
+
+        Slot.Item = SlotInventoryLoadTest::GetItemName(Random.RandHelper(Settings.NumItemTypes));
+        Slot.Quantity = Random.RandRange(1, Inventory->GetMaxStackSizeForID(Slot.Item));
+        Inventory->SetSlotValueAtIndex(Index, Slot);
+        NumStored++;
+    }
+}
+
+void USlotInventoryLoadTestSubsystem::RefillContainers()
+{
+    for (ASlotInventoryLoadTestActor* Container : Containers)
+    {
+        if (IsValid(Container))
+            FillInventory(Container->GetInventory(), 0.75f);
+    }
+}
+
+void USlotInventoryLoadTestSubsystem::SampleConnections()
+{
+    const UNetDriver* NetDriver = GetWorld()->GetNetDriver();
+    if (NetDriver == nullptr)
+        return;
+
+    for (const UNetConnection* Connection : NetDriver->ClientConnections)
+    {
+        if (Connection == nullptr)
+            continue;
+
+        FConnectionStats& Stats = ConnectionStats.FindOrAdd(Connection->LowLevelGetRemoteAddress(true));
+        Stats.TotalOutBytesPerSecond += Connection->OutBytesPerSecond;
+        Stats.TotalInBytesPerSecond += Connection->InBytesPerSecond;
+        Stats.MaxOutBytesPerSecond = FMath::Max(Stats.MaxOutBytesPerSecond, Connection->OutBytesPerSecond);
+        Stats.NumSamples++;
+    }
+}
+
+void USlotInventoryLoadTestSubsystem::OnWorldTickStart(UWorld* InWorld, ELevelTick TickType, float DeltaSeconds)
+{
+    if (InWorld == GetWorld())
+        FrameStartSeconds = FPlatformTime::Seconds();
+}
+
+void USlotInventoryLoadTestSubsystem::OnEndFrame()
+{
+    if (FrameStartSeconds > 0.0 && !bFinished)
+        FrameCostsMs.Add((FPlatformTime::Seconds() - FrameStartSeconds) * 1000.0);
+    FrameStartSeconds = 0.0;
+}
+
+void USlotInventoryLoadTestSubsystem::WriteServerReport(TArray<FString>& Lines)
+{
+    using namespace SlotInventoryLoadTest;
+
+    const double Seconds = FMath::Max(FPlatformTime::Seconds() - StartSeconds, UE_SMALL_NUMBER);
+    Lines.Add(FString::Printf(TEXT("Seconds,%.1f"), Seconds));
+    Lines.Add(FString::Printf(TEXT("Players,%d"), PlayerInventories.Num()));
+    Lines.Add(FString::Printf(TEXT("MaxPlayers,%d"), MaxPlayers));
+    Lines.Add(FString::Printf(TEXT("Containers,%d"), Containers.Num()));
+
+    TArray<float> SortedFrameCosts = FrameCostsMs;
+    SortedFrameCosts.Sort();
+    double TotalFrameCostMs = 0.0;
+    for (float FrameCostMs : SortedFrameCosts)
+        TotalFrameCostMs += FrameCostMs;
+    Lines.Add(FString::Printf(TEXT("Frames,%d"), SortedFrameCosts.Num()));
+    Lines.Add(FString::Printf(TEXT("FrameCostAvgMs,%.3f"), SortedFrameCosts.Num() > 0 ? TotalFrameCostMs / SortedFrameCosts.Num() : 0.0));
+    Lines.Add(FString::Printf(TEXT("FrameCostP50Ms,%.3f"), GetPercentile(SortedFrameCosts, 0.5)));
+    Lines.Add(FString::Printf(TEXT("FrameCostP95Ms,%.3f"), GetPercentile(SortedFrameCosts, 0.95)));
+    Lines.Add(FString::Printf(TEXT("FrameCostP99Ms,%.3f"), GetPercentile(SortedFrameCosts, 0.99)));
+    Lines.Add(FString::Printf(TEXT("FrameCostMaxMs,%.3f"), SortedFrameCosts.Num() > 0 ? SortedFrameCosts.Last() : 0.0f));
+
+    /** Requests received and updates sent, from the telemetry of every inventory of the world */
+    uint64 RequestCounts[(int32)ESlotInventoryServerRequest::Count] = {};
+    uint64 UpdatesSent = 0;
+    uint64 BytesSent = 0;
+    for (TObjectIterator<USlotInventoryComponent> It; It; ++It)
+    {
+        const FSlotInventoryNetTelemetry* Telemetry = It->GetWorld() == GetWorld() ? It->GetNetTelemetry() : nullptr;
+        if (Telemetry == nullptr)
+            continue;
+
+        for (int32 RequestIndex = 0; RequestIndex < (int32)ESlotInventoryServerRequest::Count; RequestIndex++)
+            RequestCounts[RequestIndex] += Telemetry->RequestCounts[RequestIndex];
+        UpdatesSent += Telemetry->UpdatesSent;
+        BytesSent += Telemetry->BytesSent;
+    }
+
+    uint64 TotalRequests = 0;
+    for (int32 RequestIndex = 0; RequestIndex < (int32)ESlotInventoryServerRequest::Count; RequestIndex++)
+    {
+        TotalRequests += RequestCounts[RequestIndex];
+        Lines.Add(FString::Printf(TEXT("Requests%s,%llu"), LexToString((ESlotInventoryServerRequest)RequestIndex), RequestCounts[RequestIndex]));
+    }
+    Lines.Add(FString::Printf(TEXT("RequestsPerSecond,%.1f"), TotalRequests / Seconds));
+    Lines.Add(FString::Printf(TEXT("UpdatesSent,%llu"), UpdatesSent));
+    Lines.Add(FString::Printf(TEXT("InventoryBytesPerSecond,%.1f"), BytesSent / Seconds));
+
+    /** Whole connection traffic, sampled every second */
+    double TotalClientOutBytesPerSecond = 0.0;
+    int32 MaxClientOutBytesPerSecond = 0;
+    for (const TPair<FString, FConnectionStats>& Pair : ConnectionStats)
+    {
+        const FConnectionStats& Stats = Pair.Value;
+        const double AverageOut = Stats.NumSamples > 0 ? (double)Stats.TotalOutBytesPerSecond / Stats.NumSamples : 0.0;
+        const double AverageIn = Stats.NumSamples > 0 ? (double)Stats.TotalInBytesPerSecond / Stats.NumSamples : 0.0;
+        TotalClientOutBytesPerSecond += AverageOut;
+        MaxClientOutBytesPerSecond = FMath::Max(MaxClientOutBytesPerSecond, Stats.MaxOutBytesPerSecond);
+        Lines.Add(FString::Printf(TEXT("Client %s OutBytesPerSecond,%.1f"), *Pair.Key, AverageOut));
+        Lines.Add(FString::Printf(TEXT("Client %s InBytesPerSecond,%.1f"), *Pair.Key, AverageIn));
+    }
+    Lines.Add(FString::Printf(TEXT("ClientOutBytesPerSecondAvg,%.1f"), ConnectionStats.Num() > 0 ? TotalClientOutBytesPerSecond / ConnectionStats.Num() : 0.0));
+    Lines.Add(FString::Printf(TEXT("ClientOutBytesPerSecondMax,%d"), MaxClientOutBytesPerSecond));
+
+    /** Request to update latencies, measured by the clients */
+    FSlotInventoryLatencyHistogram Latency;
+    uint32 ExpiredRequests = 0;
+    int32 NumClientFiles = 0;
+
+    TArray<FString> ClientFiles;
+    IFileManager::Get().FindFiles(ClientFiles, *(GetReportDirectory() / TEXT("LoadTest-Client-*.csv")), true, false);
+    for (const FString& ClientFile : ClientFiles)
+    {
+        const FString FilePath = GetReportDirectory() / ClientFile;
+        if (IFileManager::Get().GetTimeStamp(*FilePath) < StartDateTime)
+            continue;
+
+        TArray<FString> FileLines;
+        FSlotInventoryLatencyHistogram ClientLatency;
+        uint32 ClientExpiredRequests = 0;
+        if (FFileHelper::LoadFileToStringArray(FileLines, *FilePath) && FileLines.Num() > 1
+            && ParseLatencyCsvRow(FileLines[1], ClientLatency, ClientExpiredRequests))
+        {
+            Latency.Merge(ClientLatency);
+            ExpiredRequests += ClientExpiredRequests;
+            NumClientFiles++;
+        }
+    }
+
+    Lines.Add(FString::Printf(TEXT("LatencyClients,%d"), NumClientFiles));
+    Lines.Add(FString::Printf(TEXT("LatencySamples,%u"), Latency.NumSamples));
+    Lines.Add(FString::Printf(TEXT("LatencyExpiredRequests,%u"), ExpiredRequests));
+    Lines.Add(FString::Printf(TEXT("LatencyAvgMs,%.1f"), Latency.GetAverageMs()));
+    Lines.Add(FString::Printf(TEXT("LatencyP50Ms,%.1f"), Latency.GetPercentileMs(0.5)));
+    Lines.Add(FString::Printf(TEXT("LatencyP95Ms,%.1f"), Latency.GetPercentileMs(0.95)));
+    Lines.Add(FString::Printf(TEXT("LatencyP99Ms,%.1f"), Latency.GetPercentileMs(0.99)));
+    Lines.Add(FString::Printf(TEXT("LatencyMaxMs,%.1f"), Latency.MaxMs));
+}
+
+
+/** Client */
+
+void USlotInventoryLoadTestSubsystem::RefreshClientTargets()
+{
+    UWorld* World = GetWorld();
+    const APlayerController* PlayerController = World->GetFirstPlayerController();
+
+    OwnInventory.Reset();
+    TargetContainers.Reset();
+    TradePartners.Reset();
+
+    for (TActorIterator<ASlotInventoryLoadTestActor> It(World); It; ++It)
+    {
+        ASlotInventoryLoadTestActor* Actor = *It;
+        if (Actor->IsContainer())
+            TargetContainers.Add(Actor);
+        else if (PlayerController && Actor->GetOwner() == PlayerController)
+            OwnInventory = Actor;
+        else
+            TradePartners.Add(Actor);
+    }
+}
+
+ESlotInventoryLoadTestAction USlotInventoryLoadTestSubsystem::PickAction()
+{
+    float TotalWeight = 0.0f;
+    for (float Weight : Settings.ActionWeights)
+        TotalWeight += Weight;
+
+    float Pick = Random.FRand() * TotalWeight;
+    for (int32 ActionIndex = 0; ActionIndex < (int32)ESlotInventoryLoadTestAction::Count; ActionIndex++)
+    {
+        Pick -= Settings.ActionWeights[ActionIndex];
+        if (Pick < 0.0f)
+            return (ESlotInventoryLoadTestAction)ActionIndex;
+    }
+    return ESlotInventoryLoadTestAction::DragDrop;
+}
+
+int32 USlotInventoryLoadTestSubsystem::PickStoredSlot(const USlotInventoryComponent* Inventory)
+{
+    int32 NumStored = 0;
+    int32 PickedIndex = INDEX_NONE;
+
+    /** Reservoir sampling, a single pass over the stored slots */
+    Inventory->GetContent().ForEachStoredSlot([this, &NumStored, &PickedIndex](int32 Index, const FInventorySlot& Slot)
+    {
+        if (!Slot.IsEmpty() && Random.RandHelper(++NumStored) == 0)
+            PickedIndex = Index;
+    });
+    return PickedIndex;
+}
+
+void USlotInventoryLoadTestSubsystem::RunAction(ESlotInventoryLoadTestAction Action)
+{
+    ASlotInventoryLoadTestActor* Own = OwnInventory.Get();
+    if (Own == nullptr)
+        return;
+
+    USlotInventoryComponent* Inventory = Own->GetInventory();
+    ASlotInventoryLoadTestActor* Container = TargetContainers.IsEmpty() ? nullptr : TargetContainers[Random.RandHelper(TargetContainers.Num())].Get();
+    ASlotInventoryLoadTestActor* Partner = TradePartners.IsEmpty() ? nullptr : TradePartners[Random.RandHelper(TradePartners.Num())].Get();
+
+    ActionCounts[(int32)Action]++;
+
+    switch (Action)
+    {
+    case ESlotInventoryLoadTestAction::DragDrop:
+    {
+        const int32 SourceIndex = PickStoredSlot(Inventory);
+        if (SourceIndex == INDEX_NONE)
+            break;
+
+        /** Half of the drops go to a container, which keeps the player inventories from filling up with loot */
+        USlotInventoryComponent* Destination = Container && Random.FRand() < 0.5f ? Container->GetInventory() : Inventory;
+        const int32 DestinationIndex = Random.RandHelper(FMath::Max(Destination->GetContentCapacity(), 1));
+        Inventory->Server_RequestDropSlotTowardOtherInventoryAtIndex(SourceIndex, Destination, DestinationIndex, 0);
+        break;
+    }
+    case ESlotInventoryLoadTestAction::LootAll:
+    {
+        if (Container == nullptr)
+            break;
+
+        USlotInventoryComponent* Source = Container->GetInventory();
+        Source->GetContent().ForEachStoredSlot([Inventory, Source](int32 Index, const FInventorySlot& Slot)
+        {
+            if (!Slot.IsEmpty())
+                Inventory->Server_RequestDropSlotFromOtherInventory(Source, Index);
+        });
+        break;
+    }
+    case ESlotInventoryLoadTestAction::RegroupSlot:
+    {
+        const int32 Index = PickStoredSlot(Inventory);
+        if (Index != INDEX_NONE)
+            Inventory->Server_RequestRegroupSlotAtIndexWithSimilarIds(Index);
+        break;
+    }
+    case ESlotInventoryLoadTestAction::Trade:
+    {
+        const int32 SourceIndex = PickStoredSlot(Inventory);
+        if (Partner != nullptr && SourceIndex != INDEX_NONE)
+            Inventory->Server_RequestDropSlotTowardOtherInventory(SourceIndex, Partner->GetInventory());
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+FString USlotInventoryLoadTestSubsystem::GetClientLatencyFilePath() const
+{
+    return SlotInventoryLoadTest::GetReportDirectory() / FString::Printf(TEXT("LoadTest-Client-%u.csv"), FPlatformProcess::GetCurrentProcessId());
+}
+
+void USlotInventoryLoadTestSubsystem::WriteClientLatency() const
+{
+    const ASlotInventoryLoadTestActor* Own = OwnInventory.Get();
+    const FSlotInventoryNetTelemetry* Telemetry = Own ? Own->GetInventory()->GetNetTelemetry() : nullptr;
+    if (Telemetry == nullptr)
+        return;
+
+    TArray<FString> Lines;
+    Lines.Add(SlotInventoryLoadTest::BuildLatencyCsvHeader());
+    Lines.Add(SlotInventoryLoadTest::BuildLatencyCsvRow(Telemetry->Latency, Telemetry->ExpiredRequests));
+    FFileHelper::SaveStringArrayToFile(Lines, *GetClientLatencyFilePath());
+}
+
+void USlotInventoryLoadTestSubsystem::OnNetworkFailure(UWorld* InWorld, UNetDriver* NetDriver, ENetworkFailure::Type FailureType, const FString& ErrorString)
+{
+    if (InWorld != GetWorld() || bFinished)
+        return;
+
+    /** The server ended the run */
+    bFinished = true;
+    WriteReport(*GLog);
+    FPlatformMisc::RequestExit(false);
+}
+
+
+/** Report */
+
+void USlotInventoryLoadTestSubsystem::WriteReport(FOutputDevice& Ar)
+{
+    TArray<FString> Lines;
+    Lines.Add(TEXT("Metric,Value"));
+
+    FString FilePath;
+    if (GetWorld()->GetNetMode() == NM_Client)
+    {
+        WriteClientLatency();
+
+        for (int32 ActionIndex = 0; ActionIndex < (int32)ESlotInventoryLoadTestAction::Count; ActionIndex++)
+            Lines.Add(FString::Printf(TEXT("Actions%s,%u"), LexToString((ESlotInventoryLoadTestAction)ActionIndex), ActionCounts[ActionIndex]));
+
+        const ASlotInventoryLoadTestActor* Own = OwnInventory.Get();
+        if (const FSlotInventoryNetTelemetry* Telemetry = Own ? Own->GetInventory()->GetNetTelemetry() : nullptr)
+        {
+            Lines.Add(FString::Printf(TEXT("LatencySamples,%u"), Telemetry->Latency.NumSamples));
+            Lines.Add(FString::Printf(TEXT("LatencyP50Ms,%.1f"), Telemetry->Latency.GetPercentileMs(0.5)));
+            Lines.Add(FString::Printf(TEXT("LatencyP95Ms,%.1f"), Telemetry->Latency.GetPercentileMs(0.95)));
+            Lines.Add(FString::Printf(TEXT("LatencyP99Ms,%.1f"), Telemetry->Latency.GetPercentileMs(0.99)));
+        }
+    }
+    else
+    {
+        WriteServerReport(Lines);
+        FilePath = SlotInventoryLoadTest::GetReportDirectory() / FString::Printf(TEXT("LoadTest-Server-%s.csv"), *FDateTime::Now().ToString());
+    }
+
+    for (const FString& Line : Lines)
+        Ar.Logf(TEXT("%s"), *Line);
+
+    if (!FilePath.IsEmpty())
+    {
+        if (FFileHelper::SaveStringArrayToFile(Lines, *FilePath))
+            Ar.Logf(TEXT("Wrote the load test report to %s"), *IFileManager::Get().ConvertToAbsolutePathForExternalAppForWrite(*FilePath));
+        else
+            Ar.Logf(ELogVerbosity::Error, TEXT("Failed to write %s"), *FilePath);
+    }
+}
+
+
+/** Console Commands */
+
+static void ReportLoadTest(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+{
+    if (USlotInventoryLoadTestSubsystem* LoadTest = World ? World->GetSubsystem<USlotInventoryLoadTestSubsystem>() : nullptr)
+        LoadTest->WriteReport(Ar);
+    else
+        Ar.Logf(TEXT("The inventory load test only runs with -SlotInventoryLoadTest on the command line"));
+}
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice CmdSlotInventoryLoadTestReport(
+    TEXT("SlotInventory.LoadTest.Report"),
+    TEXT("Logs and writes the report of the running inventory load test, to Saved/Profiling/SlotInventory on the server."),
+    FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateStatic(&ReportLoadTest));
@@ -0,0 +1,99 @@
+// Amasson
+
+
+#include "Debug/SlotInventoryMemory.h"
+#include "Components/SlotInventoryComponentBase.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "UObject/UObjectIterator.h"
+
+
+FSlotInventoryMemoryUsage& FSlotInventoryMemoryUsage::operator+=(const FSlotInventoryMemoryUsage& Other)
+{
+    Slots += Other.Slots;
+    Modifiers += Other.Modifiers;
+    ModifierPayloads += Other.ModifierPayloads;
+    Tracking += Other.Tracking;
+    Dehydrated += Other.Dehydrated;
+    Slack += Other.Slack;
+    return *this;
+}
+
+
+/** Console Commands */
+
+static void ForEachInventory(UWorld* World, TFunctionRef<void(USlotInventoryComponentBase*)> Callback)
+{
+    for (TObjectIterator<USlotInventoryComponentBase> It; It; ++It)
+    {
+        USlotInventoryComponentBase* Component = *It;
+        if (IsValid(Component) && Component->GetWorld() == World)
+            Callback(Component);
+    }
+}
+
+static void ReportMemory(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+{
+    struct FClassReport
+    {
+        int32 NumInventories = 0;
+        int64 Capacity = 0;
+        FSlotInventoryMemoryUsage Usage;
+    };
+
+    TMap<FString, FClassReport> Reports;
+    FClassReport Total;
+    ForEachInventory(World, [&Reports, &Total](USlotInventoryComponentBase* Component)
+    {
+        const AActor* Owner = Component->GetOwner();
+        FClassReport& Report = Reports.FindOrAdd(Owner ? Owner->GetClass()->GetName() : TEXT("None"));
+        const FSlotInventoryMemoryUsage Usage = Component->GetMemoryUsage();
+
+        for (FClassReport* Accumulated : { &Report, &Total })
+        {
+            Accumulated->NumInventories++;
+            Accumulated->Capacity += Component->GetContentCapacity();
+            Accumulated->Usage += Usage;
+        }
+    });
+
+    Reports.ValueSort([](const FClassReport& A, const FClassReport& B) { return A.Usage.GetTotal() > B.Usage.GetTotal(); });
+
+    auto LogRow = [&Ar](const FString& Name, const FClassReport& Report)
+    {
+        const FSlotInventoryMemoryUsage& Usage = Report.Usage;
+        Ar.Logf(TEXT("%-40s %6d %10lld %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f %10.1f"),
+            *Name, Report.NumInventories, Report.Capacity,
+            Usage.GetTotal() / 1024.0, Usage.Slots / 1024.0, Usage.Modifiers / 1024.0,
+            Usage.ModifierPayloads / 1024.0, Usage.Tracking / 1024.0, Usage.Dehydrated / 1024.0, Usage.Slack / 1024.0);
+    };
+
+    Ar.Logf(TEXT("%-40s %6s %10s %10s %10s %10s %10s %10s %10s %10s"),
+        TEXT("OwnerClass"), TEXT("Count"), TEXT("Capacity"), TEXT("TotalKB"), TEXT("SlotsKB"), TEXT("ModsKB"), TEXT("PayloadKB"), TEXT("TrackKB"), TEXT("DehydKB"), TEXT("SlackKB"));
+    for (const auto& [ClassName, Report] : Reports)
+        LogRow(ClassName, Report);
+    LogRow(TEXT("Total"), Total);
+}
+
+static void CompactMemory(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+{
+    SIZE_T Before = 0;
+    SIZE_T After = 0;
+    ForEachInventory(World, [&Before, &After](USlotInventoryComponentBase* Component)
+    {
+        Before += Component->GetMemoryUsage().GetTotal();
+        Component->CompactMemory();
+        After += Component->GetMemoryUsage().GetTotal();
+    });
+    Ar.Logf(TEXT("Compacted inventories from %.1f KB to %.1f KB"), Before / 1024.0, After / 1024.0);
+}
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice CmdSlotInventoryMemoryReport(
+    TEXT("SlotInventory.Memory.Report"),
+    TEXT("Logs the memory used by the inventories of the world, aggregated by owner class."),
+    FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateStatic(&ReportMemory));
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice CmdSlotInventoryMemoryCompact(
+    TEXT("SlotInventory.Memory.Compact"),
+    TEXT("Releases the unused memory of every inventory of the world."),
+    FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateStatic(&CompactMemory));
@@ -0,0 +1,333 @@
+// Amasson
+
+
+#include "Debug/SlotInventoryNetTelemetry.h"
+#include "Components/SlotInventoryComponent.h"
+#include "Engine/NetConnection.h"
+#include "Engine/World.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UObject/CoreNet.h"
+#include "UObject/UObjectIterator.h"
+
+
+static TAutoConsoleVariable<bool> CVarSlotInventoryTelemetryEnable(
+    TEXT("SlotInventory.Telemetry.Enable"),
+    false,
+    TEXT("Record replication bandwidth, server request rates and request latencies of every USlotInventoryComponent."));
+
+static TAutoConsoleVariable<float> CVarSlotInventoryTelemetryRequestTimeout(
+    TEXT("SlotInventory.Telemetry.RequestTimeout"),
+    2.0f,
+    TEXT("Seconds after which a client request that was not acknowledged is counted as expired instead of used for latency measurement."));
+
+
+const TCHAR* LexToString(ESlotInventoryServerRequest Request)
+{
+    switch (Request)
+    {
+    case ESlotInventoryServerRequest::BroadcastFullInventory: return TEXT("BroadcastFullInventory");
+    case ESlotInventoryServerRequest::SetContentCapacity: return TEXT("SetContentCapacity");
+    case ESlotInventoryServerRequest::SetSlotValueAtIndex: return TEXT("SetSlotValueAtIndex");
+    case ESlotInventoryServerRequest::ClearSlotAtIndex: return TEXT("ClearSlotAtIndex");
+    case ESlotInventoryServerRequest::DropSlotTowardOtherInventoryAtIndex: return TEXT("DropSlotTowardOtherInventoryAtIndex");
+    case ESlotInventoryServerRequest::DropSlotTowardOtherInventory: return TEXT("DropSlotTowardOtherInventory");
+    case ESlotInventoryServerRequest::DropSlotFromOtherInventoryAtIndex: return TEXT("DropSlotFromOtherInventoryAtIndex");
+    case ESlotInventoryServerRequest::DropSlotFromOtherInventory: return TEXT("DropSlotFromOtherInventory");
+    case ESlotInventoryServerRequest::RegroupSlotAtIndexWithSimilarIds: return TEXT("RegroupSlotAtIndexWithSimilarIds");
+    default: return TEXT("Unknown");
+    }
+}
+
+
+/** Latency Histogram */
+
+const double FSlotInventoryLatencyHistogram::BucketUpperBoundsMs[NumBuckets] = {
+    5.0, 10.0, 20.0, 35.0, 50.0, 75.0, 100.0, 150.0, 250.0, 500.0, 1000.0, TNumericLimits<double>::Max()
+};
+
+void FSlotInventoryLatencyHistogram::AddSample(double LatencyMs)
+{
+    int32 BucketIndex = 0;
+    while (BucketIndex < NumBuckets - 1 && LatencyMs > BucketUpperBoundsMs[BucketIndex])
+        BucketIndex++;
+
+    Buckets[BucketIndex]++;
+    NumSamples++;
+    TotalMs += LatencyMs;
+    MaxMs = FMath::Max(MaxMs, LatencyMs);
+}
+
+void FSlotInventoryLatencyHistogram::Merge(const FSlotInventoryLatencyHistogram& Other)
+{
+    for (int32 BucketIndex = 0; BucketIndex < NumBuckets; BucketIndex++)
+        Buckets[BucketIndex] += Other.Buckets[BucketIndex];
+    NumSamples += Other.NumSamples;
+    TotalMs += Other.TotalMs;
+    MaxMs = FMath::Max(MaxMs, Other.MaxMs);
+}
+
+void FSlotInventoryLatencyHistogram::Reset()
+{
+    *this = FSlotInventoryLatencyHistogram();
+}
+
+double FSlotInventoryLatencyHistogram::GetPercentileMs(double Percentile) const
+{
+    if (NumSamples == 0)
+        return 0.0;
+
+    const uint32 Threshold = FMath::CeilToInt(NumSamples * FMath::Clamp(Percentile, 0.0, 1.0));
+    uint32 Accumulated = 0;
+    for (int32 BucketIndex = 0; BucketIndex < NumBuckets - 1; BucketIndex++)
+    {
+        Accumulated += Buckets[BucketIndex];
+        if (Accumulated >= Threshold)
+            return BucketUpperBoundsMs[BucketIndex];
+    }
+    return MaxMs;
+}
+
+double FSlotInventoryLatencyHistogram::GetAverageMs() const
+{
+    return NumSamples > 0 ? TotalMs / NumSamples : 0.0;
+}
+
+
+/** Telemetry */
+
+bool FSlotInventoryNetTelemetry::IsEnabled()
+{
+    return CVarSlotInventoryTelemetryEnable.GetValueOnGameThread();
+}
+
+int32 FSlotInventoryNetTelemetry::EstimateSlotsUpdateSize(const TArray<int32>& Indices, const TArray<FInventorySlot>& Values)
+{
+    /** Serialized like the RPC parameters, names and modifier payloads included. Bunch headers are not counted. */
+    FNetBitWriter Writer(nullptr, 0);
+    Writer << const_cast<TArray<int32>&>(Indices);
+
+    int32 NumValues = Values.Num();
+    Writer << NumValues;
+    for (const FInventorySlot& Slot : Values)
+        FInventorySlot::StaticStruct()->SerializeBin(Writer, const_cast<FInventorySlot*>(&Slot));
+
+    return (int32)((Writer.GetNumBits() + 7) / 8);
+}
+
+void FSlotInventoryNetTelemetry::RecordSlotsUpdateSent(int32 NumSlots, int32 NumBytes)
+{
+    UpdatesSent++;
+    SlotsSent += NumSlots;
+    BytesSent += NumBytes;
+    LargestUpdateBytes = FMath::Max(LargestUpdateBytes, (uint32)NumBytes);
+}
+
+void FSlotInventoryNetTelemetry::RecordServerRequest(ESlotInventoryServerRequest Request)
+{
+    RequestCounts[(int32)Request]++;
+}
+
+uint32 FSlotInventoryNetTelemetry::RecordRequestSent()
+{
+    const uint32 Sequence = NextRequestSequence++;
+    if (NextRequestSequence == 0)
+        NextRequestSequence = 1;
+
+    const double Now = FPlatformTime::Seconds();
+    ExpirePendingRequests(Now);
+    PendingRequests.Emplace(Sequence, Now);
+    return Sequence;
+}
+
+void FSlotInventoryNetTelemetry::RecordRequestAcknowledged(uint32 Sequence)
+{
+    const double Now = FPlatformTime::Seconds();
+    const double Timeout = CVarSlotInventoryTelemetryRequestTimeout.GetValueOnGameThread();
+
+    /** Deferred requests can be acknowledged out of order */
+    const int32 RequestIndex = PendingRequests.IndexOfByPredicate([Sequence](const TPair<uint32, double>& Request) { return Request.Key == Sequence; });
+    if (RequestIndex != INDEX_NONE)
+    {
+        const double SentTime = PendingRequests[RequestIndex].Value;
+        if (Now - SentTime <= Timeout)
+            Latency.AddSample((Now - SentTime) * 1000.0);
+        else
+            ExpiredRequests++;
+        PendingRequests.RemoveAt(RequestIndex, 1, false);
+    }
+
+    ExpirePendingRequests(Now);
+}
+
+void FSlotInventoryNetTelemetry::RecordRequestRejected(uint32 Sequence)
+{
+    const int32 RequestIndex = PendingRequests.IndexOfByPredicate([Sequence](const TPair<uint32, double>& Request) { return Request.Key == Sequence; });
+    if (RequestIndex != INDEX_NONE)
+        PendingRequests.RemoveAt(RequestIndex, 1, false);
+    RejectedRequests++;
+
+    ExpirePendingRequests(FPlatformTime::Seconds());
+}
+
+void FSlotInventoryNetTelemetry::ExpirePendingRequests(double Now)
+{
+    const double Timeout = CVarSlotInventoryTelemetryRequestTimeout.GetValueOnGameThread();
+
+    /** Dropped requests are never acknowledged, the oldest also go when too many wait */
+    int32 NumExpired = FMath::Max(PendingRequests.Num() - MaxPendingRequests, 0);
+    while (NumExpired < PendingRequests.Num() && Now - PendingRequests[NumExpired].Value > Timeout)
+        NumExpired++;
+    ExpiredRequests += NumExpired;
+    PendingRequests.RemoveAt(0, NumExpired, false);
+}
+
+void FSlotInventoryNetTelemetry::RecordSlotsUpdateReceived()
+{
+    UpdatesReceived++;
+}
+
+void FSlotInventoryNetTelemetry::Reset()
+{
+    *this = FSlotInventoryNetTelemetry();
+}
+
+double FSlotInventoryNetTelemetry::GetElapsedSeconds() const
+{
+    return FMath::Max(FPlatformTime::Seconds() - StartTime, UE_SMALL_NUMBER);
+}
+
+
+/** Console Commands */
+
+static FString GetTelemetryConnectionName(const USlotInventoryComponent* Component)
+{
+    const AActor* Owner = Component->GetOwner();
+    if (const UNetConnection* Connection = Owner ? Owner->GetNetConnection() : nullptr)
+        return Connection->LowLevelGetRemoteAddress(true);
+    return TEXT("None");
+}
+
+static FString BuildTelemetryCsvHeader()
+{
+    FString Header = TEXT("World,Owner,OwnerClass,Component,NetMode,Connection,Capacity,Seconds,UpdatesSent,SlotsSent,BytesSent,BytesPerSecond,LargestUpdateBytes");
+    for (int32 RequestIndex = 0; RequestIndex < (int32)ESlotInventoryServerRequest::Count; RequestIndex++)
+        Header += FString::Printf(TEXT(",%sPerSecond"), LexToString((ESlotInventoryServerRequest)RequestIndex));
+    Header += TEXT(",LatencySamples,ExpiredRequests,RejectedRequests,LatencyAvgMs,LatencyP50Ms,LatencyP95Ms,LatencyP99Ms,LatencyMaxMs");
+    for (int32 BucketIndex = 0; BucketIndex < FSlotInventoryLatencyHistogram::NumBuckets - 1; BucketIndex++)
+        Header += FString::Printf(TEXT(",LatencyLe%.0fMs"), FSlotInventoryLatencyHistogram::BucketUpperBoundsMs[BucketIndex]);
+    Header += TEXT(",LatencyOver");
+    return Header;
+}
+
+static FString BuildTelemetryCsvRow(const USlotInventoryComponent* Component, const FSlotInventoryNetTelemetry& Telemetry)
+{
+    const AActor* Owner = Component->GetOwner();
+    const double Seconds = Telemetry.GetElapsedSeconds();
+
+    FString Row = FString::Printf(TEXT("%s,%s,%s,%s,%s,%s,%d,%.2f,%llu,%llu,%llu,%.1f,%u"),
+        *GetNameSafe(Component->GetWorld()),
+        *GetNameSafe(Owner),
+        Owner ? *Owner->GetClass()->GetName() : TEXT("None"),
+        *Component->GetName(),
+        Component->GetNetMode() == NM_Client ? TEXT("Client") : TEXT("Server"),
+        *GetTelemetryConnectionName(Component),
+        Component->GetContentCapacity(),
+        Seconds,
+        Telemetry.UpdatesSent,
+        Telemetry.SlotsSent,
+        Telemetry.BytesSent,
+        Telemetry.BytesSent / Seconds,
+        Telemetry.LargestUpdateBytes);
+
+    for (int32 RequestIndex = 0; RequestIndex < (int32)ESlotInventoryServerRequest::Count; RequestIndex++)
+        Row += FString::Printf(TEXT(",%.2f"), Telemetry.RequestCounts[RequestIndex] / Seconds);
+
+    const FSlotInventoryLatencyHistogram& Latency = Telemetry.Latency;
+    Row += FString::Printf(TEXT(",%u,%u,%u,%.1f,%.1f,%.1f,%.1f,%.1f"),
+        Latency.NumSamples,
+        Telemetry.ExpiredRequests,
+        Telemetry.RejectedRequests,
+        Latency.GetAverageMs(),
+        Latency.GetPercentileMs(0.5),
+        Latency.GetPercentileMs(0.95),
+        Latency.GetPercentileMs(0.99),
+        Latency.MaxMs);
+
+    for (int32 BucketIndex = 0; BucketIndex < FSlotInventoryLatencyHistogram::NumBuckets; BucketIndex++)
+        Row += FString::Printf(TEXT(",%u"), Latency.Buckets[BucketIndex]);
+
+    return Row;
+}
+
+static void ForEachTelemetry(UWorld* World, TFunctionRef<void(USlotInventoryComponent*, FSlotInventoryNetTelemetry&)> Callback)
+{
+    for (TObjectIterator<USlotInventoryComponent> It; It; ++It)
+    {
+        USlotInventoryComponent* Component = *It;
+        if (!IsValid(Component) || Component->GetWorld() != World)
+            continue;
+
+        if (FSlotInventoryNetTelemetry* Telemetry = Component->GetNetTelemetry())
+            Callback(Component, *Telemetry);
+    }
+}
+
+static void DumpTelemetry(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+{
+    TArray<TPair<uint64, FString>> Rows;
+    ForEachTelemetry(World, [&Rows](USlotInventoryComponent* Component, FSlotInventoryNetTelemetry& Telemetry)
+    {
+        Rows.Emplace(Telemetry.BytesSent, BuildTelemetryCsvRow(Component, Telemetry));
+    });
+
+    Rows.Sort([](const TPair<uint64, FString>& A, const TPair<uint64, FString>& B) { return A.Key > B.Key; });
+
+    Ar.Logf(TEXT("%s"), *BuildTelemetryCsvHeader());
+    for (const TPair<uint64, FString>& Row : Rows)
+        Ar.Logf(TEXT("%s"), *Row.Value);
+    Ar.Logf(TEXT("%d inventories with telemetry"), Rows.Num());
+}
+
+static void DumpTelemetryCsv(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+{
+    const FString FileName = Args.Num() > 0 ? Args[0] : FString::Printf(TEXT("SlotInventoryTelemetry-%s.csv"), *FDateTime::Now().ToString());
+    const FString FilePath = FPaths::IsRelative(FileName) ? FPaths::ProfilingDir() / TEXT("SlotInventory") / FileName : FileName;
+
+    TArray<FString> Lines;
+    Lines.Add(BuildTelemetryCsvHeader());
+    ForEachTelemetry(World, [&Lines](USlotInventoryComponent* Component, FSlotInventoryNetTelemetry& Telemetry)
+    {
+        Lines.Add(BuildTelemetryCsvRow(Component, Telemetry));
+    });
+
+    if (FFileHelper::SaveStringArrayToFile(Lines, *FilePath))
+        Ar.Logf(TEXT("Wrote %d inventories telemetry to %s"), Lines.Num() - 1, *IFileManager::Get().ConvertToAbsolutePathForExternalAppForWrite(*FilePath));
+    else
+        Ar.Logf(ELogVerbosity::Error, TEXT("Failed to write %s"), *FilePath);
+}
+
+static void ResetTelemetry(const TArray<FString>& Args, UWorld* World, FOutputDevice& Ar)
+{
+    ForEachTelemetry(World, [](USlotInventoryComponent* Component, FSlotInventoryNetTelemetry& Telemetry)
+    {
+        Telemetry.Reset();
+    });
+}
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice CmdSlotInventoryTelemetryDump(
+    TEXT("SlotInventory.Telemetry.Dump"),
+    TEXT("Logs the telemetry of every inventory of the world, sorted by bytes sent."),
+    FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateStatic(&DumpTelemetry));
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice CmdSlotInventoryTelemetryDumpCsv(
+    TEXT("SlotInventory.Telemetry.DumpCsv"),
+    TEXT("Writes the telemetry of every inventory of the world to a csv file. Optional argument: file name, relative to Saved/Profiling/SlotInventory."),
+    FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateStatic(&DumpTelemetryCsv));
+
+static FAutoConsoleCommandWithWorldArgsAndOutputDevice CmdSlotInventoryTelemetryReset(
+    TEXT("SlotInventory.Telemetry.Reset"),
+    TEXT("Resets the telemetry of every inventory of the world."),
+    FConsoleCommandWithWorldArgsAndOutputDeviceDelegate::CreateStatic(&ResetTelemetry));
@@ -0,0 +1,166 @@
+// Amasson
+
+
+#include "Persistence/SlotInventoryAsyncSave.h"
+#include "Components/SlotInventoryComponentBase.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "Misc/Compression.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "Serialization/ObjectAndNameAsStringProxyArchive.h"
+#include "SlotInventoryStats.h"
+
+
+namespace SlotInventoryAsyncSave
+{
+    static constexpr uint32 Magic = 0x53494E56; // SINV
+    /** Version 2 adds whether only the SaveGame properties were written, version 1 always did */
+    static constexpr uint32 Version = 2;
+
+    struct FSnapshot
+    {
+        TWeakObjectPtr<USlotInventoryComponentBase> Inventory;
+        uint32 ContentRevision = 0;
+        FInventoryContent Content;
+    };
+}
+
+void FSlotInventoryAsyncSave::SaveInventoriesAsync(TConstArrayView<USlotInventoryComponentBase*> Inventories, FOnSaveCompleted OnCompleted, bool bOnlyUnsaved)
+{
+    SLOTINVENTORY_SCOPE_CYCLE_COUNTER(SnapshotForSave);
+    check(IsInGameThread());
+
+    using namespace SlotInventoryAsyncSave;
+
+    TSharedRef<TArray<FSnapshot>, ESPMode::ThreadSafe> Snapshots = MakeShared<TArray<FSnapshot>, ESPMode::ThreadSafe>();
+    Snapshots->Reserve(Inventories.Num());
+
+    for (USlotInventoryComponentBase* Inventory : Inventories)
+    {
+        if (!IsValid(Inventory) || (bOnlyUnsaved && !Inventory->HasUnsavedChanges()))
+            continue;
+
+        FSnapshot& Snapshot = Snapshots->AddDefaulted_GetRef();
+        Snapshot.Inventory = Inventory;
+        Snapshot.ContentRevision = Inventory->GetContentRevision();
+        /** Dehydrated bytes keep every property, they are read back so that only the SaveGame ones are saved */
+        if (Inventory->IsContentHydrated() || Inventory->GetDehydratedContent().IsEmpty())
+            Snapshot.Content = Inventory->GetContent();
+        else
+            ensureMsgf(DeserializeContent(Inventory->GetDehydratedContent(), Snapshot.Content),
+                TEXT("Failed to read the dehydrated content of %s"), *Inventory->GetPathName());
+    }
+
+    Async(EAsyncExecution::TaskGraph, [Snapshots, OnCompleted = MoveTemp(OnCompleted)]() mutable
+    {
+        TRACE_CPUPROFILER_EVENT_SCOPE(SlotInventory_SerializeForSave);
+
+        TArray<FSlotInventorySaveRecord> Records;
+        Records.SetNum(Snapshots->Num());
+
+        ParallelFor(Snapshots->Num(), [&Records, &Snapshots](int32 SnapshotIndex)
+        {
+            FSnapshot& Snapshot = (*Snapshots)[SnapshotIndex];
+            FSlotInventorySaveRecord& Record = Records[SnapshotIndex];
+            Record.Inventory = Snapshot.Inventory;
+            Record.ContentRevision = Snapshot.ContentRevision;
+            SerializeContent(Snapshot.Content, Record.Bytes);
+        });
+
+        AsyncTask(ENamedThreads::GameThread, [Records = MoveTemp(Records), OnCompleted = MoveTemp(OnCompleted)]() mutable
+        {
+            for (const FSlotInventorySaveRecord& Record : Records)
+            {
+                if (USlotInventoryComponentBase* Inventory = Record.Inventory.Get())
+                    Inventory->MarkContentSaved(Record.ContentRevision);
+            }
+
+            if (OnCompleted)
+                OnCompleted(MoveTemp(Records));
+        });
+    });
+}
+
+bool FSlotInventoryAsyncSave::SerializeContent(const FInventoryContent& Content, TArray<uint8>& OutBytes, bool bSaveGameOnly)
+{
+    using namespace SlotInventoryAsyncSave;
+
+    TArray<uint8> RawBytes;
+    FMemoryWriter RawWriter(RawBytes);
+    FObjectAndNameAsStringProxyArchive RawArchive(RawWriter, false);
+    RawArchive.ArIsSaveGame = bSaveGameOnly;
+    FInventoryContent::StaticStruct()->SerializeItem(RawArchive, const_cast<FInventoryContent*>(&Content), nullptr);
+
+    if (RawArchive.IsError())
+        return false;
+
+    int32 CompressedSize = FCompression::CompressMemoryBound(NAME_Zlib, RawBytes.Num());
+    TArray<uint8> CompressedBytes;
+    CompressedBytes.SetNumUninitialized(CompressedSize);
+    if (!FCompression::CompressMemory(NAME_Zlib, CompressedBytes.GetData(), CompressedSize, RawBytes.GetData(), RawBytes.Num()))
+        return false;
+    CompressedBytes.SetNum(CompressedSize, false);
+
+    OutBytes.Reset();
+    FMemoryWriter Writer(OutBytes);
+    uint32 HeaderMagic = Magic;
+    uint32 HeaderVersion = Version;
+    int32 UncompressedSize = RawBytes.Num();
+    bool bHeaderSaveGameOnly = bSaveGameOnly;
+    Writer << HeaderMagic << HeaderVersion << UncompressedSize << bHeaderSaveGameOnly;
+    Writer << CompressedBytes;
+
+    return !Writer.IsError();
+}
+
+bool FSlotInventoryAsyncSave::DeserializeContent(const TArray<uint8>& Bytes, FInventoryContent& OutContent)
+{
+    using namespace SlotInventoryAsyncSave;
+    check(IsInGameThread());
+
+    FMemoryReader Reader(Bytes);
+    uint32 HeaderMagic = 0;
+    uint32 HeaderVersion = 0;
+    int32 UncompressedSize = 0;
+    TArray<uint8> CompressedBytes;
+    Reader << HeaderMagic << HeaderVersion << UncompressedSize;
+
+    if (Reader.IsError() || HeaderMagic != Magic || HeaderVersion > Version || UncompressedSize < 0)
+        return false;
+
+    bool bSaveGameOnly = true;
+    if (HeaderVersion >= 2)
+        Reader << bSaveGameOnly;
+
+    Reader << CompressedBytes;
+    if (Reader.IsError())
+        return false;
+
+    TArray<uint8> RawBytes;
+    RawBytes.SetNumUninitialized(UncompressedSize);
+    if (!FCompression::UncompressMemory(NAME_Zlib, RawBytes.GetData(), UncompressedSize, CompressedBytes.GetData(), CompressedBytes.Num()))
+        return false;
+
+    FMemoryReader RawReader(RawBytes);
+    FObjectAndNameAsStringProxyArchive RawArchive(RawReader, true);
+    RawArchive.ArIsSaveGame = bSaveGameOnly;
+    OutContent = FInventoryContent();
+    FInventoryContent::StaticStruct()->SerializeItem(RawArchive, &OutContent, nullptr);
+
+    return !RawArchive.IsError();
+}
+
+bool FSlotInventoryAsyncSave::LoadInventory(USlotInventoryComponentBase* Inventory, const TArray<uint8>& Bytes)
+{
+    if (!IsValid(Inventory))
+        return false;
+
+    FInventoryContent Content;
+    if (!DeserializeContent(Bytes, Content))
+        return false;
+
+    Inventory->SetContent(Content);
+    Inventory->MarkContentSaved(Inventory->GetContentRevision());
+    return true;
+}
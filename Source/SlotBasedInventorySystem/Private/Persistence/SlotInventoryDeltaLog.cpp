@@ -0,0 +1,586 @@
+// Amasson
+
+
+#include "Persistence/SlotInventoryDeltaLog.h"
+#include "Persistence/SlotInventoryAsyncSave.h"
+#include "Components/SlotInventoryComponentBase.h"
+#include "Async/Async.h"
+#include "Async/ParallelFor.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/Compression.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "Serialization/ObjectAndNameAsStringProxyArchive.h"
+#include "SlotInventoryStats.h"
+
+
+static TAutoConsoleVariable<int32> CVarSlotInventoryCheckpointKB(
+    TEXT("SlotInventory.Persistence.CheckpointKB"),
+    4096,
+    TEXT("Size of the inventory delta log above which the next save writes a checkpoint instead of appending."),
+    ECVF_Default);
+
+
+/** Slots changed since the last save, or the full content of an inventory */
+struct FSlotInventoryDeltaLog::FRecord
+{
+    FName Id;
+
+    bool bFullContent = false;
+
+    /** Slots record */
+    int32 Capacity = 0;
+    TArray<TPair<int32, FInventorySlot>> Slots;
+
+    /** Full content record, serialized on the writer */
+    FContentData Data;
+};
+
+namespace SlotInventoryDeltaLog
+{
+    static constexpr uint32 Magic = 0x5349444C; // SIDL
+    static constexpr uint32 Version = 1;
+
+    /** Bytes of full content records are in the FSlotInventoryAsyncSave format */
+    static void SerializeRecord(FArchive& Ar, FName& Id, bool& bFullContent, int32& Capacity, TArray<TPair<int32, FInventorySlot>>& Slots, TArray<uint8>& Bytes)
+    {
+        Ar << Id << bFullContent;
+        if (bFullContent)
+        {
+            Ar << Bytes;
+            return;
+        }
+
+        int32 NumSlots = Slots.Num();
+        Ar << Capacity << NumSlots;
+        if (Ar.IsLoading())
+        {
+            if (NumSlots < 0 || Capacity < 0)
+            {
+                Ar.SetError();
+                return;
+            }
+            Slots.SetNum(NumSlots);
+        }
+        for (TPair<int32, FInventorySlot>& Slot : Slots)
+        {
+            Ar << Slot.Key;
+            FInventorySlot::StaticStruct()->SerializeItem(Ar, &Slot.Value, nullptr);
+        }
+    }
+
+    /** Frame: header, generation and the compressed records */
+    static bool WriteFrame(uint32 Generation, const TArray<uint8>& RawBytes, TArray<uint8>& OutBytes)
+    {
+        int32 CompressedSize = FCompression::CompressMemoryBound(NAME_Zlib, RawBytes.Num());
+        TArray<uint8> CompressedBytes;
+        CompressedBytes.SetNumUninitialized(CompressedSize);
+        if (!FCompression::CompressMemory(NAME_Zlib, CompressedBytes.GetData(), CompressedSize, RawBytes.GetData(), RawBytes.Num()))
+            return false;
+        CompressedBytes.SetNum(CompressedSize, false);
+
+        OutBytes.Reset();
+        FMemoryWriter Writer(OutBytes);
+        uint32 HeaderMagic = Magic;
+        uint32 HeaderVersion = Version;
+        int32 UncompressedSize = RawBytes.Num();
+        Writer << HeaderMagic << HeaderVersion << Generation << UncompressedSize;
+        Writer << CompressedBytes;
+
+        return !Writer.IsError();
+    }
+
+    static bool ReadFrame(FArchive& Reader, uint32& OutGeneration, TArray<uint8>& OutRawBytes)
+    {
+        uint32 HeaderMagic = 0;
+        uint32 HeaderVersion = 0;
+        int32 UncompressedSize = 0;
+        Reader << HeaderMagic << HeaderVersion << OutGeneration << UncompressedSize;
+
+        if (Reader.IsError() || HeaderMagic != Magic || HeaderVersion > Version || UncompressedSize < 0)
+            return false;
+
+        TArray<uint8> CompressedBytes;
+        Reader << CompressedBytes;
+        if (Reader.IsError())
+            return false;
+
+        OutRawBytes.SetNumUninitialized(UncompressedSize);
+        return FCompression::UncompressMemory(NAME_Zlib, OutRawBytes.GetData(), UncompressedSize, CompressedBytes.GetData(), CompressedBytes.Num());
+    }
+}
+
+FSlotInventoryDeltaLog::FSlotInventoryDeltaLog(const FString& InDirectory)
+    : Directory(FPaths::IsRelative(InDirectory) ? FPaths::ProjectSavedDir() / TEXT("SaveGames") / InDirectory : InDirectory)
+{
+    CheckpointPath = Directory / TEXT("Checkpoint.sidl");
+    DeltasPath = Directory / TEXT("Deltas.sidl");
+}
+
+
+/** Inventories */
+
+void FSlotInventoryDeltaLog::RegisterInventory(FName Id, USlotInventoryComponentBase* Inventory)
+{
+    check(IsInGameThread());
+
+    if (!IsValid(Inventory))
+        return;
+
+    Inventories.Add(Id, Inventory);
+    Inventory->SetTrackUnsavedSlots(true);
+
+    if (FContentData* Data = UnregisteredContents.Find(Id))
+    {
+        ApplyLoadedContent(Inventory, *Data);
+        UnregisteredContents.Remove(Id);
+    }
+    else if (bLoaded)
+    {
+        /** Not in the log yet */
+        FullContentIds.Add(Id);
+    }
+}
+
+void FSlotInventoryDeltaLog::UnregisterInventory(FName Id)
+{
+    check(IsInGameThread());
+
+    TWeakObjectPtr<USlotInventoryComponentBase> WeakInventory;
+    if (!Inventories.RemoveAndCopyValue(Id, WeakInventory))
+        return;
+
+    USlotInventoryComponentBase* Inventory = WeakInventory.Get();
+    if (!IsValid(Inventory))
+        return;
+
+    TSet<int32> UnsavedSlots;
+    int32 UnsavedMinCapacity = INDEX_NONE;
+    Inventory->TakeUnsavedSlots(UnsavedSlots, UnsavedMinCapacity);
+    if (!UnsavedSlots.IsEmpty() || UnsavedMinCapacity != INDEX_NONE)
+        FullContentIds.Add(Id);
+    Inventory->SetTrackUnsavedSlots(false);
+
+    if (bLoaded)
+        CopyContent(Inventory, UnregisteredContents.Add(Id));
+}
+
+void FSlotInventoryDeltaLog::CopyContent(const USlotInventoryComponentBase* Inventory, FContentData& OutData)
+{
+    /** Dehydrated bytes keep every property, they are read back so that only the SaveGame ones are logged */
+    if (!Inventory->IsContentHydrated() && !Inventory->GetDehydratedContent().IsEmpty())
+        ensureMsgf(FSlotInventoryAsyncSave::DeserializeContent(Inventory->GetDehydratedContent(), OutData.Content),
+            TEXT("Failed to read the dehydrated content of %s"), *Inventory->GetPathName());
+    else
+        OutData.Content = Inventory->GetContent();
+}
+
+void FSlotInventoryDeltaLog::ApplyLoadedContent(USlotInventoryComponentBase* Inventory, FContentData& Data)
+{
+    if (!Data.Bytes.IsEmpty() && !FSlotInventoryAsyncSave::DeserializeContent(Data.Bytes, Data.Content))
+        return;
+
+    Inventory->SetContent(Data.Content);
+
+    /** The loaded content is what the log already holds */
+    TSet<int32> UnsavedSlots;
+    int32 UnsavedMinCapacity = INDEX_NONE;
+    Inventory->TakeUnsavedSlots(UnsavedSlots, UnsavedMinCapacity);
+    Inventory->MarkContentSaved(Inventory->GetContentRevision());
+}
+
+
+/** Load */
+
+bool FSlotInventoryDeltaLog::Load()
+{
+    SLOTINVENTORY_SCOPE_CYCLE_COUNTER(LoadDeltaLog);
+    check(IsInGameThread());
+
+    using namespace SlotInventoryDeltaLog;
+
+    WaitForWrites();
+
+    TMap<FName, FContentData> Contents;
+    bool bSuccess = true;
+
+    /** Records are applied in order, the last full content of an id replaces everything before it */
+    auto ReadRecords = [&Contents](const TArray<uint8>& RawBytes)
+    {
+        FMemoryReader RawReader(RawBytes);
+        FObjectAndNameAsStringProxyArchive RawArchive(RawReader, true);
+        RawArchive.ArIsSaveGame = true;
+
+        int32 NumRecords = 0;
+        RawArchive << NumRecords;
+        for (int32 RecordIndex = 0; RecordIndex < NumRecords && !RawArchive.IsError(); RecordIndex++)
+        {
+            FRecord Record;
+            SerializeRecord(RawArchive, Record.Id, Record.bFullContent, Record.Capacity, Record.Slots, Record.Data.Bytes);
+            if (RawArchive.IsError())
+                break;
+
+            FContentData& Data = Contents.FindOrAdd(Record.Id);
+            if (Record.bFullContent)
+            {
+                Data.Content = FInventoryContent();
+                if (!FSlotInventoryAsyncSave::DeserializeContent(Record.Data.Bytes, Data.Content))
+                    return false;
+                continue;
+            }
+
+            Data.Content.SetCapacity(Record.Capacity);
+            for (TPair<int32, FInventorySlot>& Slot : Record.Slots)
+            {
+                if (!Data.Content.IsValidIndex(Slot.Key))
+                    continue;
+                /** Do not allocate sparse pages for slots that stay empty */
+                if (Slot.Value.IsEmpty() && Data.Content.GetSlotConstPtrAtIndex(Slot.Key)->IsEmpty())
+                    continue;
+                *Data.Content.GetSlotPtrAtIndex(Slot.Key) = MoveTemp(Slot.Value);
+            }
+        }
+        return !RawArchive.IsError();
+    };
+
+    Generation = 0;
+    TArray<uint8> FileBytes;
+    TArray<uint8> RawBytes;
+    if (FFileHelper::LoadFileToArray(FileBytes, *CheckpointPath, FILEREAD_Silent))
+    {
+        FMemoryReader Reader(FileBytes, true);
+        bSuccess = ReadFrame(Reader, Generation, RawBytes) && ReadRecords(RawBytes);
+    }
+
+    DeltaBytes = 0;
+    if (bSuccess && FFileHelper::LoadFileToArray(FileBytes, *DeltasPath, FILEREAD_Silent))
+    {
+        DeltaBytes = FileBytes.Num();
+
+        FMemoryReader Reader(FileBytes, true);
+        while (Reader.Tell() < Reader.TotalSize())
+        {
+            uint32 FrameGeneration = 0;
+            if (!ReadFrame(Reader, FrameGeneration, RawBytes))
+            {
+                /** Torn frame of an interrupted write, frames appended after it could not be read back */
+                bCheckpointRequired = true;
+                break;
+            }
+
+            /** Left over from before the last checkpoint */
+            if (FrameGeneration != Generation)
+                continue;
+
+            if (!ReadRecords(RawBytes))
+            {
+                bCheckpointRequired = true;
+                break;
+            }
+        }
+    }
+
+    if (!bSuccess)
+        return false;
+
+    for (TPair<FName, FContentData>& Pair : Contents)
+    {
+        USlotInventoryComponentBase* Inventory = Inventories.FindRef(Pair.Key).Get();
+        if (IsValid(Inventory))
+            ApplyLoadedContent(Inventory, Pair.Value);
+        else
+            UnregisteredContents.Add(Pair.Key, MoveTemp(Pair.Value));
+    }
+
+    /** Inventories registered before loading that the log does not know yet */
+    for (const TPair<FName, TWeakObjectPtr<USlotInventoryComponentBase>>& Pair : Inventories)
+    {
+        if (!Contents.Contains(Pair.Key))
+            FullContentIds.Add(Pair.Key);
+    }
+
+    WrittenGeneration = Generation;
+    bLoaded = true;
+    return true;
+}
+
+
+/** Save */
+
+void FSlotInventoryDeltaLog::SaveAsync(FOnWriteCompleted OnCompleted)
+{
+    check(IsInGameThread());
+
+    if (!ensureMsgf(bLoaded, TEXT("Load the inventory delta log before saving")))
+    {
+        if (OnCompleted)
+            OnCompleted(false);
+        return;
+    }
+
+    if (bCheckpointRequired || DeltaBytes > (int64)CVarSlotInventoryCheckpointKB.GetValueOnGameThread() * 1024)
+    {
+        CheckpointAsync(MoveTemp(OnCompleted));
+        return;
+    }
+
+    SLOTINVENTORY_SCOPE_CYCLE_COUNTER(SnapshotDeltas);
+
+    TArray<FRecord> Records;
+
+    for (const TPair<FName, TWeakObjectPtr<USlotInventoryComponentBase>>& Pair : Inventories)
+    {
+        USlotInventoryComponentBase* Inventory = Pair.Value.Get();
+        if (!IsValid(Inventory))
+            continue;
+
+        TSet<int32> UnsavedSlots;
+        int32 UnsavedMinCapacity = INDEX_NONE;
+        Inventory->TakeUnsavedSlots(UnsavedSlots, UnsavedMinCapacity);
+
+        if (FullContentIds.Remove(Pair.Key) > 0)
+        {
+            FRecord& Record = Records.AddDefaulted_GetRef();
+            Record.Id = Pair.Key;
+            Record.bFullContent = true;
+            CopyContent(Inventory, Record.Data);
+            continue;
+        }
+
+        if (UnsavedSlots.IsEmpty() && UnsavedMinCapacity == INDEX_NONE)
+            continue;
+
+        const FInventoryContent& Content = Inventory->GetContent();
+        FRecord& Record = Records.AddDefaulted_GetRef();
+        Record.Id = Pair.Key;
+        Record.Capacity = Content.GetCapacity();
+        Record.Slots.Reserve(UnsavedSlots.Num());
+        for (int32 SlotIndex : UnsavedSlots)
+        {
+            if (Content.IsValidIndex(SlotIndex))
+                Record.Slots.Emplace(SlotIndex, *Content.GetSlotConstPtrAtIndex(SlotIndex));
+        }
+
+        /** A shrink then grow emptied the slots in between, the replayed capacity alone would bring back the older values */
+        if (UnsavedMinCapacity != INDEX_NONE)
+        {
+            for (int32 SlotIndex = UnsavedMinCapacity; SlotIndex < Record.Capacity; SlotIndex++)
+            {
+                if (!UnsavedSlots.Contains(SlotIndex))
+                    Record.Slots.Emplace(SlotIndex, *Content.GetSlotConstPtrAtIndex(SlotIndex));
+            }
+        }
+        INC_DWORD_STAT_BY(STAT_SlotInventory_DeltaSlotsSaved, Record.Slots.Num());
+    }
+
+    for (auto It = FullContentIds.CreateIterator(); It; ++It)
+    {
+        if (const FContentData* Data = UnregisteredContents.Find(*It))
+        {
+            FRecord& Record = Records.AddDefaulted_GetRef();
+            Record.Id = *It;
+            Record.bFullContent = true;
+            Record.Data = *Data;
+            It.RemoveCurrent();
+        }
+    }
+
+    WriteRecordsAsync(MoveTemp(Records), false, MoveTemp(OnCompleted));
+}
+
+void FSlotInventoryDeltaLog::CheckpointAsync(FOnWriteCompleted OnCompleted)
+{
+    SLOTINVENTORY_SCOPE_CYCLE_COUNTER(SnapshotCheckpoint);
+    check(IsInGameThread());
+
+    if (!ensureMsgf(bLoaded, TEXT("Load the inventory delta log before saving")))
+    {
+        if (OnCompleted)
+            OnCompleted(false);
+        return;
+    }
+
+    TArray<FRecord> Records;
+    Records.Reserve(Inventories.Num() + UnregisteredContents.Num());
+
+    for (const TPair<FName, TWeakObjectPtr<USlotInventoryComponentBase>>& Pair : Inventories)
+    {
+        USlotInventoryComponentBase* Inventory = Pair.Value.Get();
+        if (!ensureMsgf(IsValid(Inventory), TEXT("Inventory %s was destroyed without being unregistered from the delta log"), *Pair.Key.ToString()))
+            continue;
+
+        TSet<int32> UnsavedSlots;
+        int32 UnsavedMinCapacity = INDEX_NONE;
+        Inventory->TakeUnsavedSlots(UnsavedSlots, UnsavedMinCapacity);
+
+        FRecord& Record = Records.AddDefaulted_GetRef();
+        Record.Id = Pair.Key;
+        Record.bFullContent = true;
+        CopyContent(Inventory, Record.Data);
+    }
+
+    for (const TPair<FName, FContentData>& Pair : UnregisteredContents)
+    {
+        FRecord& Record = Records.AddDefaulted_GetRef();
+        Record.Id = Pair.Key;
+        Record.bFullContent = true;
+        Record.Data = Pair.Value;
+    }
+
+    FullContentIds.Reset();
+    bCheckpointRequired = false;
+    Generation++;
+
+    WriteRecordsAsync(MoveTemp(Records), true, MoveTemp(OnCompleted));
+}
+
+void FSlotInventoryDeltaLog::WriteRecordsAsync(TArray<FRecord>&& Records, bool bCheckpoint, FOnWriteCompleted&& OnCompleted)
+{
+    using namespace SlotInventoryDeltaLog;
+
+    if (Records.IsEmpty() && !bCheckpoint)
+    {
+        if (OnCompleted)
+            OnCompleted(true);
+        return;
+    }
+
+    /** Saved inventories are marked as saved at the revision they were copied */
+    TArray<TPair<TWeakObjectPtr<USlotInventoryComponentBase>, uint32>> SavedRevisions;
+    SavedRevisions.Reserve(Records.Num());
+    for (const FRecord& Record : Records)
+    {
+        if (USlotInventoryComponentBase* Inventory = Inventories.FindRef(Record.Id).Get())
+            SavedRevisions.Emplace(Inventory, Inventory->GetContentRevision());
+    }
+
+    const uint32 RecordsGeneration = Generation;
+
+    EnqueueWrite([this, Records = MoveTemp(Records), SavedRevisions = MoveTemp(SavedRevisions), OnCompleted = MoveTemp(OnCompleted), RecordsGeneration, bCheckpoint]() mutable
+    {
+        TRACE_CPUPROFILER_EVENT_SCOPE(SlotInventory_WriteDeltaLog);
+
+        ParallelFor(Records.Num(), [&Records](int32 RecordIndex)
+        {
+            FContentData& Data = Records[RecordIndex].Data;
+            if (Records[RecordIndex].bFullContent && Data.Bytes.IsEmpty())
+                FSlotInventoryAsyncSave::SerializeContent(Data.Content, Data.Bytes);
+        });
+
+        TArray<uint8> RawBytes;
+        FMemoryWriter RawWriter(RawBytes);
+        FObjectAndNameAsStringProxyArchive RawArchive(RawWriter, false);
+        RawArchive.ArIsSaveGame = true;
+
+        int32 NumRecords = Records.Num();
+        RawArchive << NumRecords;
+        for (FRecord& Record : Records)
+            SerializeRecord(RawArchive, Record.Id, Record.bFullContent, Record.Capacity, Record.Slots, Record.Data.Bytes);
+
+        TArray<uint8> FrameBytes;
+        bool bSuccess = !RawArchive.IsError() && WriteFrame(RecordsGeneration, RawBytes, FrameBytes);
+
+        if (bSuccess && bCheckpoint)
+        {
+            /** Replace the checkpoint atomically, the old deltas are skipped on load once it has a new generation */
+            const FString TempPath = CheckpointPath + TEXT(".tmp");
+            bSuccess = FFileHelper::SaveArrayToFile(FrameBytes, *TempPath) && IFileManager::Get().Move(*CheckpointPath, *TempPath, true);
+            if (bSuccess)
+            {
+                WrittenGeneration = RecordsGeneration;
+                IFileManager::Get().Delete(*DeltasPath, false, false, true);
+                DeltaBytes = FMath::Max<int64>(IFileManager::Get().FileSize(*DeltasPath), 0);
+            }
+        }
+        else if (bSuccess)
+        {
+            /** Frames of a generation whose checkpoint failed would be skipped on load */
+            TUniquePtr<FArchive> File(RecordsGeneration == WrittenGeneration ? IFileManager::Get().CreateFileWriter(*DeltasPath, FILEWRITE_Append) : nullptr);
+            if (File)
+            {
+                File->Serialize(FrameBytes.GetData(), FrameBytes.Num());
+                bSuccess = File->Close();
+                DeltaBytes += FrameBytes.Num();
+            }
+            else
+            {
+                bSuccess = false;
+            }
+        }
+
+        AsyncTask(ENamedThreads::GameThread, [Log = AsShared(), SavedRevisions = MoveTemp(SavedRevisions), OnCompleted = MoveTemp(OnCompleted), bSuccess]()
+        {
+            if (bSuccess)
+            {
+                for (const TPair<TWeakObjectPtr<USlotInventoryComponentBase>, uint32>& Saved : SavedRevisions)
+                {
+                    if (USlotInventoryComponentBase* Inventory = Saved.Key.Get())
+                        Inventory->MarkContentSaved(Saved.Value);
+                }
+            }
+            else
+            {
+                /** The tracked slots were already taken, only a checkpoint has them all again */
+                Log->bCheckpointRequired = true;
+            }
+
+            if (OnCompleted)
+                OnCompleted(bSuccess);
+        });
+    });
+}
+
+void FSlotInventoryDeltaLog::EnqueueWrite(TUniqueFunction<void()>&& Write)
+{
+    bool bStartWriter = false;
+    {
+        FScopeLock Lock(&WriteLock);
+        PendingWrites.Add(MoveTemp(Write));
+        bStartWriter = !bWriterRunning;
+        bWriterRunning = true;
+    }
+
+    if (bStartWriter)
+    {
+        Async(EAsyncExecution::TaskGraph, [Log = AsShared()]()
+        {
+            Log->DrainWrites();
+        });
+    }
+}
+
+void FSlotInventoryDeltaLog::DrainWrites()
+{
+    for (;;)
+    {
+        TArray<TUniqueFunction<void()>> Writes;
+        {
+            FScopeLock Lock(&WriteLock);
+            if (PendingWrites.IsEmpty())
+            {
+                bWriterRunning = false;
+                return;
+            }
+            Writes = MoveTemp(PendingWrites);
+        }
+
+        for (TUniqueFunction<void()>& Write : Writes)
+            Write();
+    }
+}
+
+void FSlotInventoryDeltaLog::WaitForWrites()
+{
+    for (;;)
+    {
+        {
+            FScopeLock Lock(&WriteLock);
+            if (!bWriterRunning)
+                return;
+        }
+        FPlatformProcess::Sleep(0.001f);
+    }
+}
@@ -6,6 +6,9 @@
 #include "JsonObjectConverter.h"
 #include "Components/SlotInventoryComponentBase.h"
 #include "Interfaces/InventoryHolderInterface.h"
+#include "Subsystems/SlotInventorySubsystem.h"
+#include "Transactions/SlotInventoryBatchEditScope.h"
+#include "Engine/World.h"
 
 
 bool USlotInventoryBlueprintLibrary::IsEmptySlot(const FInventorySlot& Slot)
@@ -54,6 +57,37 @@ FItemModifier& USlotInventoryBlueprintLibrary::SlotGetOrMakeModifier(FInventoryS
 
 /** Inventory Content */
 
+int32 USlotInventoryBlueprintLibrary::GetContentCapacity(const FInventoryContent& Content)
+{
+    return Content.GetCapacity();
+}
+
+void USlotInventoryBlueprintLibrary::GetContentSlots(const FInventoryContent& Content, TArray<FInventorySlot>& Slots)
+{
+    Content.CopySlots(Slots);
+}
+
+void USlotInventoryBlueprintLibrary::SetContentSlots(FInventoryContent& Content, const TArray<FInventorySlot>& Slots)
+{
+    Content.SetSlots(Slots);
+}
+
+FInventorySlot USlotInventoryBlueprintLibrary::GetContentSlotAtIndex(const FInventoryContent& Content, int32 Index)
+{
+    if (const FInventorySlot* SlotPtr = Content.GetSlotConstPtrAtIndex(Index))
+        return *SlotPtr;
+    return FInventorySlot();
+}
+
+bool USlotInventoryBlueprintLibrary::SetContentSlotAtIndex(FInventoryContent& Content, int32 Index, const FInventorySlot& Slot)
+{
+    FInventorySlot* SlotPtr = Content.GetSlotPtrAtIndex(Index);
+    if (SlotPtr == nullptr)
+        return false;
+    *SlotPtr = Slot;
+    return true;
+}
+
 bool USlotInventoryBlueprintLibrary::IsValidIndex(const FInventoryContent& Content, int32 Index)
 {
     return Content.IsValidIndex(Index);
@@ -69,31 +103,33 @@ bool USlotInventoryBlueprintLibrary::IsEmptySlotAtIndex(const FInventoryContent&
 
 int32 USlotInventoryBlueprintLibrary::GetEmptySlotCounts(const FInventoryContent& Content)
 {
-    int32 Total = 0;
+    int32 NumOccupied = 0;
 
-    for (const FInventorySlot& Slot : Content.Slots)
+    Content.ForEachStoredSlot([&NumOccupied](int32 SlotIndex, const FInventorySlot& Slot)
     {
-        if (Slot.IsEmpty())
-            ++Total;
-    }
-    return Total;
+        if (!Slot.IsEmpty())
+            ++NumOccupied;
+    });
+    return Content.GetCapacity() - NumOccupied;
 }
 
 bool USlotInventoryBlueprintLibrary::ContainsOnlyEmptySlots(const FInventoryContent& Content)
 {
-    for (const FInventorySlot& Slot : Content.Slots)
+    bool bOnlyEmptySlots = true;
+
+    Content.ForEachStoredSlot([&bOnlyEmptySlots](int32 SlotIndex, const FInventorySlot& Slot)
     {
         if (!Slot.IsEmpty())
-            return false;
-    }
-    return true;
+            bOnlyEmptySlots = false;
+    });
+    return bOnlyEmptySlots;
 }
 
 int32 USlotInventoryBlueprintLibrary::GetFirstEmptySlotIndex(const FInventoryContent& Content)
 {
-    for (int32 i = 0; i < Content.Slots.Num(); i++)
+    for (int32 i = 0; i < Content.GetCapacity(); i++)
     {
-        if (Content.Slots[i].IsEmpty())
+        if (Content.GetSlotConstPtrAtIndex(i)->IsEmpty())
             return i;
     }
     return -1;
@@ -103,25 +139,75 @@ int32 USlotInventoryBlueprintLibrary::GetItemQuantity(const FInventoryContent& C
 {
     int32 Total = 0;
 
-    for (const FInventorySlot& Slot : Content.Slots)
+    Content.ForEachStoredSlot([&Total, &Item](int32 SlotIndex, const FInventorySlot& Slot)
     {
-        if (Slot.IsEmpty()) continue;
+        if (Slot.IsEmpty()) return;
 
         if (Slot.Item == Item)
             Total += Slot.Quantity;
-    }
+    });
     return Total;
 }
 
 
+/** Crafting */
+
+void USlotInventoryBlueprintLibrary::GetCraftableCounts(const TArray<FInventoryContent>& Contents, const TArray<FSlotInventoryRecipe>& Recipes, TArray<int32>& CraftableCounts)
+{
+    FSlotInventoryCraftabilityEvaluator Evaluator;
+    Evaluator.Compile(Recipes);
+    for (const FInventoryContent& Content : Contents)
+        Evaluator.AddSource(Content);
+    CraftableCounts = Evaluator.Evaluate();
+}
+
+
+/** Transactions */
+
+bool USlotInventoryBlueprintLibrary::TryModifyInventoriesWithoutOverflow(const TArray<FSlotInventoryModification>& Modifications)
+{
+    FSlotInventoryTransaction Transaction;
+    for (const FSlotInventoryModification& Modification : Modifications)
+    {
+        if (!Transaction.ModifyContent(Modification.Inventory, Modification.Items))
+            break;
+    }
+    return Transaction.Commit();
+}
+
+void USlotInventoryBlueprintLibrary::BeginInventoryBatchEdit()
+{
+    FSlotInventoryBatchEditScope::Begin();
+}
+
+void USlotInventoryBlueprintLibrary::EndInventoryBatchEdit()
+{
+    FSlotInventoryBatchEditScope::End();
+}
+
+
 /** Inventory Component */
 
 USlotInventoryComponentBase* USlotInventoryBlueprintLibrary::GetInventoryComponent(UObject* Holder, FName InventoryTag)
 {
+    if (!IsValid(Holder))
+        return nullptr;
+
+    /** Holders choose among their inventories themselves */
     if (Holder->GetClass()->ImplementsInterface(UInventoryHolderInterface::StaticClass()))
         return IInventoryHolderInterface::Execute_GetInventoryComponent(Holder, InventoryTag);
 
-    if (AActor* Actor = Cast<AActor>(Holder); InventoryTag == NAME_None)
+    /** Inventories in play are registered by owner and tag, only trusted when no other inventory shares them */
+    if (const UWorld* World = Holder->GetWorld())
+    {
+        if (const USlotInventorySubsystem* Subsystem = World->GetSubsystem<USlotInventorySubsystem>())
+        {
+            if (USlotInventoryComponentBase* Inventory = Subsystem->FindUniqueInventory(Holder, InventoryTag))
+                return Inventory;
+        }
+    }
+
+    if (AActor* Actor = Cast<AActor>(Holder); Actor && InventoryTag == NAME_None)
         return Actor->FindComponentByClass<USlotInventoryComponentBase>();
 
     return nullptr;
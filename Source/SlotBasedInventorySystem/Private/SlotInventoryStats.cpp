@@ -0,0 +1,69 @@
+// Amasson
+
+
+#include "SlotInventoryStats.h"
+
+DEFINE_STAT(STAT_SlotInventory_SetContent);
+DEFINE_STAT(STAT_SlotInventory_SetContentCapacity);
+DEFINE_STAT(STAT_SlotInventory_ModifySlotQuantity);
+DEFINE_STAT(STAT_SlotInventory_ModifyContent);
+DEFINE_STAT(STAT_SlotInventory_TryModifyContent);
+DEFINE_STAT(STAT_SlotInventory_DropSlotAtIndex);
+DEFINE_STAT(STAT_SlotInventory_DropSlot);
+DEFINE_STAT(STAT_SlotInventory_RegroupSimilarItems);
+DEFINE_STAT(STAT_SlotInventory_ReceiveStacks);
+DEFINE_STAT(STAT_SlotInventory_ParallelModifyContents);
+
+DEFINE_STAT(STAT_SlotInventory_TransactionStage);
+DEFINE_STAT(STAT_SlotInventory_TransactionCommit);
+DEFINE_STAT(STAT_SlotInventory_TransactionAbort);
+DEFINE_STAT(STAT_SlotInventory_FlushBatchEdit);
+
+DEFINE_STAT(STAT_SlotInventory_AggregateModifyContent);
+
+DEFINE_STAT(STAT_SlotInventory_PublishSnapshot);
+
+DEFINE_STAT(STAT_SlotInventory_DrainCommands);
+
+DEFINE_STAT(STAT_SlotInventory_ProcessDeferredRequests);
+DEFINE_STAT(STAT_SlotInventory_RequestsWaiting);
+
+DEFINE_STAT(STAT_SlotInventory_RegistryRadiusQuery);
+
+DEFINE_STAT(STAT_SlotInventory_CompactMemory);
+DEFINE_STAT(STAT_SlotInventory_CompactIdleInventories);
+
+DEFINE_STAT(STAT_SlotInventory_HydrateContent);
+DEFINE_STAT(STAT_SlotInventory_DehydrateContent);
+DEFINE_STAT(STAT_SlotInventory_Hydrations);
+DEFINE_STAT(STAT_SlotInventory_Dehydrations);
+
+DEFINE_STAT(STAT_SlotInventory_MaintainInventories);
+DEFINE_STAT(STAT_SlotInventory_BackgroundMaintenance);
+DEFINE_STAT(STAT_SlotInventory_MaintenanceSlotsModified);
+
+DEFINE_STAT(STAT_SlotInventory_SnapshotForSave);
+DEFINE_STAT(STAT_SlotInventory_SnapshotDeltas);
+DEFINE_STAT(STAT_SlotInventory_SnapshotCheckpoint);
+DEFINE_STAT(STAT_SlotInventory_LoadDeltaLog);
+
+DEFINE_STAT(STAT_SlotInventory_BroadcastContentUpdate);
+DEFINE_STAT(STAT_SlotInventory_OnInventoryContentChanged);
+DEFINE_STAT(STAT_SlotInventory_OnInventorySlotsChanged);
+DEFINE_STAT(STAT_SlotInventory_ViewModelSlotsChanged);
+DEFINE_STAT(STAT_SlotInventory_OnInventoryCapacityChanged);
+DEFINE_STAT(STAT_SlotInventory_BroadcastModifiedSlotsToClients);
+DEFINE_STAT(STAT_SlotInventory_BroadcastFullInventory);
+DEFINE_STAT(STAT_SlotInventory_ReceivedUpdateSlotsValues);
+
+DEFINE_STAT(STAT_SlotInventory_SlotsScanned);
+DEFINE_STAT(STAT_SlotInventory_SlotsDirtied);
+DEFINE_STAT(STAT_SlotInventory_Flushes);
+DEFINE_STAT(STAT_SlotInventory_SlotUpdatesSent);
+DEFINE_STAT(STAT_SlotInventory_SlotUpdateBytesSent);
+DEFINE_STAT(STAT_SlotInventory_CommandsExecuted);
+DEFINE_STAT(STAT_SlotInventory_RequestsAccepted);
+DEFINE_STAT(STAT_SlotInventory_RequestsDeferred);
+DEFINE_STAT(STAT_SlotInventory_RequestsRejected);
+DEFINE_STAT(STAT_SlotInventory_DormancyWakes);
+DEFINE_STAT(STAT_SlotInventory_DeltaSlotsSaved);
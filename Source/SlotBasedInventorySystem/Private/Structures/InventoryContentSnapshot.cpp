@@ -0,0 +1,230 @@
+// Amasson
+
+
+#include "Structures/InventoryContentSnapshot.h"
+#include "SlotInventoryStats.h"
+
+
+/** Snapshot */
+
+int32 FInventoryContentSnapshot::GetCapacity() const
+{
+    return Capacity;
+}
+
+const FInventorySlot* FInventoryContentSnapshot::GetSlot(int32 Index) const
+{
+    if (Index < 0 || Index >= Capacity)
+        return nullptr;
+
+    const FInventorySlotBlock& Block = *Blocks[Index / FInventorySlotBlock::NumSlotsPerBlock];
+    return &Block.Slots[Index % FInventorySlotBlock::NumSlotsPerBlock];
+}
+
+int32 FInventoryContentSnapshot::GetItemQuantity(const FName& Item) const
+{
+    const int32* Quantity = ItemQuantities.Find(Item);
+    return Quantity ? *Quantity : 0;
+}
+
+bool FInventoryContentSnapshot::ContainsItem(const FName& Item) const
+{
+    return GetItemQuantity(Item) > 0;
+}
+
+int32 FInventoryContentSnapshot::GetEmptySlotCount() const
+{
+    return NumEmptySlots;
+}
+
+int32 FInventoryContentSnapshot::GetFirstEmptySlotIndex() const
+{
+    for (int32 BlockIndex = 0; BlockIndex < Blocks.Num(); BlockIndex++)
+    {
+        const FInventorySlotBlock& Block = *Blocks[BlockIndex];
+        if (Block.NumEmptySlots == 0)
+            continue;
+
+        for (int32 SlotIndex = 0; SlotIndex < Block.Slots.Num(); SlotIndex++)
+        {
+            if (Block.Slots[SlotIndex].IsEmpty())
+                return BlockIndex * FInventorySlotBlock::NumSlotsPerBlock + SlotIndex;
+        }
+    }
+    return INDEX_NONE;
+}
+
+uint32 FInventoryContentSnapshot::GetContentRevision() const
+{
+    return ContentRevision;
+}
+
+void FInventoryContentSnapshot::AddRef() const
+{
+    NumRefs.fetch_add(1, std::memory_order_relaxed);
+}
+
+uint32 FInventoryContentSnapshot::Release() const
+{
+    const uint32 NewNumRefs = NumRefs.fetch_sub(1, std::memory_order_acq_rel) - 1;
+    if (NewNumRefs == 0)
+        delete this;
+    return NewNumRefs;
+}
+
+
+/** Channel */
+
+FInventoryContentSnapshotChannel::~FInventoryContentSnapshotChannel()
+{
+    /** Readers hold the channel by shared reference, none can be acquiring anymore */
+    if (const FInventoryContentSnapshot* Snapshot = Current.exchange(nullptr))
+        Snapshot->Release();
+    for (const FInventoryContentSnapshot* Snapshot : RetiredSnapshots)
+        Snapshot->Release();
+}
+
+FInventoryContentSnapshotRef FInventoryContentSnapshotChannel::Acquire() const
+{
+    NumAcquiringReaders.fetch_add(1);
+    FInventoryContentSnapshotRef Snapshot(Current.load());
+    NumAcquiringReaders.fetch_sub(1);
+    return Snapshot;
+}
+
+void FInventoryContentSnapshotChannel::Publish(const FInventoryContent& Content, const TSet<int32>& DirtySlots, uint32 ContentRevision)
+{
+    SLOTINVENTORY_SCOPE_CYCLE_COUNTER(PublishSnapshot);
+    check(IsInGameThread());
+
+    const FInventoryContentSnapshot* Previous = Current.load();
+    if (Previous == nullptr)
+    {
+        PublishFull(Content, ContentRevision);
+        return;
+    }
+
+    const int32 Capacity = Content.GetCapacity();
+    const int32 NumBlocks = FMath::DivideAndRoundUp(Capacity, FInventorySlotBlock::NumSlotsPerBlock);
+
+    TBitArray<> RebuiltBlocks(false, NumBlocks);
+    for (int32 SlotIndex : DirtySlots)
+    {
+        if (SlotIndex >= 0 && SlotIndex < Capacity)
+            RebuiltBlocks[SlotIndex / FInventorySlotBlock::NumSlotsPerBlock] = true;
+    }
+
+    /** The last block of the previous capacity may have grown or shrunk */
+    if (Previous->Capacity != Capacity)
+    {
+        const int32 FirstResizedBlock = FMath::Min(Previous->Capacity, Capacity) / FInventorySlotBlock::NumSlotsPerBlock;
+        for (int32 BlockIndex = FirstResizedBlock; BlockIndex < NumBlocks; BlockIndex++)
+            RebuiltBlocks[BlockIndex] = true;
+    }
+
+    /** The totals start from the previous ones, only the replaced and removed blocks are applied */
+    FInventoryContentSnapshot* Snapshot = new FInventoryContentSnapshot();
+    Snapshot->Capacity = Capacity;
+    Snapshot->ContentRevision = ContentRevision;
+    Snapshot->NumEmptySlots = Previous->NumEmptySlots;
+    Snapshot->ItemQuantities = Previous->ItemQuantities;
+    Snapshot->Blocks.Reserve(NumBlocks);
+    for (int32 BlockIndex = 0; BlockIndex < NumBlocks; BlockIndex++)
+    {
+        const bool bHasPreviousBlock = BlockIndex < Previous->Blocks.Num();
+        if (!RebuiltBlocks[BlockIndex] && bHasPreviousBlock)
+        {
+            Snapshot->Blocks.Add(Previous->Blocks[BlockIndex]);
+            continue;
+        }
+
+        if (bHasPreviousBlock)
+            RemoveBlockTotals(*Snapshot, *Previous->Blocks[BlockIndex]);
+        AddBlockTotals(*Snapshot, *Snapshot->Blocks.Add_GetRef(BuildBlock(Content, BlockIndex)));
+    }
+    for (int32 BlockIndex = NumBlocks; BlockIndex < Previous->Blocks.Num(); BlockIndex++)
+        RemoveBlockTotals(*Snapshot, *Previous->Blocks[BlockIndex]);
+
+    Swap(Snapshot);
+}
+
+void FInventoryContentSnapshotChannel::PublishFull(const FInventoryContent& Content, uint32 ContentRevision)
+{
+    SLOTINVENTORY_SCOPE_CYCLE_COUNTER(PublishSnapshot);
+    check(IsInGameThread());
+
+    const int32 Capacity = Content.GetCapacity();
+    const int32 NumBlocks = FMath::DivideAndRoundUp(Capacity, FInventorySlotBlock::NumSlotsPerBlock);
+
+    FInventoryContentSnapshot* Snapshot = new FInventoryContentSnapshot();
+    Snapshot->Capacity = Capacity;
+    Snapshot->ContentRevision = ContentRevision;
+    Snapshot->Blocks.Reserve(NumBlocks);
+    for (int32 BlockIndex = 0; BlockIndex < NumBlocks; BlockIndex++)
+        AddBlockTotals(*Snapshot, *Snapshot->Blocks.Add_GetRef(BuildBlock(Content, BlockIndex)));
+
+    Swap(Snapshot);
+}
+
+void FInventoryContentSnapshotChannel::AddBlockTotals(FInventoryContentSnapshot& Snapshot, const FInventorySlotBlock& Block)
+{
+    Snapshot.NumEmptySlots += Block.NumEmptySlots;
+    for (const auto& [Item, Quantity] : Block.ItemQuantities)
+        Snapshot.ItemQuantities.FindOrAdd(Item) += Quantity;
+}
+
+void FInventoryContentSnapshotChannel::RemoveBlockTotals(FInventoryContentSnapshot& Snapshot, const FInventorySlotBlock& Block)
+{
+    Snapshot.NumEmptySlots -= Block.NumEmptySlots;
+    for (const auto& [Item, Quantity] : Block.ItemQuantities)
+    {
+        int32& Total = Snapshot.ItemQuantities.FindChecked(Item);
+        Total -= Quantity;
+        if (Total == 0)
+            Snapshot.ItemQuantities.Remove(Item);
+    }
+}
+
+FInventoryContentSnapshot::FBlockRef FInventoryContentSnapshotChannel::BuildBlock(const FInventoryContent& Content, int32 BlockIndex)
+{
+    TSharedRef<FInventorySlotBlock, ESPMode::ThreadSafe> Block = MakeShared<FInventorySlotBlock, ESPMode::ThreadSafe>();
+
+    const int32 FirstSlot = BlockIndex * FInventorySlotBlock::NumSlotsPerBlock;
+    const int32 NumSlots = FMath::Min(FInventorySlotBlock::NumSlotsPerBlock, Content.GetCapacity() - FirstSlot);
+    Block->Slots.Reserve(NumSlots);
+    for (int32 SlotIndex = FirstSlot; SlotIndex < FirstSlot + NumSlots; SlotIndex++)
+        Block->Slots.Add(*Content.GetSlotConstPtrAtIndex(SlotIndex));
+
+    for (const FInventorySlot& Slot : Block->Slots)
+    {
+        if (Slot.IsEmpty())
+            Block->NumEmptySlots++;
+        else if (Slot.Quantity != 0)
+            Block->ItemQuantities.FindOrAdd(Slot.Item) += Slot.Quantity;
+    }
+
+    return Block;
+}
+
+void FInventoryContentSnapshotChannel::Swap(const FInventoryContentSnapshot* NewSnapshot)
+{
+    NewSnapshot->AddRef();
+    if (const FInventoryContentSnapshot* Previous = Current.exchange(NewSnapshot))
+        RetiredSnapshots.Add(Previous);
+
+    ReleaseRetiredSnapshots();
+}
+
+void FInventoryContentSnapshotChannel::ReleaseRetiredSnapshots()
+{
+    /**
+     * A reader increments NumAcquiringReaders before loading Current and decrements it after taking its reference.
+     * Once the count is observed at zero after the swap, every reader that could have loaded a retired snapshot owns a reference to it.
+     */
+    if (RetiredSnapshots.IsEmpty() || NumAcquiringReaders.load() != 0)
+        return;
+
+    for (const FInventoryContentSnapshot* Snapshot : RetiredSnapshots)
+        Snapshot->Release();
+    RetiredSnapshots.Reset();
+}
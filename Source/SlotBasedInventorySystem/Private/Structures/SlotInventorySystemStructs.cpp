@@ -2,8 +2,11 @@
 
 
 #include "Structures/SlotInventorySystemStructs.h"
+#include "Structures/SlotInventoryTransactionKernels.h"
 #include "Math/UnrealMathUtility.h"
 #include "Templates/UnrealTemplate.h"
+#include "SlotInventoryStats.h"
+#include "Debug/SlotInventoryMemory.h"
 
 
 bool FInventorySlot::IsEmpty() const
@@ -25,74 +28,18 @@ void FInventorySlot::Reset()
 
 bool FInventorySlot::ReceiveStack(const FName& InItem, int32& InoutQuantity, const FInventorySlotTransactionRule& Rule, int32 MaxStackSize)
 {
-    if (Rule.bOnlyMerge && (Item != InItem || IsEmpty()))
-        return false;
-
-    if (Item != InItem)
+    return SlotInventoryKernels::DispatchSlotRule(Rule, [&](const auto& Policy)
     {
-        if (IsEmpty())
-        {
-            Reset();
-            Item = InItem;
-        }
-        else
-            return false;
-    }
-
-    if (HasModifiers())
-        return false;
-
-    const int32 TransferQuantityGoal = Rule.MaxTransferQuantity > 0 ? FMath::Min(Rule.MaxTransferQuantity, InoutQuantity) : InoutQuantity;
-    const int32 NewQuantity = Quantity + TransferQuantityGoal;
-    int32 TransferQuantity;
-
-    if (NewQuantity < 0)
-        TransferQuantity = -Quantity;
-    else if (NewQuantity > MaxStackSize)
-        TransferQuantity = MaxStackSize - Quantity;
-    else
-        TransferQuantity = TransferQuantityGoal;
-
-    if (Rule.bAtomic && TransferQuantity != TransferQuantityGoal)
-        return false;
-
-    if (TransferQuantity == 0)
-        return false;
-
-    InoutQuantity -= TransferQuantity;
-    Quantity += TransferQuantity;
-    check(Quantity >= 0);
-
-    if (Quantity == 0)
-        Reset();
-
-    return true;
+        return SlotInventoryKernels::ReceiveStack(*this, InItem, InoutQuantity, Policy, MaxStackSize);
+    });
 }
 
 bool FInventorySlot::ReceiveSlot(FInventorySlot& SourceSlot, const FInventorySlotTransactionRule& Rule, int32 MaxStackSize)
 {
-    if (this == &SourceSlot)
-        return false;
-
-    if (!SourceSlot.HasModifiers())
-    {
-        if (ReceiveStack(SourceSlot.Item, SourceSlot.Quantity, Rule, MaxStackSize))
-        {
-            if (SourceSlot.Quantity == 0)
-                SourceSlot.Reset();
-            return true;
-        }
-    }
-
-    if (Rule.bAllowSwap
-        && SourceSlot.Quantity < MaxStackSize
-        && !SourceSlot.IsEmpty())
+    return SlotInventoryKernels::DispatchSlotRule(Rule, [&](const auto& Policy)
     {
-        Swap(*this, SourceSlot);
-        return true;
-    }
-
-    return false;
+        return SlotInventoryKernels::ReceiveSlot(*this, SourceSlot, Policy, MaxStackSize);
+    });
 }
 
 const FItemModifier* FInventorySlot::GetConstModifierByType(const FName& ModifierType) const
@@ -137,9 +84,149 @@ void FInventorySlot::GetModifiersByType(const FName& ModifierType, TArray<FItemM
 /** Inventory Content */
 
 
+void FInventoryContent::FContentModifications::RecordPreviousValue(int32 Index, const FName& Item, int32 Quantity)
+{
+    if (PreviousValues == nullptr)
+        return;
+
+    /** Only slots without modifiers are modified through stacks, item and quantity are the whole value */
+    FInventorySlot PreviousValue;
+    PreviousValue.Item = Item;
+    PreviousValue.Quantity = Quantity;
+    PreviousValues->Emplace(Index, MoveTemp(PreviousValue));
+}
+
+void FInventoryContent::RestorePreviousValues(FPreviousValues& PreviousValues)
+{
+    for (int32 ValueIndex = PreviousValues.Num() - 1; ValueIndex >= 0; ValueIndex--)
+    {
+        if (FInventorySlot* Slot = GetSlotPtrAtIndex(PreviousValues[ValueIndex].Key))
+            *Slot = MoveTemp(PreviousValues[ValueIndex].Value);
+    }
+    PreviousValues.Reset();
+}
+
+template<typename FunctionType>
+int32 FInventoryContent::VisitSlots(bool bAllocatePages, FunctionType&& Function)
+{
+    int32 NumVisited = 0;
+
+    if (!bSparse)
+    {
+        for (int32 SlotIndex = 0; SlotIndex < Slots.Num(); SlotIndex++)
+        {
+            ++NumVisited;
+            if (!Function(SlotIndex, Slots[SlotIndex]))
+                break;
+        }
+        return NumVisited;
+    }
+
+    for (int32 PageIndex = 0; PageIndex < SlotPages.Num(); PageIndex++)
+    {
+        TArray<FInventorySlot>* PageSlots = &SlotPages[PageIndex].Slots;
+        if (PageSlots->IsEmpty())
+        {
+            if (!bAllocatePages)
+                continue;
+            PageSlots = &AllocatePage(PageIndex);
+        }
+
+        for (int32 PageSlotIndex = 0; PageSlotIndex < PageSlots->Num(); PageSlotIndex++)
+        {
+            ++NumVisited;
+            if (!Function(PageIndex * FInventorySlotPage::NumSlotsPerPage + PageSlotIndex, (*PageSlots)[PageSlotIndex]))
+                return NumVisited;
+        }
+    }
+    return NumVisited;
+}
+
+TArray<FInventorySlot>& FInventoryContent::AllocatePage(int32 PageIndex)
+{
+    TArray<FInventorySlot>& PageSlots = SlotPages[PageIndex].Slots;
+    if (PageSlots.IsEmpty())
+        PageSlots.SetNum(GetPageSize(PageIndex));
+    return PageSlots;
+}
+
+int32 FInventoryContent::GetPageSize(int32 PageIndex) const
+{
+    return FMath::Min(FInventorySlotPage::NumSlotsPerPage, SparseCapacity - PageIndex * FInventorySlotPage::NumSlotsPerPage);
+}
+
+int32 FInventoryContent::GetCapacity() const
+{
+    return bSparse ? SparseCapacity : Slots.Num();
+}
+
+void FInventoryContent::SetCapacity(int32 NewCapacity)
+{
+    NewCapacity = FMath::Max(NewCapacity, 0);
+
+    /** The allocation is kept when shrinking, growth is amortized by the array slack */
+    if (!bSparse)
+    {
+        Slots.SetNum(NewCapacity, false);
+        return;
+    }
+
+    const int32 PreviousNumPages = SlotPages.Num();
+    const int32 NumPages = FMath::DivideAndRoundUp(NewCapacity, FInventorySlotPage::NumSlotsPerPage);
+
+    SparseCapacity = NewCapacity;
+    SlotPages.SetNum(NumPages, true);
+
+    /** Only the allocated page that was or becomes the last one changes size */
+    for (int32 PageIndex = FMath::Max(FMath::Min(PreviousNumPages, NumPages) - 1, 0); PageIndex < NumPages; PageIndex++)
+    {
+        TArray<FInventorySlot>& PageSlots = SlotPages[PageIndex].Slots;
+        if (!PageSlots.IsEmpty())
+            PageSlots.SetNum(GetPageSize(PageIndex));
+    }
+}
+
+void FInventoryContent::SetSparse(bool bNewSparse)
+{
+    if (bNewSparse == bSparse)
+        return;
+
+    if (bNewSparse)
+    {
+        const int32 Capacity = Slots.Num();
+        bSparse = true;
+        SparseCapacity = Capacity;
+        SlotPages.SetNum(FMath::DivideAndRoundUp(Capacity, FInventorySlotPage::NumSlotsPerPage));
+
+        for (int32 PageIndex = 0; PageIndex < SlotPages.Num(); PageIndex++)
+        {
+            const int32 FirstSlot = PageIndex * FInventorySlotPage::NumSlotsPerPage;
+            const int32 PageSize = GetPageSize(PageIndex);
+            for (int32 SlotIndex = FirstSlot; SlotIndex < FirstSlot + PageSize; SlotIndex++)
+            {
+                if (!Slots[SlotIndex].IsEmpty())
+                {
+                    SlotPages[PageIndex].Slots = TArray<FInventorySlot>(Slots.GetData() + FirstSlot, PageSize);
+                    break;
+                }
+            }
+        }
+        Slots.Empty();
+    }
+    else
+    {
+        TArray<FInventorySlot> DenseSlots;
+        CopySlots(DenseSlots);
+        bSparse = false;
+        SparseCapacity = 0;
+        SlotPages.Empty();
+        Slots = MoveTemp(DenseSlots);
+    }
+}
+
 bool FInventoryContent::IsValidIndex(int32 Index) const
 {
-	return Index >= 0 && Index < Slots.Num();
+	return Index >= 0 && Index < GetCapacity();
 }
 
 FInventorySlot* FInventoryContent::GetSlotPtrAtIndex(int32 Index)
@@ -147,6 +234,9 @@ FInventorySlot* FInventoryContent::GetSlotPtrAtIndex(int32 Index)
 	if (!IsValidIndex(Index))
 		return nullptr;
 
+	if (bSparse)
+		return &AllocatePage(Index / FInventorySlotPage::NumSlotsPerPage)[Index % FInventorySlotPage::NumSlotsPerPage];
+
 	return &(Slots[Index]);
 }
 
@@ -155,16 +245,197 @@ const FInventorySlot* FInventoryContent::GetSlotConstPtrAtIndex(int32 Index) con
 	if (!IsValidIndex(Index))
 		return nullptr;
 
+	if (bSparse)
+	{
+		static const FInventorySlot EmptySlot;
+		const TArray<FInventorySlot>& PageSlots = SlotPages[Index / FInventorySlotPage::NumSlotsPerPage].Slots;
+		return PageSlots.IsEmpty() ? &EmptySlot : &PageSlots[Index % FInventorySlotPage::NumSlotsPerPage];
+	}
+
 	return &(Slots[Index]);
 }
 
-bool FInventoryContent::ReceiveStacks(FItemStacks& Stacks, const FInventoryContentTransactionRule& Rule, const TMap<FName, int32>& MaxStackSizes, FContentModifications& OutModifications)
+int32 FInventoryContent::GetStoredSlotCount() const
+{
+    if (!bSparse)
+        return Slots.Num();
+
+    int32 NumStored = 0;
+    for (const FInventorySlotPage& Page : SlotPages)
+        NumStored += Page.Slots.Num();
+    return NumStored;
+}
+
+void FInventoryContent::CopySlots(TArray<FInventorySlot>& OutSlots) const
+{
+    if (!bSparse)
+    {
+        OutSlots = Slots;
+        return;
+    }
+
+    OutSlots.Reset(SparseCapacity);
+    for (int32 PageIndex = 0; PageIndex < SlotPages.Num(); PageIndex++)
+    {
+        const TArray<FInventorySlot>& PageSlots = SlotPages[PageIndex].Slots;
+        if (PageSlots.IsEmpty())
+            OutSlots.AddDefaulted(GetPageSize(PageIndex));
+        else
+            OutSlots.Append(PageSlots);
+    }
+}
+
+void FInventoryContent::SetSlots(const TArray<FInventorySlot>& NewSlots)
+{
+    if (!bSparse)
+    {
+        Slots = NewSlots;
+        return;
+    }
+
+    SetCapacity(NewSlots.Num());
+    for (int32 SlotIndex = 0; SlotIndex < NewSlots.Num(); SlotIndex++)
+    {
+        /** Pages of slots that stay empty are not allocated */
+        if (NewSlots[SlotIndex].IsEmpty() && GetSlotConstPtrAtIndex(SlotIndex)->IsEmpty())
+            continue;
+        *GetSlotPtrAtIndex(SlotIndex) = NewSlots[SlotIndex];
+    }
+}
+
+void FInventoryContent::ReleaseEmptyPages(const TSet<int32>& SlotIndices)
+{
+    if (!bSparse)
+        return;
+
+    for (int32 SlotIndex : SlotIndices)
+    {
+        if (!IsValidIndex(SlotIndex))
+            continue;
+
+        TArray<FInventorySlot>& PageSlots = SlotPages[SlotIndex / FInventorySlotPage::NumSlotsPerPage].Slots;
+        if (!PageSlots.IsEmpty() && !PageSlots.ContainsByPredicate([](const FInventorySlot& Slot) { return !Slot.IsEmpty(); }))
+            PageSlots.Empty();
+    }
+}
+
+void FInventoryContent::AccumulateMemoryUsage(FSlotInventoryMemoryUsage& Usage) const
+{
+    if (bSparse)
+    {
+        Usage.Slots += SlotPages.GetAllocatedSize();
+        Usage.Slack += (SlotPages.Max() - SlotPages.Num()) * sizeof(FInventorySlotPage);
+        for (const FInventorySlotPage& Page : SlotPages)
+        {
+            Usage.Slots += Page.Slots.GetAllocatedSize();
+            Usage.Slack += (Page.Slots.Max() - Page.Slots.Num()) * sizeof(FInventorySlot);
+        }
+    }
+    else
+    {
+        Usage.Slots += Slots.GetAllocatedSize();
+        Usage.Slack += (Slots.Max() - Slots.Num()) * sizeof(FInventorySlot);
+    }
+
+    ForEachStoredSlot([&Usage](int32 SlotIndex, const FInventorySlot& Slot)
+    {
+        Usage.Modifiers += Slot.Modifiers.GetAllocatedSize();
+        Usage.Slack += (Slot.Modifiers.Max() - Slot.Modifiers.Num()) * sizeof(FItemModifier);
+        for (const FItemModifier& Modifier : Slot.Modifiers)
+        {
+            if (const UScriptStruct* ScriptStruct = Modifier.Data.GetScriptStruct())
+                Usage.ModifierPayloads += ScriptStruct->GetStructureSize();
+        }
+    });
+}
+
+void FInventoryContent::Compact()
+{
+    if (bSparse)
+    {
+        for (FInventorySlotPage& Page : SlotPages)
+        {
+            if (!Page.Slots.ContainsByPredicate([](const FInventorySlot& Slot) { return !Slot.IsEmpty(); }))
+                Page.Slots.Empty();
+        }
+        SlotPages.Shrink();
+    }
+    else
+    {
+        Slots.Shrink();
+    }
+
+    /** Reset keeps the modifier arrays to reuse them, release them here */
+    ForEachStoredSlot([](int32 SlotIndex, FInventorySlot& Slot)
+    {
+        if (Slot.Modifiers.IsEmpty())
+            Slot.Modifiers.Empty();
+        else
+            Slot.Modifiers.Shrink();
+    });
+}
+
+template<typename PolicyType>
+bool FInventoryContent::ReceiveStackWithPolicy(const FName& Item, int32& InoutQuantity, const PolicyType& Policy, int32 MaxStackSize, FContentModifications& OutModifications)
 {
+    bool bModified = false;
+
+    /** Empty slots only receive added items */
+    const bool bAllocatePages = InoutQuantity > 0 && !Policy.bOnlyMerge;
+
+    const int32 ScannedSlots = VisitSlots(bAllocatePages, [&](int32 i, FInventorySlot& Slot)
+    {
+        if (InoutQuantity == 0)
+            return false;
+
+        const FName PreviousItem = Slot.Item;
+        const int32 PreviousQuantity = Slot.Quantity;
+        if (SlotInventoryKernels::ReceiveStack(Slot, Item, InoutQuantity, Policy, MaxStackSize))
+        {
+            OutModifications.RecordPreviousValue(i, PreviousItem, PreviousQuantity);
+            bModified = true;
+            if (Slot.IsEmpty())
+                OutModifications.bCreatedEmptySlot = true;
+            OutModifications.ModifiedSlots.Add(i);
+        }
+        return true;
+    });
+    INC_DWORD_STAT_BY(STAT_SlotInventory_SlotsScanned, ScannedSlots);
+    return bModified;
+}
+
+template<typename PolicyType>
+bool FInventoryContent::ReceiveSlotWithPolicy(FInventorySlot& InoutSlot, const PolicyType& Policy, bool bAllocatePages, int32 MaxStackSize, FContentModifications& OutModifications, int32& InoutScannedSlots)
+{
+    bool bModified = false;
+
+    InoutScannedSlots += VisitSlots(bAllocatePages, [&](int32 i, FInventorySlot& Slot)
+    {
+        if (InoutSlot.IsEmpty())
+            return false;
+
+        const FName PreviousItem = Slot.Item;
+        const int32 PreviousQuantity = Slot.Quantity;
+        if (SlotInventoryKernels::ReceiveSlot(Slot, InoutSlot, Policy, MaxStackSize))
+        {
+            OutModifications.RecordPreviousValue(i, PreviousItem, PreviousQuantity);
+            bModified = true;
+            OutModifications.ModifiedSlots.Add(i);
+        }
+        return true;
+    });
+    return bModified;
+}
+
+bool FInventoryContent::ReceiveStacks(FItemStacks& Stacks, const FInventoryContentTransactionRule& Rule, const FMaxStackSizes& MaxStackSizes, FContentModifications& OutModifications)
+{
+    SLOTINVENTORY_SCOPE_CYCLE_COUNTER(ReceiveStacks);
+
     bool bModified = false;
     bool bHasItemsLeft = false;
     bool bHasNewEmptySlots = false;
 
-    TSet<FName> EmptyStacks;
+    TArray<FName, TInlineAllocator<8>> EmptyStacks;
 
     for (auto& [Item, Quantity] : Stacks)
     {
@@ -172,15 +443,9 @@ bool FInventoryContent::ReceiveStacks(FItemStacks& Stacks, const FInventoryConte
 
         OutModifications.bCreatedEmptySlot = false;
 
-        FInventorySlotTransactionRule ReceivingRule;
-        ReceivingRule.bAllowSwap = false;
         if (Rule.bPreferMerge)
-        {
-            ReceivingRule.bOnlyMerge = true;
-            bModified |= ReceiveStack(Item, Quantity, ReceivingRule, MaxStackSize, OutModifications);
-        }
-        ReceivingRule.bOnlyMerge = false;
-        bModified |= ReceiveStack(Item, Quantity, ReceivingRule, MaxStackSize, OutModifications);
+            bModified |= ReceiveStackWithPolicy(Item, Quantity, SlotInventoryKernels::FMergePolicy(), MaxStackSize, OutModifications);
+        bModified |= ReceiveStackWithPolicy(Item, Quantity, SlotInventoryKernels::FFillPolicy(), MaxStackSize, OutModifications);
 
         bHasNewEmptySlots = OutModifications.bCreatedEmptySlot;
 
@@ -201,90 +466,170 @@ bool FInventoryContent::ReceiveStacks(FItemStacks& Stacks, const FInventoryConte
 
 bool FInventoryContent::ReceiveStack(const FName& Item, int32& InoutQuantity, const FInventorySlotTransactionRule& Rule, int32 MaxStackSize, FContentModifications& OutModifications)
 {
-    bool bModified = false;
-
-    for (int32 i = 0; i < Slots.Num() && InoutQuantity != 0; i++)
+    return SlotInventoryKernels::DispatchSlotRule(Rule, [&](const auto& Policy)
     {
-        FInventorySlot& Slot(Slots[i]);
-
-        if (Slot.ReceiveStack(Item, InoutQuantity, Rule, MaxStackSize))
-        {
-            bModified = true;
-            if (Slot.IsEmpty())
-                OutModifications.bCreatedEmptySlot = true;
-            OutModifications.ModifiedSlots.Add(i);
-        }
-    }
-    return bModified;
+        return ReceiveStackWithPolicy(Item, InoutQuantity, Policy, MaxStackSize, OutModifications);
+    });
 }
 
 bool FInventoryContent::ReceiveSlotAtIndex(FInventorySlot& InoutSlot, int32 Index, const FInventorySlotTransactionRule& Rule, int32 MaxStackSize)
 {
-    if (FInventorySlot* LocalSlot = GetSlotPtrAtIndex(Index))
-        return LocalSlot->ReceiveSlot(InoutSlot, Rule, MaxStackSize);
-    return false;
+    const FInventorySlot* LocalConstSlot = GetSlotConstPtrAtIndex(Index);
+    if (LocalConstSlot == nullptr)
+        return false;
+
+    /** An empty slot is only written, and its sparse page allocated, if it receives something */
+    if (LocalConstSlot->IsEmpty())
+    {
+        FInventorySlot ReceivedSlot;
+        if (!ReceivedSlot.ReceiveSlot(InoutSlot, Rule, MaxStackSize))
+            return false;
+        if (!ReceivedSlot.IsEmpty())
+            *GetSlotPtrAtIndex(Index) = MoveTemp(ReceivedSlot);
+        return true;
+    }
+
+    return GetSlotPtrAtIndex(Index)->ReceiveSlot(InoutSlot, Rule, MaxStackSize);
 }
 
 bool FInventoryContent::ReceiveSlot(FInventorySlot& InoutSlot, const FInventoryContentTransactionRule& Rule, int32 MaxStackSize, FContentModifications& OutModifications)
 {
     bool bModified = false;
+    int32 ScannedSlots = 0;
 
-    FInventorySlotTransactionRule SlotRule;
-    SlotRule.bAllowSwap = false;
     if (Rule.bPreferMerge)
     {
-        SlotRule.bOnlyMerge = true;
-        for (int32 i = 0; i < Slots.Num() && !InoutSlot.IsEmpty(); i++)
-        {
-            if (Slots[i].ReceiveSlot(InoutSlot, SlotRule, MaxStackSize))
-            {
-                bModified = true;
-                OutModifications.ModifiedSlots.Add(i);
-            }
-        }
+        bModified |= ReceiveSlotWithPolicy(InoutSlot, SlotInventoryKernels::FMergePolicy(), false, MaxStackSize, OutModifications, ScannedSlots);
         if (InoutSlot.IsEmpty())
+        {
+            INC_DWORD_STAT_BY(STAT_SlotInventory_SlotsScanned, ScannedSlots);
             return bModified;
+        }
     }
-    SlotRule.bOnlyMerge = false;
-    for (int32 i = 0; i < Slots.Num() && !InoutSlot.IsEmpty(); i++)
+
+    /** Without swapping, only a stack without modifiers can land in an empty slot */
+    const bool bAllocatePages = !InoutSlot.HasModifiers() && InoutSlot.Quantity > 0;
+    bModified |= ReceiveSlotWithPolicy(InoutSlot, SlotInventoryKernels::FFillPolicy(), bAllocatePages, MaxStackSize, OutModifications, ScannedSlots);
+    INC_DWORD_STAT_BY(STAT_SlotInventory_SlotsScanned, ScannedSlots);
+    return bModified;
+}
+
+bool FInventoryContent::ReceiveSlotAmount(FInventorySlot& InoutSlot, int32 MaxAmount, const FInventoryContentTransactionRule& Rule, int32 MaxStackSize, FContentModifications& OutModifications)
+{
+    if (MaxAmount <= 0 || InoutSlot.Quantity <= MaxAmount)
+        return ReceiveSlot(InoutSlot, Rule, MaxStackSize, OutModifications);
+
+    /** Split off the part that can move, modifiers are copied with it */
+    FInventorySlot Part = InoutSlot;
+    Part.Quantity = MaxAmount;
+    const bool bModified = ReceiveSlot(Part, Rule, MaxStackSize, OutModifications);
+    InoutSlot.Quantity -= MaxAmount - (Part.IsEmpty() ? 0 : Part.Quantity);
+    return bModified;
+}
+
+bool FInventoryContent::RegroupSimilarItemsAtIndex(int32 Index, FContentModifications& OutModifications, int32 MaxStackSize)
+{
+    bool bModified = false;
+
+    const FInventorySlot* TargetConstSlot = GetSlotConstPtrAtIndex(Index);
+    if (TargetConstSlot == nullptr || TargetConstSlot->IsEmpty() || TargetConstSlot->HasModifiers())
+        return false;
+
+    FInventorySlot* TargetSlot = GetSlotPtrAtIndex(Index);
+
+    const FName TargetItem = TargetSlot->Item;
+    const int32 TargetQuantity = TargetSlot->Quantity;
+    const int32 ScannedSlots = VisitSlots(false, [&](int32 SlotIndex, FInventorySlot& Slot)
     {
-        if (Slots[i].ReceiveSlot(InoutSlot, SlotRule, MaxStackSize))
+        if (TargetSlot->Quantity >= MaxStackSize)
+            return false;
+        if (SlotIndex == Index)
+            return true;
+
+        const FName PreviousItem = Slot.Item;
+        const int32 PreviousQuantity = Slot.Quantity;
+        if (SlotInventoryKernels::ReceiveSlot(*TargetSlot, Slot, SlotInventoryKernels::FMergePolicy(), MaxStackSize))
         {
+            OutModifications.RecordPreviousValue(SlotIndex, PreviousItem, PreviousQuantity);
             bModified = true;
-            OutModifications.ModifiedSlots.Add(i);
+            OutModifications.ModifiedSlots.Add(SlotIndex);
+            if (Slot.IsEmpty())
+                OutModifications.bCreatedEmptySlot = true;
         }
+        return true;
+    });
+    INC_DWORD_STAT_BY(STAT_SlotInventory_SlotsScanned, ScannedSlots);
+    if (bModified)
+    {
+        OutModifications.RecordPreviousValue(Index, TargetItem, TargetQuantity);
+        OutModifications.ModifiedSlots.Add(Index);
     }
     return bModified;
 }
 
-bool FInventoryContent::RegroupSimilarItemsAtIndex(int32 Index, FContentModifications& OutModifications, int32 MaxStackSize)
+bool FInventoryContent::MergeFollowingStacksAtIndex(int32 Index, FContentModifications& OutModifications, int32 MaxStackSize)
 {
-    bool bModified = false;
+    const FInventorySlot* TargetConstSlot = GetSlotConstPtrAtIndex(Index);
+    if (TargetConstSlot == nullptr || TargetConstSlot->IsEmpty() || TargetConstSlot->HasModifiers() || TargetConstSlot->Quantity >= MaxStackSize)
+        return false;
 
+    /** Pages of sparse slots are never moved, the pointer stays valid */
     FInventorySlot* TargetSlot = GetSlotPtrAtIndex(Index);
 
-    if (TargetSlot == nullptr || TargetSlot->IsEmpty() || TargetSlot->HasModifiers())
-        return false;
+    const FName TargetItem = TargetSlot->Item;
+    const int32 TargetQuantity = TargetSlot->Quantity;
+    const int32 Capacity = GetCapacity();
 
-    FInventorySlotTransactionRule GroupingRule;
-    GroupingRule.bAllowSwap = false;
-    GroupingRule.bOnlyMerge = true;
-    for (int32 SlotIndex = 0; SlotIndex < Slots.Num() && TargetSlot->Quantity < MaxStackSize; SlotIndex++)
+    bool bModified = false;
+    int32 SlotIndex = Index + 1;
+    for (; SlotIndex < Capacity && TargetSlot->Quantity < MaxStackSize; SlotIndex++)
     {
-        if (SlotIndex == Index)
+        const FInventorySlot* ConstSlot = GetSlotConstPtrAtIndex(SlotIndex);
+        if (ConstSlot->Item != TargetItem || ConstSlot->IsEmpty() || ConstSlot->HasModifiers())
             continue;
 
-        FInventorySlot& Slot = Slots[SlotIndex];
-
-        if (TargetSlot->ReceiveSlot(Slot, GroupingRule, MaxStackSize))
+        FInventorySlot* Slot = GetSlotPtrAtIndex(SlotIndex);
+        const int32 PreviousQuantity = Slot->Quantity;
+        if (SlotInventoryKernels::ReceiveSlot(*TargetSlot, *Slot, SlotInventoryKernels::FMergePolicy(), MaxStackSize))
         {
-            bModified = true;
+            OutModifications.RecordPreviousValue(SlotIndex, TargetItem, PreviousQuantity);
             OutModifications.ModifiedSlots.Add(SlotIndex);
-            if (Slot.IsEmpty())
+            bModified = true;
+            if (Slot->IsEmpty())
                 OutModifications.bCreatedEmptySlot = true;
         }
     }
+    INC_DWORD_STAT_BY(STAT_SlotInventory_SlotsScanned, SlotIndex - Index - 1);
+
     if (bModified)
+    {
+        OutModifications.RecordPreviousValue(Index, TargetItem, TargetQuantity);
         OutModifications.ModifiedSlots.Add(Index);
+    }
     return bModified;
 }
+
+bool FInventoryContent::MoveNextSlotToIndex(int32 Index, int32& InoutReadIndex, FContentModifications& OutModifications)
+{
+    const FInventorySlot* TargetConstSlot = GetSlotConstPtrAtIndex(Index);
+    if (TargetConstSlot == nullptr || !TargetConstSlot->IsEmpty())
+        return false;
+
+    const int32 Capacity = GetCapacity();
+    InoutReadIndex = FMath::Max(InoutReadIndex, Index + 1);
+    while (InoutReadIndex < Capacity && GetSlotConstPtrAtIndex(InoutReadIndex)->IsEmpty())
+        InoutReadIndex++;
+
+    if (InoutReadIndex >= Capacity)
+        return false;
+
+    FInventorySlot MovedSlot = MoveTemp(*GetSlotPtrAtIndex(InoutReadIndex));
+    GetSlotPtrAtIndex(InoutReadIndex)->Reset();
+    *GetSlotPtrAtIndex(Index) = MoveTemp(MovedSlot);
+
+    OutModifications.ModifiedSlots.Add(Index);
+    OutModifications.ModifiedSlots.Add(InoutReadIndex);
+    OutModifications.bCreatedEmptySlot = true;
+    InoutReadIndex++;
+    return true;
+}
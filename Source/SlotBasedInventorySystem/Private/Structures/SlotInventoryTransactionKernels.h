@@ -0,0 +1,144 @@
+// Amasson
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Structures/SlotInventorySystemStructs.h"
+
+/**
+ * Slot receive kernels specialized on the transaction rule flags.
+ * The runtime rule entry points dispatch once to the matching policy,
+ * content scan loops use constant policies directly so no flag is tested per slot.
+ */
+namespace SlotInventoryKernels
+{
+	/** Transaction rule flags known at compile time */
+	template<bool bInOnlyMerge, bool bInAtomic, bool bInAllowSwap, bool bInLimitTransfer>
+	struct TSlotTransactionPolicy
+	{
+		static constexpr bool bOnlyMerge = bInOnlyMerge;
+		static constexpr bool bAtomic = bInAtomic;
+		static constexpr bool bAllowSwap = bInAllowSwap;
+		static constexpr bool bLimitTransfer = bInLimitTransfer;
+
+		/** Only read when bLimitTransfer */
+		int32 MaxTransferQuantity = 0;
+	};
+
+	/** Rule flags tested at runtime, the behavior of the unspecialized code */
+	struct FRuntimeSlotTransactionPolicy
+	{
+		explicit FRuntimeSlotTransactionPolicy(const FInventorySlotTransactionRule& Rule)
+			: bOnlyMerge(Rule.bOnlyMerge)
+			, bAtomic(Rule.bAtomic)
+			, bAllowSwap(Rule.bAllowSwap)
+			, bLimitTransfer(Rule.MaxTransferQuantity > 0)
+			, MaxTransferQuantity(Rule.MaxTransferQuantity)
+		{}
+
+		bool bOnlyMerge;
+		bool bAtomic;
+		bool bAllowSwap;
+		bool bLimitTransfer;
+		int32 MaxTransferQuantity;
+	};
+
+	/** Add to stacks of the same item only */
+	using FMergePolicy = TSlotTransactionPolicy<true, false, false, false>;
+
+	/** Add to stacks of the same item or to empty slots */
+	using FFillPolicy = TSlotTransactionPolicy<false, false, false, false>;
+
+
+	/** FInventorySlot::ReceiveStack */
+	template<typename PolicyType>
+	FORCEINLINE bool ReceiveStack(FInventorySlot& Slot, const FName& InItem, int32& InoutQuantity, const PolicyType& Policy, int32 MaxStackSize)
+	{
+		const bool bWasEmpty = Slot.IsEmpty();
+		if (Slot.Item != InItem)
+		{
+			if (Policy.bOnlyMerge || !bWasEmpty)
+				return false;
+
+			Slot.Reset();
+			Slot.Item = InItem;
+		}
+		else if (Policy.bOnlyMerge && bWasEmpty)
+		{
+			return false;
+		}
+
+		if (Slot.HasModifiers())
+			return false;
+
+		const int32 TransferQuantityGoal = Policy.bLimitTransfer ? FMath::Min(Policy.MaxTransferQuantity, InoutQuantity) : InoutQuantity;
+		const int32 TransferQuantity = FMath::Clamp(Slot.Quantity + TransferQuantityGoal, 0, MaxStackSize) - Slot.Quantity;
+
+		if (Policy.bAtomic && TransferQuantity != TransferQuantityGoal)
+			return false;
+
+		if (TransferQuantity == 0)
+			return false;
+
+		InoutQuantity -= TransferQuantity;
+		Slot.Quantity += TransferQuantity;
+		check(Slot.Quantity >= 0);
+
+		if (Slot.Quantity == 0)
+			Slot.Reset();
+
+		return true;
+	}
+
+	/** FInventorySlot::ReceiveSlot */
+	template<typename PolicyType>
+	FORCEINLINE bool ReceiveSlot(FInventorySlot& Slot, FInventorySlot& SourceSlot, const PolicyType& Policy, int32 MaxStackSize)
+	{
+		if (&Slot == &SourceSlot)
+			return false;
+
+		if (!SourceSlot.HasModifiers() && ReceiveStack(Slot, SourceSlot.Item, SourceSlot.Quantity, Policy, MaxStackSize))
+		{
+			if (SourceSlot.Quantity == 0)
+				SourceSlot.Reset();
+			return true;
+		}
+
+		if (Policy.bAllowSwap
+			&& SourceSlot.Quantity < MaxStackSize
+			&& !SourceSlot.IsEmpty())
+		{
+			Swap(Slot, SourceSlot);
+			return true;
+		}
+
+		return false;
+	}
+
+
+	/** Dispatch */
+
+	template<bool... Flags, typename FunctionType>
+	FORCEINLINE decltype(auto) DispatchFlags(int32 MaxTransferQuantity, FunctionType&& Function)
+	{
+		TSlotTransactionPolicy<Flags...> Policy;
+		Policy.MaxTransferQuantity = MaxTransferQuantity;
+		return Function(Policy);
+	}
+
+	template<bool... Flags, typename FunctionType, typename... FlagTypes>
+	FORCEINLINE decltype(auto) DispatchFlags(int32 MaxTransferQuantity, FunctionType&& Function, bool bFlag, FlagTypes... RemainingFlags)
+	{
+		if (bFlag)
+			return DispatchFlags<Flags..., true>(MaxTransferQuantity, Forward<FunctionType>(Function), RemainingFlags...);
+		return DispatchFlags<Flags..., false>(MaxTransferQuantity, Forward<FunctionType>(Function), RemainingFlags...);
+	}
+
+	/** Call Function(Policy) with the TSlotTransactionPolicy matching the rule */
+	template<typename FunctionType>
+	FORCEINLINE decltype(auto) DispatchSlotRule(const FInventorySlotTransactionRule& Rule, FunctionType&& Function)
+	{
+		return DispatchFlags<>(Rule.MaxTransferQuantity, Forward<FunctionType>(Function),
+			Rule.bOnlyMerge, Rule.bAtomic, Rule.bAllowSwap, Rule.MaxTransferQuantity > 0);
+	}
+}
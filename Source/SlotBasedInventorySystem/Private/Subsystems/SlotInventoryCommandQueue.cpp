@@ -0,0 +1,134 @@
+// Amasson
+
+
+#include "Subsystems/SlotInventoryCommandQueue.h"
+#include "Components/SlotInventoryComponentBase.h"
+#include "SlotInventoryStats.h"
+
+
+void FSlotInventoryCommandQueue::EnqueueAddStacks(TWeakObjectPtr<USlotInventoryComponentBase> Inventory, TMap<FName, int32> Items, FSlotInventoryCommand::FOnCompleted OnCompleted)
+{
+    FSlotInventoryCommand Command;
+    Command.Type = FSlotInventoryCommand::EType::AddStacks;
+    Command.Inventory = Inventory;
+    Command.Items = MoveTemp(Items);
+    Command.OnCompleted = MoveTemp(OnCompleted);
+    Enqueue(MoveTemp(Command));
+}
+
+void FSlotInventoryCommandQueue::EnqueueRemoveStacks(TWeakObjectPtr<USlotInventoryComponentBase> Inventory, TMap<FName, int32> Items, FSlotInventoryCommand::FOnCompleted OnCompleted)
+{
+    FSlotInventoryCommand Command;
+    Command.Type = FSlotInventoryCommand::EType::RemoveStacks;
+    Command.Inventory = Inventory;
+    Command.Items = MoveTemp(Items);
+    Command.OnCompleted = MoveTemp(OnCompleted);
+    Enqueue(MoveTemp(Command));
+}
+
+void FSlotInventoryCommandQueue::EnqueueMoveSlot(TWeakObjectPtr<USlotInventoryComponentBase> Source, int32 SourceIndex, TWeakObjectPtr<USlotInventoryComponentBase> Destination, int32 DestinationIndex, int32 MaxAmount, FSlotInventoryCommand::FOnCompleted OnCompleted)
+{
+    FSlotInventoryCommand Command;
+    Command.Type = FSlotInventoryCommand::EType::MoveSlot;
+    Command.Inventory = Source;
+    Command.SourceIndex = SourceIndex;
+    Command.Destination = Destination;
+    Command.DestinationIndex = DestinationIndex;
+    Command.MaxAmount = MaxAmount;
+    Command.OnCompleted = MoveTemp(OnCompleted);
+    Enqueue(MoveTemp(Command));
+}
+
+void FSlotInventoryCommandQueue::Enqueue(FSlotInventoryCommand&& Command)
+{
+    /** The subsystem is gone, nothing would drain it */
+    if (bClosed)
+    {
+        Fail(Command);
+        return;
+    }
+
+    Commands.Enqueue(MoveTemp(Command));
+    NumQueued++;
+}
+
+int32 FSlotInventoryCommandQueue::Drain()
+{
+    SLOTINVENTORY_SCOPE_CYCLE_COUNTER(DrainCommands);
+    check(IsInGameThread());
+
+    /** Callbacks enqueuing new commands cannot keep the drain going */
+    const int32 NumToDrain = NumQueued;
+
+    int32 NumExecuted = 0;
+    TMap<FName, int32> Overflows;
+    FSlotInventoryCommand Command;
+    while (NumExecuted < NumToDrain && Commands.Dequeue(Command))
+    {
+        NumQueued--;
+        Overflows.Reset();
+        const bool bSuccess = Execute(Command, Overflows);
+        if (Command.OnCompleted)
+            Command.OnCompleted(bSuccess, Overflows);
+        NumExecuted++;
+    }
+
+    INC_DWORD_STAT_BY(STAT_SlotInventory_CommandsExecuted, NumExecuted);
+    return NumExecuted;
+}
+
+int32 FSlotInventoryCommandQueue::FailAll()
+{
+    check(IsInGameThread());
+
+    bClosed = true;
+
+    int32 NumFailed = 0;
+    FSlotInventoryCommand Command;
+    while (Commands.Dequeue(Command))
+    {
+        NumQueued--;
+        Fail(Command);
+        NumFailed++;
+    }
+    return NumFailed;
+}
+
+void FSlotInventoryCommandQueue::Fail(FSlotInventoryCommand& Command)
+{
+    if (Command.OnCompleted)
+        Command.OnCompleted(false, Command.Items);
+}
+
+bool FSlotInventoryCommandQueue::Execute(FSlotInventoryCommand& Command, TMap<FName, int32>& OutOverflows)
+{
+    USlotInventoryComponentBase* Inventory = Command.Inventory.Get();
+    if (!IsValid(Inventory))
+    {
+        OutOverflows = Command.Items;
+        return false;
+    }
+
+    switch (Command.Type)
+    {
+    case FSlotInventoryCommand::EType::AddStacks:
+        return Inventory->ModifyContent(Command.Items, OutOverflows);
+
+    case FSlotInventoryCommand::EType::RemoveStacks:
+    {
+        for (auto& [Item, Quantity] : Command.Items)
+            Quantity = -Quantity;
+        const bool bModified = Inventory->ModifyContent(Command.Items, OutOverflows);
+        for (auto& [Item, Quantity] : OutOverflows)
+            Quantity = -Quantity;
+        return bModified;
+    }
+
+    case FSlotInventoryCommand::EType::MoveSlot:
+        if (Command.DestinationIndex == INDEX_NONE)
+            return Inventory->DropSlotAmountTowardOtherInventory(Command.SourceIndex, Command.Destination.Get(), Command.MaxAmount);
+        return Inventory->DropSlotTowardOtherInventoryAtIndex(Command.SourceIndex, Command.Destination.Get(), Command.DestinationIndex, Command.MaxAmount);
+    }
+
+    return false;
+}
@@ -0,0 +1,158 @@
+// Amasson
+
+
+#include "Subsystems/SlotInventoryRequestBudget.h"
+#include "Engine/NetConnection.h"
+#include "HAL/IConsoleManager.h"
+#include "SlotInventoryStats.h"
+
+
+static TAutoConsoleVariable<bool> CVarSlotInventoryBudgetEnable(
+    TEXT("SlotInventory.Budget.Enable"),
+    false,
+    TEXT("Limit the server time spent on the inventory requests of each client connection."));
+
+static TAutoConsoleVariable<float> CVarSlotInventoryBudgetSlotsPerSecond(
+    TEXT("SlotInventory.Budget.SlotsPerSecond"),
+    20000.0f,
+    TEXT("Slot visits per second a client connection can spend on inventory requests."));
+
+static TAutoConsoleVariable<float> CVarSlotInventoryBudgetBurst(
+    TEXT("SlotInventory.Budget.Burst"),
+    40000.0f,
+    TEXT("Slot visits a client connection can spend at once after being idle."));
+
+static TAutoConsoleVariable<float> CVarSlotInventoryBudgetRequestCost(
+    TEXT("SlotInventory.Budget.RequestCost"),
+    16.0f,
+    TEXT("Slot visits counted for any inventory request, on top of the slots it scans."));
+
+static TAutoConsoleVariable<int32> CVarSlotInventoryBudgetMaxDeferred(
+    TEXT("SlotInventory.Budget.MaxDeferred"),
+    32,
+    TEXT("Requests of a client connection that can wait for budget before new ones are rejected."));
+
+
+bool FSlotInventoryRequestBudget::IsEnabled()
+{
+    return CVarSlotInventoryBudgetEnable.GetValueOnGameThread();
+}
+
+double FSlotInventoryRequestBudget::EstimateCost(ESlotInventoryServerRequest Request, int32 WorkSlots)
+{
+    double Cost = CVarSlotInventoryBudgetRequestCost.GetValueOnGameThread();
+
+    switch (Request)
+    {
+    /** Scan, resize or send up to WorkSlots slots */
+    case ESlotInventoryServerRequest::BroadcastFullInventory:
+    case ESlotInventoryServerRequest::SetContentCapacity:
+    case ESlotInventoryServerRequest::DropSlotTowardOtherInventory:
+    case ESlotInventoryServerRequest::DropSlotFromOtherInventory:
+    case ESlotInventoryServerRequest::RegroupSlotAtIndexWithSimilarIds:
+        Cost += FMath::Max(WorkSlots, 0);
+        break;
+
+    default:
+        break;
+    }
+
+    /** A request costing more than the burst could never be afforded, it waits for a full bucket instead */
+    return FMath::Min(Cost, (double)CVarSlotInventoryBudgetBurst.GetValueOnGameThread());
+}
+
+FSlotInventoryRequestBudget::EDecision FSlotInventoryRequestBudget::Consume(const UNetConnection* Connection, double Cost)
+{
+    if (Connection == nullptr || !IsEnabled())
+    {
+        INC_DWORD_STAT(STAT_SlotInventory_RequestsAccepted);
+        return EDecision::Accept;
+    }
+
+    FConnectionBudget& Budget = FindOrAddBudget(Connection);
+    Refill(Budget, FPlatformTime::Seconds());
+
+    /** Waiting requests go first to keep the order of reliable requests */
+    if (Budget.Deferred.IsEmpty() && Budget.Tokens >= Cost)
+    {
+        Budget.Tokens -= Cost;
+        INC_DWORD_STAT(STAT_SlotInventory_RequestsAccepted);
+        return EDecision::Accept;
+    }
+
+    if (Budget.Deferred.Num() < CVarSlotInventoryBudgetMaxDeferred.GetValueOnGameThread())
+        return EDecision::Defer;
+
+    INC_DWORD_STAT(STAT_SlotInventory_RequestsRejected);
+    return EDecision::Reject;
+}
+
+void FSlotInventoryRequestBudget::Defer(const UNetConnection* Connection, double Cost, const UObject* Requester, TFunction<void()>&& Execute)
+{
+    check(Connection);
+    INC_DWORD_STAT(STAT_SlotInventory_RequestsDeferred);
+    FindOrAddBudget(Connection).Deferred.Add({ Cost, Requester, MoveTemp(Execute) });
+}
+
+void FSlotInventoryRequestBudget::ProcessDeferred()
+{
+    SLOTINVENTORY_SCOPE_CYCLE_COUNTER(ProcessDeferredRequests);
+
+    const double NowSeconds = FPlatformTime::Seconds();
+    int32 NumDeferred = 0;
+
+    for (auto It = Connections.CreateIterator(); It; ++It)
+    {
+        if (It.Key().ResolveObjectPtr() == nullptr)
+        {
+            It.RemoveCurrent();
+            continue;
+        }
+
+        FConnectionBudget& Budget = It.Value();
+        Refill(Budget, NowSeconds);
+
+        int32 NumExecuted = 0;
+        while (NumExecuted < Budget.Deferred.Num() && Budget.Tokens >= Budget.Deferred[NumExecuted].Cost)
+        {
+            FDeferredRequest& Request = Budget.Deferred[NumExecuted++];
+            Budget.Tokens -= Request.Cost;
+            if (Request.Requester.IsValid())
+            {
+                INC_DWORD_STAT(STAT_SlotInventory_RequestsAccepted);
+                Request.Execute();
+            }
+        }
+        Budget.Deferred.RemoveAt(0, NumExecuted);
+        NumDeferred += Budget.Deferred.Num();
+    }
+
+    SET_DWORD_STAT(STAT_SlotInventory_RequestsWaiting, NumDeferred);
+}
+
+int32 FSlotInventoryRequestBudget::GetNumDeferred() const
+{
+    int32 NumDeferred = 0;
+    for (const auto& [Connection, Budget] : Connections)
+        NumDeferred += Budget.Deferred.Num();
+    return NumDeferred;
+}
+
+FSlotInventoryRequestBudget::FConnectionBudget& FSlotInventoryRequestBudget::FindOrAddBudget(const UNetConnection* Connection)
+{
+    if (FConnectionBudget* Budget = Connections.Find(Connection))
+        return *Budget;
+
+    FConnectionBudget& Budget = Connections.Add(Connection);
+    Budget.Tokens = CVarSlotInventoryBudgetBurst.GetValueOnGameThread();
+    Budget.LastRefillSeconds = FPlatformTime::Seconds();
+    return Budget;
+}
+
+void FSlotInventoryRequestBudget::Refill(FConnectionBudget& Budget, double NowSeconds)
+{
+    const double Rate = CVarSlotInventoryBudgetSlotsPerSecond.GetValueOnGameThread();
+    const double Burst = CVarSlotInventoryBudgetBurst.GetValueOnGameThread();
+    Budget.Tokens = FMath::Min(Burst, Budget.Tokens + (NowSeconds - Budget.LastRefillSeconds) * Rate);
+    Budget.LastRefillSeconds = NowSeconds;
+}
@@ -0,0 +1,367 @@
+// Amasson
+
+
+#include "Subsystems/SlotInventorySubsystem.h"
+#include "Components/SlotInventoryComponentBase.h"
+#include "Components/SceneComponent.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "HAL/IConsoleManager.h"
+#include "Transactions/SlotInventoryBatchEditScope.h"
+#include "SlotInventoryStats.h"
+
+
+static TAutoConsoleVariable<float> CVarCompactionBudgetUs(
+    TEXT("SlotInventory.Compaction.BudgetUs"),
+    100.0f,
+    TEXT("Microseconds per frame spent compacting idle inventories. 0 disables the background compaction."));
+
+static TAutoConsoleVariable<float> CVarRegistryCellSize(
+    TEXT("SlotInventory.Registry.CellSize"),
+    2000.0f,
+    TEXT("Size of the spatial hash cells used by the inventory radius queries."));
+
+static TAutoConsoleVariable<float> CVarMaintenanceBudgetUs(
+    TEXT("SlotInventory.Maintenance.BudgetUs"),
+    200.0f,
+    TEXT("Microseconds per frame spent merging and compacting the slots of inventories with background maintenance. 0 pauses the maintenance."));
+
+static TAutoConsoleVariable<float> CVarCompactionIdleSeconds(
+    TEXT("SlotInventory.Compaction.IdleSeconds"),
+    30.0f,
+    TEXT("Seconds without modification before an inventory is compacted."));
+
+
+void USlotInventorySubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+    Super::Initialize(Collection);
+
+    PreActorTickHandle = FWorldDelegates::OnWorldPreActorTick.AddUObject(this, &ThisClass::OnWorldPreActorTick);
+}
+
+void USlotInventorySubsystem::Deinitialize()
+{
+    FWorldDelegates::OnWorldPreActorTick.Remove(PreActorTickHandle);
+
+    /** Producers may still hold the queue, their pending and future commands complete as failed */
+    CommandQueue->FailAll();
+
+    Super::Deinitialize();
+}
+
+
+/** Command Queue */
+
+TSharedRef<FSlotInventoryCommandQueue, ESPMode::ThreadSafe> USlotInventorySubsystem::GetCommandQueue() const
+{
+    return CommandQueue;
+}
+
+void USlotInventorySubsystem::OnWorldPreActorTick(UWorld* InWorld, ELevelTick TickType, float DeltaSeconds)
+{
+    if (InWorld != GetWorld())
+        return;
+
+    ensureMsgf(FSlotInventoryBatchEditScope::EndUnbalanced(), TEXT("An inventory batch edit was begun without being ended"));
+
+    CommandQueue->Drain();
+    RequestBudget.ProcessDeferred();
+    CompactIdleInventories();
+    MaintainInventories();
+}
+
+
+/** Request Budget */
+
+FSlotInventoryRequestBudget& USlotInventorySubsystem::GetRequestBudget()
+{
+    return RequestBudget;
+}
+
+
+/** Inventories */
+
+void USlotInventorySubsystem::RegisterInventory(USlotInventoryComponentBase* Inventory)
+{
+    if (!IsValid(Inventory) || InventoryIndices.Contains(Inventory))
+        return;
+
+    const UObject* Owner = Inventory->GetOwner();
+    const int32 Index = Inventories.Num();
+
+    FRegisteredInventory& Registered = Inventories.AddDefaulted_GetRef();
+    Registered.Inventory = Inventory;
+    Registered.InventoryKey = Inventory;
+    Registered.Owner = Owner;
+    Registered.OwnerClass = Owner ? Owner->GetClass() : nullptr;
+    Registered.Tag = Inventory->GetInventoryTag();
+
+    TArray<int32>& ClassBucket = InventoryIndicesByOwnerClass.FindOrAdd(Registered.OwnerClass);
+    Registered.ClassBucketIndex = ClassBucket.Add(Index);
+
+    InventoryIndices.Add(Inventory, Index);
+    InventoryIndicesByOwnerAndTag.FindOrAdd({ Registered.Owner, Registered.Tag }).Add(Index);
+
+    if (const AActor* OwnerActor = Inventory->GetOwner(); OwnerActor && OwnerActor->GetRootComponent())
+    {
+        USceneComponent* OwnerRoot = OwnerActor->GetRootComponent();
+        Registered.OwnerRoot = OwnerRoot;
+        Registered.TransformUpdatedHandle = OwnerRoot->TransformUpdated.AddUObject(this, &ThisClass::OnOwnerTransformUpdated, Registered.InventoryKey);
+        MovedInventories.Add(Registered.InventoryKey);
+    }
+}
+
+void USlotInventorySubsystem::UnregisterInventory(USlotInventoryComponentBase* Inventory)
+{
+    if (const int32* Index = InventoryIndices.Find(Inventory))
+        RemoveInventoryAt(*Index);
+}
+
+void USlotInventorySubsystem::RemoveInventoryAt(int32 Index)
+{
+    const FRegisteredInventory& Removed = Inventories[Index];
+
+    InventoryIndices.Remove(Removed.InventoryKey);
+
+    /** Another inventory sharing the owner and tag becomes the first one */
+    const TPair<TObjectKey<UObject>, FName> OwnerAndTag(Removed.Owner, Removed.Tag);
+    TArray<int32, TInlineAllocator<1>>& TaggedIndices = InventoryIndicesByOwnerAndTag.FindChecked(OwnerAndTag);
+    TaggedIndices.RemoveSingle(Index);
+    if (TaggedIndices.IsEmpty())
+        InventoryIndicesByOwnerAndTag.Remove(OwnerAndTag);
+
+    if (USceneComponent* OwnerRoot = Removed.OwnerRoot.Get())
+        OwnerRoot->TransformUpdated.Remove(Removed.TransformUpdatedHandle);
+    MovedInventories.Remove(Removed.InventoryKey);
+    if (Removed.bInSpatialCell)
+    {
+        TArray<int32, TInlineAllocator<4>>& Cell = SpatialCells.FindChecked(Removed.SpatialCell);
+        Cell.RemoveSingleSwap(Index);
+        if (Cell.IsEmpty())
+            SpatialCells.Remove(Removed.SpatialCell);
+    }
+
+    TArray<int32>& ClassBucket = InventoryIndicesByOwnerClass.FindChecked(Removed.OwnerClass);
+    ClassBucket.RemoveAtSwap(Removed.ClassBucketIndex);
+    if (ClassBucket.IsValidIndex(Removed.ClassBucketIndex))
+        Inventories[ClassBucket[Removed.ClassBucketIndex]].ClassBucketIndex = Removed.ClassBucketIndex;
+    else if (ClassBucket.IsEmpty())
+        InventoryIndicesByOwnerClass.Remove(Removed.OwnerClass);
+
+    /** The last inventory takes the removed place, point its indices there */
+    const int32 LastIndex = Inventories.Num() - 1;
+    if (Index != LastIndex)
+    {
+        const FRegisteredInventory& Moved = Inventories[LastIndex];
+        InventoryIndices[Moved.InventoryKey] = Index;
+        *InventoryIndicesByOwnerAndTag.FindChecked({ Moved.Owner, Moved.Tag }).FindByKey(LastIndex) = Index;
+        InventoryIndicesByOwnerClass[Moved.OwnerClass][Moved.ClassBucketIndex] = Index;
+        if (Moved.bInSpatialCell)
+            *SpatialCells.FindChecked(Moved.SpatialCell).FindByKey(LastIndex) = Index;
+    }
+
+    Inventories.RemoveAtSwap(Index);
+}
+
+USlotInventoryComponentBase* USlotInventorySubsystem::FindInventory(const UObject* Owner, FName InventoryTag) const
+{
+    const TArray<int32, TInlineAllocator<1>>* Indices = InventoryIndicesByOwnerAndTag.Find({ Owner, InventoryTag });
+    return Indices ? Inventories[(*Indices)[0]].Inventory.Get() : nullptr;
+}
+
+USlotInventoryComponentBase* USlotInventorySubsystem::FindUniqueInventory(const UObject* Owner, FName InventoryTag) const
+{
+    const TArray<int32, TInlineAllocator<1>>* Indices = InventoryIndicesByOwnerAndTag.Find({ Owner, InventoryTag });
+    return Indices && Indices->Num() == 1 ? Inventories[(*Indices)[0]].Inventory.Get() : nullptr;
+}
+
+void USlotInventorySubsystem::GetInventoriesOfOwnerClass(TSubclassOf<AActor> OwnerClass, TArray<USlotInventoryComponentBase*>& OutInventories) const
+{
+    OutInventories.Reset();
+    if (OwnerClass == nullptr)
+        return;
+
+    /** Few distinct owner classes, test each of them rather than each inventory */
+    for (const auto& [ClassKey, ClassBucket] : InventoryIndicesByOwnerClass)
+    {
+        const UClass* Class = ClassKey.ResolveObjectPtr();
+        if (Class == nullptr || !Class->IsChildOf(OwnerClass))
+            continue;
+
+        for (int32 Index : ClassBucket)
+        {
+            if (USlotInventoryComponentBase* Inventory = Inventories[Index].Inventory.Get())
+                OutInventories.Add(Inventory);
+        }
+    }
+}
+
+void USlotInventorySubsystem::GetInventoriesInRadius(FVector Center, float Radius, TArray<USlotInventoryComponentBase*>& OutInventories)
+{
+    SLOTINVENTORY_SCOPE_CYCLE_COUNTER(RegistryRadiusQuery);
+
+    OutInventories.Reset();
+    if (Radius < 0.0f)
+        return;
+
+    UpdateSpatialCells();
+
+    const double RadiusSquared = FMath::Square((double)Radius);
+    auto AddInventoriesInRadius = [&](const TArray<int32, TInlineAllocator<4>>& Cell)
+    {
+        for (int32 Index : Cell)
+        {
+            USlotInventoryComponentBase* Inventory = Inventories[Index].Inventory.Get();
+            const AActor* Owner = Inventory ? Inventory->GetOwner() : nullptr;
+            if (Owner && FVector::DistSquared(Owner->GetActorLocation(), Center) <= RadiusSquared)
+                OutInventories.Add(Inventory);
+        }
+    };
+
+    /** A large radius covers more cells than there are occupied ones, visit the occupied cells instead */
+    const double CellsPerAxis = 2.0 * Radius / SpatialCellSize + 2.0;
+    if (CellsPerAxis * CellsPerAxis * CellsPerAxis > SpatialCells.Num())
+    {
+        for (const auto& [CellKey, Cell] : SpatialCells)
+            AddInventoriesInRadius(Cell);
+        return;
+    }
+
+    const FIntVector MinCell = GetSpatialCell(Center - Radius);
+    const FIntVector MaxCell = GetSpatialCell(Center + Radius);
+
+    for (int32 X = MinCell.X; X <= MaxCell.X; X++)
+    {
+        for (int32 Y = MinCell.Y; Y <= MaxCell.Y; Y++)
+        {
+            for (int32 Z = MinCell.Z; Z <= MaxCell.Z; Z++)
+            {
+                if (const TArray<int32, TInlineAllocator<4>>* Cell = SpatialCells.Find(FIntVector(X, Y, Z)))
+                    AddInventoriesInRadius(*Cell);
+            }
+        }
+    }
+}
+
+void USlotInventorySubsystem::UpdateSpatialCells()
+{
+    const float CellSize = FMath::Max(CVarRegistryCellSize.GetValueOnGameThread(), 1.0f);
+    if (SpatialCellSize != CellSize)
+    {
+        SpatialCellSize = CellSize;
+        SpatialCells.Reset();
+        MovedInventories.Reset();
+        for (int32 Index = 0; Index < Inventories.Num(); Index++)
+        {
+            Inventories[Index].bInSpatialCell = false;
+            UpdateSpatialCell(Index);
+        }
+        return;
+    }
+
+    for (const TObjectKey<USlotInventoryComponentBase>& InventoryKey : MovedInventories)
+    {
+        if (const int32* Index = InventoryIndices.Find(InventoryKey))
+            UpdateSpatialCell(*Index);
+    }
+    MovedInventories.Reset();
+}
+
+void USlotInventorySubsystem::UpdateSpatialCell(int32 Index)
+{
+    FRegisteredInventory& Registered = Inventories[Index];
+    const USceneComponent* OwnerRoot = Registered.OwnerRoot.Get();
+    const bool bHasCell = OwnerRoot != nullptr;
+    const FIntVector Cell = bHasCell ? GetSpatialCell(OwnerRoot->GetComponentLocation()) : FIntVector::ZeroValue;
+
+    if (Registered.bInSpatialCell)
+    {
+        if (bHasCell && Registered.SpatialCell == Cell)
+            return;
+
+        TArray<int32, TInlineAllocator<4>>& OldCell = SpatialCells.FindChecked(Registered.SpatialCell);
+        OldCell.RemoveSingleSwap(Index);
+        if (OldCell.IsEmpty())
+            SpatialCells.Remove(Registered.SpatialCell);
+    }
+
+    Registered.bInSpatialCell = bHasCell;
+    Registered.SpatialCell = Cell;
+    if (bHasCell)
+        SpatialCells.FindOrAdd(Cell).Add(Index);
+}
+
+void USlotInventorySubsystem::OnOwnerTransformUpdated(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport, TObjectKey<USlotInventoryComponentBase> InventoryKey)
+{
+    MovedInventories.Add(InventoryKey);
+}
+
+FIntVector USlotInventorySubsystem::GetSpatialCell(const FVector& Location) const
+{
+    return FIntVector(
+        FMath::FloorToInt(Location.X / SpatialCellSize),
+        FMath::FloorToInt(Location.Y / SpatialCellSize),
+        FMath::FloorToInt(Location.Z / SpatialCellSize));
+}
+
+void USlotInventorySubsystem::QueueMaintenance(USlotInventoryComponentBase* Inventory)
+{
+    MaintenanceQueue.Add(Inventory);
+}
+
+void USlotInventorySubsystem::MaintainInventories()
+{
+    const double BudgetSeconds = CVarMaintenanceBudgetUs.GetValueOnGameThread() * 1e-6;
+    if (BudgetSeconds <= 0.0 || MaintenanceQueue.IsEmpty())
+        return;
+
+    SLOTINVENTORY_SCOPE_CYCLE_COUNTER(MaintainInventories);
+
+    const double EndSeconds = FPlatformTime::Seconds() + BudgetSeconds;
+
+    /** Visit each inventory at most once per frame, the budget is shared in turn */
+    const int32 NumQueued = MaintenanceQueue.Num();
+    for (int32 NumVisited = 0; NumVisited < NumQueued && !MaintenanceQueue.IsEmpty() && FPlatformTime::Seconds() < EndSeconds; NumVisited++)
+    {
+        if (NextMaintenanceIndex >= MaintenanceQueue.Num())
+            NextMaintenanceIndex = 0;
+
+        USlotInventoryComponentBase* Inventory = MaintenanceQueue[NextMaintenanceIndex].Get();
+        if (!IsValid(Inventory) || Inventory->RunBackgroundMaintenance(EndSeconds))
+            MaintenanceQueue.RemoveAtSwap(NextMaintenanceIndex);
+        else
+            NextMaintenanceIndex++;
+    }
+}
+
+void USlotInventorySubsystem::CompactIdleInventories()
+{
+    const double BudgetSeconds = CVarCompactionBudgetUs.GetValueOnGameThread() * 1e-6;
+    if (BudgetSeconds <= 0.0 || Inventories.IsEmpty())
+        return;
+
+    SLOTINVENTORY_SCOPE_CYCLE_COUNTER(CompactIdleInventories);
+
+    const double IdleSeconds = CVarCompactionIdleSeconds.GetValueOnGameThread();
+    const double EndSeconds = FPlatformTime::Seconds() + BudgetSeconds;
+
+    /** Visit each inventory at most once per frame */
+    for (int32 NumVisited = 0; NumVisited < Inventories.Num() && FPlatformTime::Seconds() < EndSeconds; NumVisited++)
+    {
+        if (NextCompactionIndex >= Inventories.Num())
+            NextCompactionIndex = 0;
+
+        USlotInventoryComponentBase* Inventory = Inventories[NextCompactionIndex].Inventory.Get();
+        if (!IsValid(Inventory))
+        {
+            RemoveInventoryAt(NextCompactionIndex);
+            continue;
+        }
+
+        if (Inventory->ShouldDehydrateContent())
+            Inventory->DehydrateContent();
+        else if (Inventory->ShouldCompactMemory(IdleSeconds))
+            Inventory->CompactMemory();
+        NextCompactionIndex++;
+    }
+}
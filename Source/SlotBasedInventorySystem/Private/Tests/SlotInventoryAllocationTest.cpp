@@ -0,0 +1,97 @@
+// Amasson
+
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "Debug/SlotInventoryMemory.h"
+#include "UObject/Package.h"
+#include "Components/SlotInventoryComponentBase.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace SlotInventoryAllocationTest
+{
+    /**
+     * Allocated size of the inventory containers and of the caller overflow map.
+     * Replacing GMalloc to count allocations would race with the other threads, a warmed up
+     * content update must instead leave every reused container at the size it already had.
+     */
+    struct FAllocatedSizes
+    {
+        FSlotInventoryMemoryUsage Usage;
+        SIZE_T Overflows = 0;
+
+        FAllocatedSizes(const USlotInventoryComponentBase& Inventory, const TMap<FName, int32>& InOverflows)
+            : Usage(Inventory.GetMemoryUsage())
+            , Overflows(InOverflows.GetAllocatedSize())
+        {
+        }
+
+        bool operator==(const FAllocatedSizes& Other) const
+        {
+            return Usage.Slots == Other.Usage.Slots
+                && Usage.Modifiers == Other.Usage.Modifiers
+                && Usage.ModifierPayloads == Other.Usage.ModifierPayloads
+                && Usage.Tracking == Other.Usage.Tracking
+                && Usage.Dehydrated == Other.Usage.Dehydrated
+                && Overflows == Other.Overflows;
+        }
+    };
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSlotInventoryModifyContentAllocationTest, "SlotInventory.Allocations.ModifyContent",
+    EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FSlotInventoryModifyContentAllocationTest::RunTest(const FString& Parameters)
+{
+    using namespace SlotInventoryAllocationTest;
+
+    USlotInventoryComponentBase* Inventory = NewObject<USlotInventoryComponentBase>(GetTransientPackage());
+    Inventory->SetContentCapacity(32);
+
+    /** Native slot change listeners go through the reused slot change array as well */
+    int32 NumSlotChanges = 0;
+    const FDelegateHandle Handle = Inventory->OnInventorySlotsChanged().AddLambda(
+        [&NumSlotChanges](USlotInventoryComponentBase*, TConstArrayView<FInventorySlotChange> Changes)
+        {
+            NumSlotChanges += Changes.Num();
+        });
+
+    const FName Item(TEXT("SlotInventoryAllocationTest_Item"));
+    TMap<FName, int32> Added;
+    Added.Add(Item, 300);
+    TMap<FName, int32> Overflows;
+
+    /** The added stacks fill the first two slots */
+    auto ModifyAndFlush = [&]()
+    {
+        Inventory->ModifyContent(Added, Overflows);
+        Inventory->FlushContentUpdate();
+        Inventory->ClearSlotAtIndex(0);
+        Inventory->ClearSlotAtIndex(1);
+        Inventory->FlushContentUpdate();
+    };
+
+    /** The first calls size the scratch containers of the inventory and of Overflows */
+    for (int32 Iteration = 0; Iteration < 4; Iteration++)
+        ModifyAndFlush();
+
+    const int32 NumWarmSlotChanges = NumSlotChanges;
+    const FAllocatedSizes WarmSizes(*Inventory, Overflows);
+    int32 NumGrownIterations = 0;
+    for (int32 Iteration = 0; Iteration < 16; Iteration++)
+    {
+        ModifyAndFlush();
+        if (!(FAllocatedSizes(*Inventory, Overflows) == WarmSizes))
+            NumGrownIterations++;
+    }
+
+    Inventory->OnInventorySlotsChanged().Remove(Handle);
+    Inventory->MarkAsGarbage();
+
+    TestTrue(TEXT("Slot changes were broadcast"), NumSlotChanges > NumWarmSlotChanges);
+    TestEqual(TEXT("Iterations of a warmed up ModifyContent and content update that resized a container"), NumGrownIterations, 0);
+    return true;
+}
+
+#endif
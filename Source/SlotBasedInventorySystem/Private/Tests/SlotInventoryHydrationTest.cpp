@@ -0,0 +1,69 @@
+// Amasson
+
+
+#include "CoreMinimal.h"
+#include "Misc/AutomationTest.h"
+#include "InstancedStruct.h"
+#include "UObject/Package.h"
+#include "Components/SlotInventoryComponentBase.h"
+#include "Crafting/SlotInventoryCraftabilityEvaluator.h"
+#include "Persistence/SlotInventoryAsyncSave.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FSlotInventoryDehydrateRoundTripTest, "SlotInventory.Persistence.DehydrateRoundTrip",
+    EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::EngineFilter)
+
+bool FSlotInventoryDehydrateRoundTripTest::RunTest(const FString& Parameters)
+{
+    /** The properties of FSlotInventoryRecipe are not SaveGame, a SaveGame only blob drops them */
+    FSlotInventoryRecipe Recipe;
+    Recipe.Name = TEXT("SlotInventoryHydrationTest_Recipe");
+    Recipe.Ingredients.Add(TEXT("SlotInventoryHydrationTest_Ingredient"), 3);
+
+    FItemModifier Modifier;
+    Modifier.Type = TEXT("SlotInventoryHydrationTest_Modifier");
+    Modifier.Data = FInstancedStruct::Make(Recipe);
+
+    FInventorySlot Slot;
+    Slot.Item = TEXT("SlotInventoryHydrationTest_Item");
+    Slot.Quantity = 2;
+    Slot.Modifiers.Add(Modifier);
+
+    USlotInventoryComponentBase* Inventory = NewObject<USlotInventoryComponentBase>(GetTransientPackage());
+    Inventory->SetContentCapacity(4);
+    Inventory->SetSlotValueAtIndex(1, Slot);
+    Inventory->FlushContentUpdate();
+
+    TestTrue(TEXT("Content dehydrated"), Inventory->DehydrateContent());
+    TestFalse(TEXT("Content is not hydrated"), Inventory->IsContentHydrated());
+
+    FInventorySlot HydratedSlot;
+    TestTrue(TEXT("Slot read after hydration"), Inventory->GetSlotValueAtIndex(1, HydratedSlot));
+    TestEqual(TEXT("Hydrated item"), HydratedSlot.Item, Slot.Item);
+    TestEqual(TEXT("Hydrated quantity"), HydratedSlot.Quantity, Slot.Quantity);
+
+    const FSlotInventoryRecipe* HydratedRecipe = HydratedSlot.Modifiers.Num() == 1 ? HydratedSlot.Modifiers[0].Data.GetPtr<FSlotInventoryRecipe>() : nullptr;
+    if (TestNotNull(TEXT("Hydrated modifier payload"), HydratedRecipe))
+    {
+        TestEqual(TEXT("Hydrated modifier type"), HydratedSlot.Modifiers[0].Type, Modifier.Type);
+        TestEqual(TEXT("Hydrated non SaveGame payload name"), HydratedRecipe->Name, Recipe.Name);
+        TestTrue(TEXT("Hydrated non SaveGame payload map"), HydratedRecipe->Ingredients.OrderIndependentCompareEqual(Recipe.Ingredients));
+    }
+
+    /** Saves still only keep the SaveGame properties */
+    TArray<uint8> SaveBytes;
+    FInventoryContent SavedContent;
+    TestTrue(TEXT("Content saved"), FSlotInventoryAsyncSave::SerializeContent(Inventory->GetContent(), SaveBytes));
+    TestTrue(TEXT("Content loaded"), FSlotInventoryAsyncSave::DeserializeContent(SaveBytes, SavedContent));
+
+    const FInventorySlot* SavedSlot = SavedContent.GetSlotConstPtrAtIndex(1);
+    const FSlotInventoryRecipe* SavedRecipe = SavedSlot && SavedSlot->Modifiers.Num() == 1 ? SavedSlot->Modifiers[0].Data.GetPtr<FSlotInventoryRecipe>() : nullptr;
+    if (TestNotNull(TEXT("Saved modifier payload"), SavedRecipe))
+        TestTrue(TEXT("Saved payload without its non SaveGame properties"), SavedRecipe->Name.IsNone() && SavedRecipe->Ingredients.IsEmpty());
+
+    Inventory->MarkAsGarbage();
+    return true;
+}
+
+#endif
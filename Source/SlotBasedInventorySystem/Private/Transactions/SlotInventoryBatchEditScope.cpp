@@ -0,0 +1,59 @@
+// Amasson
+
+
+#include "Transactions/SlotInventoryBatchEditScope.h"
+#include "Components/SlotInventoryComponentBase.h"
+#include "SlotInventoryStats.h"
+
+
+int32 FSlotInventoryBatchEditScope::Depth = 0;
+
+TArray<TWeakObjectPtr<USlotInventoryComponentBase>> FSlotInventoryBatchEditScope::ModifiedInventories;
+
+void FSlotInventoryBatchEditScope::Begin()
+{
+    check(IsInGameThread());
+    Depth++;
+}
+
+void FSlotInventoryBatchEditScope::End()
+{
+    check(IsInGameThread());
+
+    if (!ensureMsgf(Depth > 0, TEXT("Inventory batch edit ended without being begun")))
+        return;
+
+    if (--Depth == 0)
+        FlushInventories();
+}
+
+void FSlotInventoryBatchEditScope::AddModifiedInventory(USlotInventoryComponentBase* Inventory)
+{
+    check(IsBatching());
+    ModifiedInventories.AddUnique(Inventory);
+}
+
+bool FSlotInventoryBatchEditScope::EndUnbalanced()
+{
+    if (Depth == 0)
+        return true;
+
+    Depth = 0;
+    FlushInventories();
+    return false;
+}
+
+void FSlotInventoryBatchEditScope::FlushInventories()
+{
+    SLOTINVENTORY_SCOPE_CYCLE_COUNTER(FlushBatchEdit);
+
+    /** Listeners modifying inventories during the flush are back to the next tick update, or open their own batch */
+    TArray<TWeakObjectPtr<USlotInventoryComponentBase>> Inventories = MoveTemp(ModifiedInventories);
+    ModifiedInventories.Reset();
+
+    for (const TWeakObjectPtr<USlotInventoryComponentBase>& WeakInventory : Inventories)
+    {
+        if (USlotInventoryComponentBase* Inventory = WeakInventory.Get())
+            Inventory->FlushContentUpdate();
+    }
+}
@@ -0,0 +1,241 @@
+// Amasson
+
+
+#include "Transactions/SlotInventoryTransaction.h"
+#include "Components/SlotInventoryComponentBase.h"
+#include "Debug/SlotInventoryJournal.h"
+#include "SlotInventoryStats.h"
+
+
+FSlotInventoryTransaction::~FSlotInventoryTransaction()
+{
+    if (State == EState::Open || State == EState::Failed)
+        Abort();
+}
+
+
+/** Staging */
+
+bool FSlotInventoryTransaction::ModifyContent(USlotInventoryComponentBase* Inventory, const TMap<FName, int32>& Items, bool bAllowOverflow)
+{
+    SLOTINVENTORY_SCOPE_CYCLE_COUNTER(TransactionStage);
+
+    FParticipant* Participant = GetParticipant(Inventory);
+    if (Participant == nullptr)
+        return Stage(false);
+
+    const FInventoryContent::FMaxStackSizes MaxStackSizes = Inventory->GetMaxStackSizesFromIds(Items);
+
+    FInventoryContent::FPreviousValues PreviousValues;
+    FInventoryContent::FItemStacks Stacks(Items);
+    FInventoryContent::FContentModifications Modifications;
+    Modifications.PreviousValues = &PreviousValues;
+
+    FInventoryContentTransactionRule Rule;
+    Rule.bAtomic = !bAllowOverflow;
+    Inventory->Content.ReceiveStacks(Stacks, Rule, MaxStackSizes, Modifications);
+    JournalPreviousValues(*Participant, PreviousValues);
+
+    bool bOverflowed = false;
+    for (const auto& [Item, QuantityLeft] : Stacks)
+        bOverflowed |= QuantityLeft != 0;
+
+    return Stage(bAllowOverflow || !bOverflowed);
+}
+
+bool FSlotInventoryTransaction::DropSlotTowardOtherInventoryAtIndex(USlotInventoryComponentBase* Source, int32 SourceIndex, USlotInventoryComponentBase* Destination, int32 DestinationIndex, int32 MaxAmount)
+{
+    SLOTINVENTORY_SCOPE_CYCLE_COUNTER(TransactionStage);
+
+    FParticipant* SourceParticipant = GetParticipant(Source);
+    FParticipant* DestinationParticipant = SourceParticipant ? GetParticipant(Destination) : nullptr;
+    if (SourceParticipant == nullptr || DestinationParticipant == nullptr)
+        return Stage(false);
+
+    /** Adding the destination may have moved the source participant */
+    SourceParticipant = GetParticipant(Source);
+
+    const FInventorySlot* SourceConstSlot = Source->Content.GetSlotConstPtrAtIndex(SourceIndex);
+    const FInventorySlot* DestinationSlot = Destination->Content.GetSlotConstPtrAtIndex(DestinationIndex);
+    if (SourceConstSlot == nullptr || DestinationSlot == nullptr)
+        return Stage(false);
+
+    /** A swap can move modifiers, journal both slots entirely */
+    JournalSlot(*SourceParticipant, SourceIndex, *SourceConstSlot);
+    JournalSlot(*DestinationParticipant, DestinationIndex, *DestinationSlot);
+
+    /** An empty source is only written, and its sparse page allocated, if the swap gives it a slot */
+    FInventorySlot EmptySourceSlot;
+    FInventorySlot* SourceSlot = SourceConstSlot->IsEmpty() ? &EmptySourceSlot : Source->Content.GetSlotPtrAtIndex(SourceIndex);
+
+    FInventorySlotTransactionRule Rule;
+    Rule.bAllowSwap = true;
+    Rule.MaxTransferQuantity = MaxAmount;
+    const int32 MaxStackSize = Destination->GetMaxStackSizeForID(SourceSlot->Item);
+    const bool bModified = Destination->Content.ReceiveSlotAtIndex(*SourceSlot, DestinationIndex, Rule, MaxStackSize);
+    if (bModified && SourceSlot == &EmptySourceSlot && !EmptySourceSlot.IsEmpty())
+        *Source->Content.GetSlotPtrAtIndex(SourceIndex) = MoveTemp(EmptySourceSlot);
+    return Stage(bModified);
+}
+
+bool FSlotInventoryTransaction::DropSlotTowardOtherInventory(USlotInventoryComponentBase* Source, int32 SourceIndex, USlotInventoryComponentBase* Destination)
+{
+    SLOTINVENTORY_SCOPE_CYCLE_COUNTER(TransactionStage);
+
+    FParticipant* SourceParticipant = GetParticipant(Source);
+    FParticipant* DestinationParticipant = SourceParticipant ? GetParticipant(Destination) : nullptr;
+    if (SourceParticipant == nullptr || DestinationParticipant == nullptr)
+        return Stage(false);
+
+    SourceParticipant = GetParticipant(Source);
+
+    const FInventorySlot* SourceConstSlot = Source->Content.GetSlotConstPtrAtIndex(SourceIndex);
+    if (SourceConstSlot == nullptr || SourceConstSlot->IsEmpty())
+        return Stage(false);
+
+    FInventorySlot* SourceSlot = Source->Content.GetSlotPtrAtIndex(SourceIndex);
+
+    JournalSlot(*SourceParticipant, SourceIndex, *SourceSlot);
+
+    FInventoryContent::FPreviousValues PreviousValues;
+    FInventoryContent::FContentModifications Modifications;
+    Modifications.PreviousValues = &PreviousValues;
+
+    FInventoryContentTransactionRule Rule;
+    const int32 MaxStackSize = Destination->GetMaxStackSizeForID(SourceSlot->Item);
+    const bool bModified = Destination->Content.ReceiveSlot(*SourceSlot, Rule, MaxStackSize, Modifications);
+    JournalPreviousValues(*DestinationParticipant, PreviousValues);
+
+    return Stage(bModified);
+}
+
+bool FSlotInventoryTransaction::SetSlotValueAtIndex(USlotInventoryComponentBase* Inventory, int32 Index, const FInventorySlot& NewSlotValue)
+{
+    FParticipant* Participant = GetParticipant(Inventory);
+    FInventorySlot* Slot = Participant ? Inventory->Content.GetSlotPtrAtIndex(Index) : nullptr;
+    if (Slot == nullptr)
+        return Stage(false);
+
+    JournalSlot(*Participant, Index, *Slot);
+    *Slot = NewSlotValue;
+    return Stage(true);
+}
+
+bool FSlotInventoryTransaction::ClearSlotAtIndex(USlotInventoryComponentBase* Inventory, int32 Index)
+{
+    FParticipant* Participant = GetParticipant(Inventory);
+    FInventorySlot* Slot = Participant ? Inventory->Content.GetSlotPtrAtIndex(Index) : nullptr;
+    if (Slot == nullptr)
+        return Stage(false);
+
+    JournalSlot(*Participant, Index, *Slot);
+    Slot->Reset();
+    return Stage(true);
+}
+
+
+/** Resolution */
+
+bool FSlotInventoryTransaction::CanCommit() const
+{
+    return State == EState::Open;
+}
+
+bool FSlotInventoryTransaction::Commit()
+{
+    SLOTINVENTORY_SCOPE_CYCLE_COUNTER(TransactionCommit);
+
+    if (!CanCommit())
+    {
+        Abort();
+        return false;
+    }
+
+    for (FParticipant& Participant : Participants)
+    {
+        USlotInventoryComponentBase* Inventory = Participant.Inventory.Get();
+        if (!IsValid(Inventory))
+            continue;
+
+        for (const auto& [Index, OriginalSlot] : Participant.OriginalSlots)
+            Inventory->MarkDirtySlot(Index);
+
+        if (FSlotInventoryJournal* Journal = FSlotInventoryJournal::GetRecording())
+        {
+            TArray<int32> CommittedIndices;
+            Participant.OriginalSlots.GetKeys(CommittedIndices);
+            Journal->RecordSlotValues(Inventory, CommittedIndices);
+        }
+    }
+
+    Participants.Reset();
+    State = EState::Committed;
+    return true;
+}
+
+void FSlotInventoryTransaction::Abort()
+{
+    SLOTINVENTORY_SCOPE_CYCLE_COUNTER(TransactionAbort);
+
+    if (State == EState::Committed || State == EState::Aborted)
+        return;
+
+    for (FParticipant& Participant : Participants)
+    {
+        USlotInventoryComponentBase* Inventory = Participant.Inventory.Get();
+        if (!IsValid(Inventory))
+            continue;
+
+        for (auto& [Index, OriginalSlot] : Participant.OriginalSlots)
+        {
+            if (FInventorySlot* Slot = Inventory->Content.GetSlotPtrAtIndex(Index))
+                *Slot = MoveTemp(OriginalSlot);
+        }
+    }
+
+    Participants.Reset();
+    State = EState::Aborted;
+}
+
+
+/** Journal */
+
+FSlotInventoryTransaction::FParticipant* FSlotInventoryTransaction::GetParticipant(USlotInventoryComponentBase* Inventory)
+{
+    if (!IsValid(Inventory) || (State != EState::Open && State != EState::Failed))
+        return nullptr;
+
+    for (FParticipant& Participant : Participants)
+    {
+        if (Participant.Inventory == Inventory)
+            return &Participant;
+    }
+
+    Inventory->EnsureContentHydrated();
+
+    FParticipant& Participant = Participants.AddDefaulted_GetRef();
+    Participant.Inventory = Inventory;
+    return &Participant;
+}
+
+void FSlotInventoryTransaction::JournalSlot(FParticipant& Participant, int32 Index, const FInventorySlot& Value)
+{
+    if (!Participant.OriginalSlots.Contains(Index))
+        Participant.OriginalSlots.Add(Index, Value);
+}
+
+void FSlotInventoryTransaction::JournalPreviousValues(FParticipant& Participant, FInventoryContent::FPreviousValues& PreviousValues)
+{
+    for (TPair<int32, FInventorySlot>& PreviousValue : PreviousValues)
+    {
+        if (!Participant.OriginalSlots.Contains(PreviousValue.Key))
+            Participant.OriginalSlots.Add(PreviousValue.Key, MoveTemp(PreviousValue.Value));
+    }
+}
+
+bool FSlotInventoryTransaction::Stage(bool bSucceeded)
+{
+    if (!bSucceeded && State == EState::Open)
+        State = EState::Failed;
+    return bSucceeded;
+}
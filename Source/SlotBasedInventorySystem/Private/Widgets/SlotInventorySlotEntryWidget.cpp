@@ -0,0 +1,47 @@
+// Amasson
+
+
+#include "Widgets/SlotInventorySlotEntryWidget.h"
+#include "Widgets/SlotInventoryViewModel.h"
+
+
+USlotInventorySlotViewItem* USlotInventorySlotEntryWidget::GetSlotViewItem() const
+{
+    return SlotViewItem.Get();
+}
+
+void USlotInventorySlotEntryWidget::NativeOnListItemObjectSet(UObject* ListItemObject)
+{
+    IUserObjectListEntry::NativeOnListItemObjectSet(ListItemObject);
+
+    BindSlotViewItem(Cast<USlotInventorySlotViewItem>(ListItemObject));
+    OnSlotViewItemUpdated(SlotViewItem.Get());
+}
+
+void USlotInventorySlotEntryWidget::NativeOnEntryReleased()
+{
+    BindSlotViewItem(nullptr);
+
+    IUserObjectListEntry::NativeOnEntryReleased();
+}
+
+void USlotInventorySlotEntryWidget::BindSlotViewItem(USlotInventorySlotViewItem* NewItem)
+{
+    if (USlotInventorySlotViewItem* PreviousItem = SlotViewItem.Get())
+        PreviousItem->OnSlotUpdated.RemoveDynamic(this, &ThisClass::OnSlotViewItemUpdated);
+
+    SlotViewItem = NewItem;
+
+    if (NewItem)
+        NewItem->OnSlotUpdated.AddDynamic(this, &ThisClass::OnSlotViewItemUpdated);
+}
+
+void USlotInventorySlotEntryWidget::OnSlotViewItemUpdated(USlotInventorySlotViewItem* UpdatedItem)
+{
+    if (UpdatedItem == nullptr)
+        return;
+
+    FInventorySlot SlotValue;
+    UpdatedItem->GetSlotValue(SlotValue);
+    OnSlotValueChanged(UpdatedItem->GetSlotIndex(), SlotValue);
+}
@@ -0,0 +1,264 @@
+// Amasson
+
+
+#include "Widgets/SlotInventoryViewModel.h"
+#include "Components/SlotInventoryComponentBase.h"
+#include "Components/ListView.h"
+#include "Blueprint/UserWidget.h"
+#include "SlotInventoryStats.h"
+
+
+/** Slot View Item */
+
+USlotInventoryViewModel* USlotInventorySlotViewItem::GetViewModel() const
+{
+    return GetTypedOuter<USlotInventoryViewModel>();
+}
+
+USlotInventoryComponentBase* USlotInventorySlotViewItem::GetInventory() const
+{
+    USlotInventoryViewModel* ViewModel = GetViewModel();
+    return ViewModel ? ViewModel->GetInventory() : nullptr;
+}
+
+bool USlotInventorySlotViewItem::GetSlotValue(FInventorySlot& SlotValue) const
+{
+    USlotInventoryComponentBase* Inventory = GetInventory();
+    return Inventory ? Inventory->GetSlotValueAtIndex(SlotIndex, SlotValue) : false;
+}
+
+
+/** View Model */
+
+USlotInventoryViewModel* USlotInventoryViewModel::MakeInventoryViewModel(USlotInventoryComponentBase* Inventory)
+{
+    USlotInventoryViewModel* ViewModel = NewObject<USlotInventoryViewModel>();
+    ViewModel->SetInventory(Inventory);
+    return ViewModel;
+}
+
+void USlotInventoryViewModel::BeginDestroy()
+{
+    UnbindInventory();
+    Super::BeginDestroy();
+}
+
+void USlotInventoryViewModel::SetInventory(USlotInventoryComponentBase* NewInventory)
+{
+    if (Inventory.Get() == NewInventory)
+        return;
+
+    UnbindInventory();
+
+    if (IsValid(NewInventory))
+    {
+        Inventory = NewInventory;
+
+        /** The view only opens with the first bound list view */
+        if (!BoundListViews.IsEmpty())
+            AcquireInventoryViewLock();
+        SlotsChangedHandle = NewInventory->OnInventorySlotsChanged().AddUObject(this, &ThisClass::OnInventorySlotsChanged);
+        NewInventory->OnInventoryCapacityChanged.AddDynamic(this, &ThisClass::OnInventoryCapacityChanged);
+    }
+
+    SyncItemsWithCapacity();
+
+    /** Every displayed item now shows another inventory */
+    for (USlotInventorySlotViewItem* Item : Items)
+        Item->OnSlotUpdated.Broadcast(Item);
+}
+
+USlotInventoryComponentBase* USlotInventoryViewModel::GetInventory() const
+{
+    return Inventory.Get();
+}
+
+void USlotInventoryViewModel::UnbindInventory()
+{
+    ReleaseInventoryViewLock();
+    if (USlotInventoryComponentBase* PreviousInventory = Inventory.Get())
+    {
+        PreviousInventory->OnInventorySlotsChanged().Remove(SlotsChangedHandle);
+        PreviousInventory->OnInventoryCapacityChanged.RemoveDynamic(this, &ThisClass::OnInventoryCapacityChanged);
+    }
+    Inventory.Reset();
+    SlotsChangedHandle.Reset();
+}
+
+void USlotInventoryViewModel::AcquireInventoryViewLock()
+{
+    USlotInventoryComponentBase* CurrentInventory = Inventory.Get();
+    if (bHoldsViewLock || CurrentInventory == nullptr)
+        return;
+
+    CurrentInventory->AcquireViewLock();
+    bHoldsViewLock = true;
+}
+
+void USlotInventoryViewModel::ReleaseInventoryViewLock()
+{
+    if (!bHoldsViewLock)
+        return;
+
+    if (USlotInventoryComponentBase* CurrentInventory = Inventory.Get())
+        CurrentInventory->ReleaseViewLock();
+    bHoldsViewLock = false;
+}
+
+
+/** Items */
+
+USlotInventorySlotViewItem* USlotInventoryViewModel::GetItemAtIndex(int32 Index) const
+{
+    return Items.IsValidIndex(Index) ? Items[Index].Get() : nullptr;
+}
+
+void USlotInventoryViewModel::BindListView(UListView* ListView)
+{
+    if (!IsValid(ListView))
+        return;
+
+    if (!BoundListViews.Contains(ListView))
+    {
+        BoundListViews.Add(ListView);
+
+        /** A closed widget releases the view lock like an unbound list view */
+        if (UUserWidget* Widget = ListView->GetTypedOuter<UUserWidget>())
+        {
+            Widget->OnNativeDestruct.RemoveAll(this);
+            Widget->OnNativeDestruct.AddUObject(this, &ThisClass::OnListViewWidgetDestructed);
+        }
+    }
+    ListView->SetListItems(Items);
+    AcquireInventoryViewLock();
+}
+
+void USlotInventoryViewModel::UnbindListView(UListView* ListView)
+{
+    BoundListViews.Remove(ListView);
+    BoundListViews.RemoveAll([](const TWeakObjectPtr<UListView>& BoundListView) { return !BoundListView.IsValid(); });
+
+    /** The view is closed once no list view shows it */
+    if (BoundListViews.IsEmpty())
+        ReleaseInventoryViewLock();
+}
+
+void USlotInventoryViewModel::OnListViewWidgetDestructed(UUserWidget* Widget)
+{
+    Widget->OnNativeDestruct.RemoveAll(this);
+
+    TArray<UListView*, TInlineAllocator<4>> ClosedListViews;
+    for (const TWeakObjectPtr<UListView>& BoundListView : BoundListViews)
+    {
+        if (UListView* ListView = BoundListView.Get(); ListView && ListView->IsIn(Widget))
+            ClosedListViews.Add(ListView);
+    }
+    for (UListView* ListView : ClosedListViews)
+        UnbindListView(ListView);
+}
+
+/** Pages */
+
+void USlotInventoryViewModel::SetPageSize(int32 NewPageSize)
+{
+    NewPageSize = FMath::Max(NewPageSize, 0);
+    if (NewPageSize == PageSize)
+        return;
+
+    /** Stay on the page showing the same first slot */
+    const int32 FirstSlotIndex = GetFirstSlotIndex();
+    PageSize = NewPageSize;
+    Page = PageSize > 0 ? FirstSlotIndex / PageSize : 0;
+    SyncItemsWithCapacity();
+}
+
+void USlotInventoryViewModel::SetPage(int32 NewPage)
+{
+    if (PageSize <= 0 || NewPage == Page)
+        return;
+
+    Page = NewPage;
+    SyncItemsWithCapacity();
+}
+
+int32 USlotInventoryViewModel::GetNumPages() const
+{
+    const USlotInventoryComponentBase* CurrentInventory = Inventory.Get();
+    const int32 Capacity = CurrentInventory ? CurrentInventory->GetContentCapacity() : 0;
+    return PageSize > 0 ? FMath::DivideAndRoundUp(Capacity, PageSize) : 1;
+}
+
+void USlotInventoryViewModel::SyncItemsWithCapacity()
+{
+    const USlotInventoryComponentBase* CurrentInventory = Inventory.Get();
+    const int32 Capacity = CurrentInventory ? CurrentInventory->GetContentCapacity() : 0;
+
+    if (PageSize > 0)
+        Page = FMath::Clamp(Page, 0, FMath::Max(GetNumPages() - 1, 0));
+
+    const int32 FirstSlotIndex = GetFirstSlotIndex();
+    const int32 NumItems = PageSize > 0 ? FMath::Clamp(Capacity - FirstSlotIndex, 0, PageSize) : Capacity;
+    const bool bNumItemsChanged = NumItems != Items.Num();
+
+    /** Items always show consecutive slots, checking the first one is enough */
+    if (!bNumItemsChanged && (Items.IsEmpty() || Items[0]->SlotIndex == FirstSlotIndex))
+        return;
+
+    while (Items.Num() > NumItems)
+        PooledItems.Add(Items.Pop(false));
+
+    Items.Reserve(NumItems);
+    while (Items.Num() < NumItems)
+    {
+        USlotInventorySlotViewItem* Item = !PooledItems.IsEmpty() ? PooledItems.Pop(false).Get() : NewObject<USlotInventorySlotViewItem>(this);
+        Item->SlotIndex = INDEX_NONE;
+        Items.Add(Item);
+    }
+
+    if (bNumItemsChanged)
+    {
+        BoundListViews.RemoveAll([](const TWeakObjectPtr<UListView>& ListView) { return !ListView.IsValid(); });
+        for (const TWeakObjectPtr<UListView>& ListView : BoundListViews)
+            ListView->SetListItems(Items);
+    }
+
+    /** Items of another page, or taken from the pool, now show other slots */
+    for (int32 ItemIndex = 0; ItemIndex < Items.Num(); ItemIndex++)
+    {
+        USlotInventorySlotViewItem* Item = Items[ItemIndex];
+        if (Item->SlotIndex == FirstSlotIndex + ItemIndex)
+            continue;
+
+        Item->SlotIndex = FirstSlotIndex + ItemIndex;
+        if (Item->OnSlotUpdated.IsBound())
+            Item->OnSlotUpdated.Broadcast(Item);
+    }
+
+    if (bNumItemsChanged)
+        OnItemsChanged.Broadcast(this);
+}
+
+void USlotInventoryViewModel::OnInventorySlotsChanged(USlotInventoryComponentBase* SlotInventoryComponent, TConstArrayView<FInventorySlotChange> Changes)
+{
+    SLOTINVENTORY_SCOPE_CYCLE_COUNTER(ViewModelSlotsChanged);
+
+    /** Capacity changes are applied first, a slot update may come before the capacity update */
+    SyncItemsWithCapacity();
+
+    const int32 FirstSlotIndex = GetFirstSlotIndex();
+    for (const FInventorySlotChange& Change : Changes)
+    {
+        const int32 ItemIndex = Change.Index - FirstSlotIndex;
+        if (!Items.IsValidIndex(ItemIndex))
+            continue;
+
+        USlotInventorySlotViewItem* Item = Items[ItemIndex];
+        if (Item->OnSlotUpdated.IsBound())
+            Item->OnSlotUpdated.Broadcast(Item);
+    }
+}
+
+void USlotInventoryViewModel::OnInventoryCapacityChanged(USlotInventoryComponentBase* SlotInventoryComponent, int32 NewCapacity)
+{
+    SyncItemsWithCapacity();
+}
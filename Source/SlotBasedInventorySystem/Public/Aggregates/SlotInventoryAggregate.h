@@ -0,0 +1,102 @@
+// Amasson
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "Structures/SlotInventorySystemStructs.h"
+#include "SlotInventoryAggregate.generated.h"
+
+class USlotInventoryComponentBase;
+
+/**
+ * View of several inventories as a single slot space, without copying their content.
+ * Members are ordered by priority: their slots are laid out one after the other and
+ * items are merged and placed in the first member that can take them.
+ */
+UCLASS(BlueprintType)
+class SLOTBASEDINVENTORYSYSTEM_API USlotInventoryAggregate : public UObject
+{
+	GENERATED_BODY()
+
+public:
+
+	/** Members */
+
+	UFUNCTION(BlueprintCallable, Category = "SlotInventory|Aggregate")
+	static USlotInventoryAggregate* MakeInventoryAggregate(const TArray<USlotInventoryComponentBase*>& Members);
+
+	/** Aggregate the inventories found with GetInventoryComponent for each tag, in the order of the tags */
+	UFUNCTION(BlueprintCallable, Category = "SlotInventory|Aggregate")
+	static USlotInventoryAggregate* MakeInventoryAggregateFromHolder(UObject* Holder, const TArray<FName>& InventoryTags);
+
+	UFUNCTION(BlueprintCallable, Category = "SlotInventory|Aggregate")
+	void SetMembers(const TArray<USlotInventoryComponentBase*>& NewMembers);
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "SlotInventory|Aggregate")
+	TArray<USlotInventoryComponentBase*> GetMembers() const;
+
+
+	/** Slots */
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "SlotInventory|Aggregate|Slot")
+	int32 GetCapacity() const;
+
+	/** Find the member and the index in the member of an aggregated index */
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "SlotInventory|Aggregate|Slot")
+	bool ResolveIndex(int32 Index, USlotInventoryComponentBase*& Member, int32& MemberIndex) const;
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "SlotInventory|Aggregate|Slot")
+	bool GetSlotValueAtIndex(int32 Index, FInventorySlot& SlotValue) const;
+
+
+	/** Queries */
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "SlotInventory|Aggregate|Query")
+	int32 GetItemQuantity(FName Item) const;
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "SlotInventory|Aggregate|Query")
+	int32 GetEmptySlotCount() const;
+
+	/** True if the members hold at least the quantity of each item */
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "SlotInventory|Aggregate|Query")
+	bool ContainsItems(const TMap<FName, int32>& Items) const;
+
+
+	/** Modifications */
+
+	/**
+	 * Add positive quantities and remove negative quantities across all members.
+	 * Every member is planned in a single pass before anything is modified, so with bAllOrNothing
+	 * nothing changes unless the whole modification fits. Each modified member sends one content update.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SlotInventory|Aggregate|Modify")
+	bool ModifyContent(const TMap<FName, int32>& Items, TMap<FName, int32>& Overflows, bool bAllOrNothing = false);
+
+
+private:
+
+	struct FPlannedSlot
+	{
+		int32 MemberIndex;
+		int32 SlotIndex;
+		FName Item;
+		int32 Quantity;
+	};
+
+	struct FPlan
+	{
+		TArray<FPlannedSlot> Slots;
+
+		/** Position in Slots of the planned slots, keyed by member and slot index */
+		TMap<TPair<int32, int32>, int32> SlotLookup;
+	};
+
+	/** Plan one item stack, returns the quantity left */
+	int32 PlanStack(FPlan& Plan, const TArray<USlotInventoryComponentBase*>& ValidMembers, const FName& Item, int32 Quantity) const;
+
+	TArray<USlotInventoryComponentBase*> GetValidMembers() const;
+
+	UPROPERTY()
+	TArray<TWeakObjectPtr<USlotInventoryComponentBase>> Members;
+};
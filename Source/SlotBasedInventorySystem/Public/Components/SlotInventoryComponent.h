@@ -4,8 +4,13 @@
 
 #include "CoreMinimal.h"
 #include "Components/SlotInventoryComponentBase.h"
+#include "Debug/SlotInventoryNetTelemetry.h"
 #include "SlotInventoryComponent.generated.h"
 
+class USlotInventoryComponent;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnServerRequestRejectedSignature, USlotInventoryComponent*, SlotInventoryComponent);
+
 /**
  * 
  */
@@ -19,7 +24,10 @@ public:
 	USlotInventoryComponent();
 
 	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+	virtual bool CallRemoteFunction(UFunction* Function, void* Parameters, FOutParmRec* OutParms, FFrame* Stack) override;
+	virtual void CompactMemory() override;
 
 
 	UFUNCTION(Server, Reliable, BlueprintCallable, Category = "ClientRequest|Update")
@@ -28,6 +36,10 @@ public:
 
 	/** Client Request */
 
+	/** Broadcast on the owning client when the server rejected one of its requests, which changed nothing */
+	UPROPERTY(BlueprintAssignable)
+	FOnServerRequestRejectedSignature OnServerRequestRejected;
+
 	// TODO: Remove requests that should not be triggered by clients
 
 	UFUNCTION(Server, Reliable, BlueprintCallable, Category = "ClientRequest|Content|Capacity")
@@ -61,6 +73,22 @@ public:
 	void Server_RequestRegroupSlotAtIndexWithSimilarIds(int32 Index);
 
 
+	/** Background Maintenance */
+
+	/**
+	 * On the owning client, the view lock is also held on the server while one of its views is open.
+	 * Inventories the client does not own, like a chest, cannot send server RPCs: their views only lock locally.
+	 */
+	virtual void AcquireViewLock() override;
+	virtual void ReleaseViewLock() override;
+
+
+	/** Telemetry */
+
+	/** Null unless `SlotInventory.Telemetry.Enable` was set while this inventory was used */
+	FSlotInventoryNetTelemetry* GetNetTelemetry() const;
+
+
 protected:
 
 
@@ -80,8 +108,54 @@ protected:
 	UFUNCTION()
 	void OnCapacityChanged(USlotInventoryComponentBase* SlotInventoryComponent, int32 NewCapacity);
 
+	/** Capacity and slot values of the same content update, applied in one message. MinCapacity is the lowest capacity since the last update. */
 	UFUNCTION(NetMulticast, Reliable)
-	void NetMulticast_UpdateCapacity(int32 NewCapacity);
+	void NetMulticast_UpdateCapacityAndSlotsValues(int32 MinCapacity, int32 NewCapacity, const TArray<int32>& Indices, const TArray<FInventorySlot>& Values);
+
+	bool bCapacityDirty = false;
+
+
+	/** Net Dormancy */
+
+	/**
+	 * Keep the owner dormant while the content does not change, its dormancy is flushed before each update is sent.
+	 * The whole owner goes dormant: only enable it on actors whose other replicated state rarely changes, like containers.
+	 */
+	UPROPERTY(EditAnywhere, Category = "Replication")
+	bool bUseNetDormancy = false;
+
+	/** Seconds without update before an awake owner goes dormant */
+	UPROPERTY(EditAnywhere, Category = "Replication", meta = (EditCondition = "bUseNetDormancy", ClampMin = 0))
+	float DormancyQuietSeconds = 10.0f;
+
+	virtual void MarkSlotsHaveBeenModified() override;
+
+	/** Flush the dormancy of the owner if it is dormant, so the update sent in the same frame reaches the clients */
+	void WakeFromNetDormancy();
+
+	void ScheduleNetDormancy();
+
+	void OnDormancyQuietPeriodElapsed();
+
+	FTimerHandle DormancyTimerHandle;
+
+
+	/** Background Maintenance */
+
+	/** Sent by the owning client when its first view opens and when its last view closes */
+	UFUNCTION(Server, Reliable)
+	void Server_SetViewLocked(bool bLocked);
+
+	/** Client whose connection owns the owner, the only one whose server RPCs are delivered */
+	bool IsOwnedByLocalClient() const;
+
+	/** Lock held on the server for the views of the owning client */
+	bool bRemoteViewLocked = false;
+
+
+	/** Memory */
+
+	virtual void AccumulateMemoryUsage(FSlotInventoryMemoryUsage& Usage) const override;
 
 
 	/** Content Update */
@@ -90,6 +164,49 @@ protected:
 
 	void BroadcastModifiedSlotsToClients();
 
+	TArray<int32> UpdateIndicesScratch;
+	TArray<FInventorySlot> UpdateValuesScratch;
+
+
+	/** Telemetry */
+
+	FSlotInventoryNetTelemetry* GetOrCreateNetTelemetry();
+
+	void RecordServerRequest(ESlotInventoryServerRequest Request);
+
+	/** Sent by clients with telemetry before each request, the server acknowledges the next request with Sequence */
+	UFUNCTION(Server, Reliable)
+	void Server_TagTelemetryRequest(uint32 Sequence);
+
+	/** Sent after the update caused by the requests, or right after their execution if they changed nothing here */
+	UFUNCTION(Client, Reliable)
+	void Client_AckTelemetryRequests(const TArray<uint32>& Sequences);
+
+	void AcknowledgeTelemetryRequest(uint32 Sequence);
+
+	void SendTelemetryAcks();
+
+	/** Sequence of the next request to execute, 0 if it was not tagged */
+	uint32 TaggedTelemetryRequest = 0;
+
+	/** Executed requests waiting for their update to be sent */
+	TArray<uint32> PendingTelemetryAcks;
+
+
+	/** Request Budget */
+
+	/** Execute a client request now, later or never, depending on the request budget of the owning connection */
+	template<typename FunctionType>
+	void SubmitServerRequest(ESlotInventoryServerRequest Request, int32 WorkSlots, FunctionType&& Execute);
+
+	/** Sent instead of executing a request over budget, TelemetrySequence is its tag or 0 */
+	UFUNCTION(Client, Reliable)
+	void Client_RequestRejected(uint32 TelemetrySequence);
+
+	void RecordSlotsUpdateSent(const TArray<int32>& Indices, const TArray<FInventorySlot>& Values);
+
+	TUniquePtr<FSlotInventoryNetTelemetry> NetTelemetry;
+
 	bool bHasAuthority;
 
 };
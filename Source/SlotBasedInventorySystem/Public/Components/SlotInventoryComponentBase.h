@@ -5,20 +5,33 @@
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
 #include "Structures/SlotInventorySystemStructs.h"
+#include "Structures/InventoryContentSnapshot.h"
+#include "Debug/SlotInventoryMemory.h"
 #include "SlotInventoryComponentBase.generated.h"
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnInventoryCapacityChangedSignature, USlotInventoryComponentBase*, SlotInventoryComponent, int32, NewCapacity);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnInventoryContentChangedSignature, USlotInventoryComponentBase*, SlotInventoryComponent, const TArray<int32>&, ChangedSlots);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_TwoParams(FOnInventorySlotsEvictedSignature, USlotInventoryComponentBase*, SlotInventoryComponent, const TArray<int32>&, EvictedSlots);
+DECLARE_MULTICAST_DELEGATE_TwoParams(FOnInventorySlotsChangedNative, USlotInventoryComponentBase*, TConstArrayView<FInventorySlotChange>);
 
 UCLASS( Blueprintable, ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
 class SLOTBASEDINVENTORYSYSTEM_API USlotInventoryComponentBase : public UActorComponent
 {
 	GENERATED_BODY()
 
+	friend class USlotInventoryAggregate;
+	friend class FSlotInventoryTransaction;
+
 public:
 
 	USlotInventoryComponentBase();
 
+	virtual void OnRegister() override;
+	virtual void Serialize(FArchive& Ar) override;
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+	virtual void GetResourceSizeEx(FResourceSizeEx& CumulativeResourceSize) override;
+
 	/**
 	 * The purpose of the tick function is to trigger an update broadcast only once.
 	 * We can use MarkDirtySlot multiple times in a same tick but they will
@@ -26,12 +39,30 @@ public:
 	*/
 	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
 
+	/** Broadcast the pending content update now instead of on the next tick, see FSlotInventoryBatchEditScope */
+	void FlushContentUpdate();
+
 	UPROPERTY(BlueprintAssignable)
 	FOnInventoryCapacityChangedSignature OnInventoryCapacityChanged;
 
+	/** Slots modified since the last content update, always below the capacity so they can index GetContent */
 	UPROPERTY(BlueprintAssignable)
 	FOnInventoryContentChangedSignature OnInventoryContentChanged;
 
+	/** Non empty slots removed by a shrink since the last content update, broadcast after OnInventoryContentChanged */
+	UPROPERTY(BlueprintAssignable)
+	FOnInventorySlotsEvictedSignature OnInventorySlotsEvicted;
+
+	/**
+	 * Native counterpart of OnInventoryContentChanged, giving the previous and new value of each changed slot.
+	 * Broadcasting does not allocate. Previous values are tracked from the first call.
+	 */
+	FOnInventorySlotsChangedNative& OnInventorySlotsChanged();
+
+	/** Tag of this inventory on its owner, the registry key used by GetInventoryComponent */
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Content")
+	FName GetInventoryTag() const;
+
 
 	/** Content Management */
 
@@ -47,6 +78,17 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Content|Capacity")
 	void SetContentCapacity(int32 NewCapacity);
 
+	/** Set the capacity and get the non empty slots removed by a shrink */
+	UFUNCTION(BlueprintCallable, Category = "Content|Capacity")
+	void SetContentCapacityWithEvictions(int32 NewCapacity, TArray<int32>& EvictedIndices, TArray<FInventorySlot>& EvictedSlots);
+
+	UFUNCTION(BlueprintCallable, Category = "Content|Capacity")
+	bool IsContentSparse() const;
+
+	/** Switch the storage of the content, slot values and indices are kept */
+	UFUNCTION(BlueprintCallable, Category = "Content|Capacity")
+	void SetContentSparse(bool bNewSparse);
+
 
 	/** Slot Management */
 
@@ -86,24 +128,156 @@ public:
 	UFUNCTION(BlueprintCallable, Category = "Content|Action")
 	bool DropSlotTowardOtherInventory(int32 SourceIndex, USlotInventoryComponentBase* Destination);
 
+	/** Drop at most MaxAmount of the slot anywhere in Destination, 0 drops the whole slot */
+	UFUNCTION(BlueprintCallable, Category = "Content|Action")
+	bool DropSlotAmountTowardOtherInventory(int32 SourceIndex, USlotInventoryComponentBase* Destination, int32 MaxAmount);
+
 	UFUNCTION(BlueprintCallable, Category = "Content|Action")
 	bool RegroupSimilarItemsAtIndex(int32 Index);
 
 
+	/** Bulk Operations */
+
+	using FParallelContentOperation = TFunctionRef<bool(int32 InventoryIndex, FInventoryContent& Content, FInventoryContent::FContentModifications& OutModifications)>;
+
+	/**
+	 * Run an operation on the content of many inventories in parallel.
+	 * The operation must only touch the content it receives, it runs on worker threads.
+	 * Modified slots are marked dirty back on the game thread once every inventory is done.
+	 * Returns the number of modified inventories.
+	 */
+	static int32 ParallelModifyContents(TConstArrayView<USlotInventoryComponentBase*> Inventories, FParallelContentOperation Operation);
+
+	/** ModifyContent on every inventory, in parallel. Overflows are discarded. Returns the number of modified inventories. */
+	UFUNCTION(BlueprintCallable, Category = "Content|Modify|Bulk")
+	static int32 BulkModifyContent(const TArray<USlotInventoryComponentBase*>& Inventories, const TMap<FName, int32>& Items);
+
+	/** Clear every slot holding Item in every inventory, in parallel. Returns the number of modified inventories. */
+	UFUNCTION(BlueprintCallable, Category = "Content|Modify|Bulk")
+	static int32 BulkRemoveItem(const TArray<USlotInventoryComponentBase*>& Inventories, FName Item);
+
+
+	/** Persistence */
+
+	/** Incremented every time a slot is marked dirty or the capacity changes */
+	uint32 GetContentRevision() const;
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Content|Persistence")
+	bool HasUnsavedChanges() const;
+
+	/** The content at SavedRevision has been persisted */
+	void MarkContentSaved(uint32 SavedRevision);
+
+	/** Remember the slots modified since the last TakeUnsavedSlots, see FSlotInventoryDeltaLog */
+	void SetTrackUnsavedSlots(bool bTrack);
+
+	/**
+	 * Slots modified since the last call, and the lowest capacity since then or INDEX_NONE if it did not change.
+	 * Slots between the lowest and the current capacity were emptied by a shrink. Tracking restarts from the current content.
+	 */
+	void TakeUnsavedSlots(TSet<int32>& OutSlots, int32& OutMinCapacity);
+
+
+	/** Snapshots */
+
+	/**
+	 * Channel to read the content from any thread without locks.
+	 * A snapshot is published after every content update once this has been called on the game thread.
+	 */
+	TSharedRef<FInventoryContentSnapshotChannel, ESPMode::ThreadSafe> GetSnapshotChannel();
+
+
+	/** Memory */
+
+	FSlotInventoryMemoryUsage GetMemoryUsage() const;
+
+	/** Release the memory kept for reuse: array slack, emptied modifiers and sparse pages, tracking buffers */
+	UFUNCTION(BlueprintCallable, Category = "Content|Memory")
+	virtual void CompactMemory();
+
+	/** Not modified for IdleSeconds and modified since the last compaction */
+	bool ShouldCompactMemory(double IdleSeconds) const;
+
+
+	/** Hydration */
+
+	/** False while the content only exists as DehydratedContent or LootSeed */
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Content|Hydration")
+	bool IsContentHydrated() const;
+
+	/** Deserialize or generate the content if needed. Every content access goes through it. Game thread only. */
+	void EnsureContentHydrated() const;
+
+	/** Serialize the content and release it until the next access. Returns false if it cannot be done now. */
+	UFUNCTION(BlueprintCallable, Category = "Content|Hydration")
+	bool DehydrateContent();
+
+	/** Lazy inventory not accessed for DehydrateIdleSeconds */
+	bool ShouldDehydrateContent() const;
+
+	/** Content in the FSlotInventoryAsyncSave format while dehydrated, empty otherwise */
+	const TArray<uint8>& GetDehydratedContent() const;
+
+
+	/** Background Maintenance */
+
+	/** Keep the background maintenance from moving slots while a player looks at this inventory. Locks are counted. */
+	UFUNCTION(BlueprintCallable, Category = "Content|Maintenance")
+	virtual void AcquireViewLock();
+
+	UFUNCTION(BlueprintCallable, Category = "Content|Maintenance")
+	virtual void ReleaseViewLock();
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "Content|Maintenance")
+	bool IsViewLocked() const;
+
+	/** Run maintenance steps until EndSeconds. Returns true once there is nothing left to do until the next modification. */
+	bool RunBackgroundMaintenance(double EndSeconds);
+
+
 protected:
 
+	/** Memory */
+
+	virtual void AccumulateMemoryUsage(FSlotInventoryMemoryUsage& Usage) const;
+
+
+	/** Hydration */
+
+	/**
+	 * Fill the content of a lazy inventory with an empty content and a LootSeed, on first access.
+	 * Must give the same content for the same seed, clients generate it as well.
+	 */
+	UFUNCTION(BlueprintNativeEvent, Category = "Content|Hydration")
+	void GenerateLazyContent(int32 Seed, FInventoryContent& OutContent);
+
+	void HydrateContent();
+
+
+	/** Background Maintenance */
+
+	/** Queue this inventory in the subsystem if it has maintenance to do */
+	void QueueBackgroundMaintenance();
+
+
 	/** Content Management */
 
-	const TMap<FName, int32> GetMaxStackSizesFromIds(const TMap<FName, int32>& IdsAndCounts) const; // TODO: Remove when IInventoryRule
+	FInventoryContent::FMaxStackSizes GetMaxStackSizesFromIds(const TMap<FName, int32>& IdsAndCounts) const; // TODO: Remove when IInventoryRule
 
 
 	/** Slot Updating */
 
 	virtual void BroadcastContentUpdate();
 
+	void BroadcastSlotChanges();
+
+	/** Start the slot change tracking from the current content */
+	void ResetBroadcastSlotValues();
+
 	void MarkDirtySlot(int32 SlotIndex);
 
-	void MarkSlotsHaveBeenModified();
+	/** Schedule a content update for the next tick, or for the end of the current batch edit */
+	virtual void MarkSlotsHaveBeenModified();
 
 
 protected:
@@ -111,6 +285,115 @@ protected:
 	UPROPERTY(EditAnywhere, Category = "Content", meta = (AllowPrivateAccess = true))
 	FInventoryContent Content;
 
+	/**
+	 * Store the slots in pages allocated on first write. Memory, save size and scans
+	 * then scale with the occupied slots instead of the capacity.
+	 * Only applied in game worlds, the content stays dense and editable in the editor.
+	 */
+	UPROPERTY(EditAnywhere, Category = "Content")
+	bool bSparseContent = false;
+
+	/** Should match the tag the owner resolves to this inventory in IInventoryHolderInterface */
+	UPROPERTY(EditAnywhere, Category = "Content")
+	FName InventoryTag;
+
+	/**
+	 * Keep the content serialized until its first access. Cooked levels only store the serialized content,
+	 * the slots and modifier structs of containers nobody opens are never loaded.
+	 */
+	UPROPERTY(EditAnywhere, Category = "Content|Hydration")
+	bool bLazyContent = false;
+
+	/** Given to GenerateLazyContent when the content is left empty, 0 to not generate */
+	UPROPERTY(EditAnywhere, Category = "Content|Hydration", meta = (EditCondition = "bLazyContent"))
+	int32 LootSeed = 0;
+
+	/** Dehydrate again after this many seconds without access, 0 to keep the content once hydrated */
+	UPROPERTY(EditAnywhere, Category = "Content|Hydration", meta = (EditCondition = "bLazyContent", ClampMin = 0))
+	float DehydrateIdleSeconds = 0.0f;
+
+	/** Only filled while dehydrated, and in cooked data */
+	UPROPERTY()
+	TArray<uint8> DehydratedContent;
+
+	bool bContentHydrated = true;
+
+	bool bHydrationInitialized = false;
+
+	/** FApp::GetCurrentTime of the last content access */
+	mutable double LastContentAccessTime = 0.0;
+
+	/**
+	 * Merge the partial stacks of a same item in the background, a few slots per frame within SlotInventory.Maintenance.BudgetUs.
+	 * Only runs where the owner has authority, and never while a view lock is held.
+	 */
+	UPROPERTY(EditAnywhere, Category = "Content|Maintenance")
+	bool bBackgroundAutoStack = false;
+
+	/** Also move the stacks toward the first slots once they are merged */
+	UPROPERTY(EditAnywhere, Category = "Content|Maintenance", meta = (EditCondition = "bBackgroundAutoStack"))
+	bool bBackgroundCompactToFront = false;
+
 	TSet<int32> DirtySlots;
 
+	uint32 ContentRevision = 0;
+
+	uint32 SavedContentRevision = 0;
+
+	bool bTrackUnsavedSlots = false;
+
+	/** Lowest capacity since the last delta save, INDEX_NONE if it did not change */
+	int32 UnsavedMinCapacity = INDEX_NONE;
+
+	/** Slots modified since the last delta save, only while tracking unsaved slots */
+	TSet<int32> UnsavedSlots;
+
+	TSharedPtr<FInventoryContentSnapshotChannel, ESPMode::ThreadSafe> SnapshotChannel;
+
+	FOnInventorySlotsChangedNative OnInventorySlotsChangedNative;
+
+	bool bTrackSlotChanges = false;
+
+	/** Item and quantity of each slot as of the last content update, indexed by slot, only while tracking slot changes */
+	TArray<TPair<FName, int32>> BroadcastSlotValues;
+
+	int32 BroadcastCapacity = 0;
+
+	/** Lowest capacity since the last content update, INDEX_NONE if it did not change. A shrink then grow empties the slots in between. */
+	int32 MinCapacitySinceUpdate = INDEX_NONE;
+
+	/**
+	 * Non empty slots removed by a shrink since the last content update. Those still at or above the capacity
+	 * are reported by OnInventorySlotsEvicted, those a grow brought back as empty by OnInventoryContentChanged.
+	 */
+	TSet<int32> EvictedSlotsSinceUpdate;
+
+	/** Platform seconds of the last content update */
+	double LastContentUpdateSeconds = 0.0;
+
+	uint32 CompactedContentRevision = 0;
+
+	int32 ViewLockCount = 0;
+
+	bool bMaintenanceQueued = false;
+
+	/** Merging, then compacting toward the front */
+	bool bMaintenanceCompacting = false;
+
+	/** Slots before the cursor are maintained */
+	int32 MaintenanceCursor = 0;
+
+	/** Scan position of the compaction, after the cursor */
+	int32 MaintenanceReadCursor = 0;
+
+	/** Revision after the last maintenance step, another value means the content was modified in between */
+	uint32 MaintenanceStepRevision = MAX_uint32;
+
+	uint32 MaintainedContentRevision = MAX_uint32;
+
+	/** Reused between content updates */
+	TArray<FInventorySlotChange> SlotChanges;
+	TArray<int32> ChangedSlotsScratch;
+	TArray<int32> EvictedSlotsScratch;
+
 };
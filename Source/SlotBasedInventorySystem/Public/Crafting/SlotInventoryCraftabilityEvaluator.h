@@ -0,0 +1,103 @@
+// Amasson
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Structures/SlotInventorySystemStructs.h"
+#include "SlotInventoryCraftabilityEvaluator.generated.h"
+
+USTRUCT(BlueprintType)
+struct SLOTBASEDINVENTORYSYSTEM_API FSlotInventoryRecipe
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Recipe")
+	FName Name;
+
+	/** Quantity of each item consumed by one craft */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Recipe")
+	TMap<FName, int32> Ingredients;
+};
+
+/**
+ * Evaluates how many times each recipe of a list can be crafted with the items of one or more contents.
+ *
+ * Recipes are compiled into a dense matrix with one row per recipe and one column per ingredient item.
+ * Sources only have to be scanned once, then kept up to date with the changed slots of OnInventoryContentChanged,
+ * and only the recipes using an item whose count changed are evaluated again.
+ */
+class SLOTBASEDINVENTORYSYSTEM_API FSlotInventoryCraftabilityEvaluator
+{
+public:
+
+	/** Recipes */
+
+	void Compile(TConstArrayView<FSlotInventoryRecipe> Recipes);
+
+	int32 GetNumRecipes() const;
+
+
+	/** Sources */
+
+	/** Count the items of a content. Returns the id of the source. */
+	int32 AddSource(const FInventoryContent& Content);
+
+	/** Count again the changed slots of a source */
+	void UpdateSourceSlots(int32 SourceId, const FInventoryContent& Content, TConstArrayView<int32> ChangedSlots);
+
+	/** Count again every slot of a source */
+	void RefreshSource(int32 SourceId, const FInventoryContent& Content);
+
+	void RemoveAllSources();
+
+	/** Total quantity of an item in all sources, only tracked for recipe ingredients */
+	int64 GetIngredientQuantity(const FName& Item) const;
+
+
+	/** Evaluation */
+
+	/** Evaluate every recipe. Returns the number of times each recipe can be crafted. */
+	const TArray<int32>& Evaluate();
+
+	/** Evaluate only the recipes using an ingredient whose quantity changed since the last evaluation */
+	const TArray<int32>& EvaluateChanged(TArray<int32>* OutChangedRecipes = nullptr);
+
+	const TArray<int32>& GetCraftableCounts() const;
+
+private:
+
+	void SetSlotContribution(int32 SourceId, int32 SlotIndex, const FInventorySlot* Slot);
+
+	void AddToColumn(int32 Column, int64 Quantity);
+
+	int32 EvaluateRecipe(int32 RecipeIndex) const;
+
+	/** Number of columns, padded to a whole number of vector registers */
+	int32 NumColumns = 0;
+
+	TMap<FName, int32> ItemColumns;
+
+	/** NumRecipes x NumColumns quantities needed, 0 when the item is not an ingredient */
+	TArray<double> Needs;
+
+	/** Recipes using each column */
+	TArray<TArray<int32>> RecipesByColumn;
+
+	TArray<int64> Quantities;
+
+	/** Quantities plus one half, so that floor(Quantity / Need) is exact and non ingredients divide to infinity */
+	TArray<double> EvaluatedQuantities;
+
+	TBitArray<> ChangedColumns;
+
+	TArray<int32> CraftableCounts;
+
+	struct FSource
+	{
+		/** Column and quantity counted for each slot, INDEX_NONE when the slot holds no ingredient */
+		TArray<int32> SlotColumns;
+		TArray<int32> SlotQuantities;
+	};
+
+	TArray<FSource> Sources;
+};
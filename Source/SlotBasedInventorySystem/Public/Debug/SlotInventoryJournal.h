@@ -0,0 +1,177 @@
+// Amasson
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/ObjectKey.h"
+#include "Structures/SlotInventorySystemStructs.h"
+
+class USlotInventoryComponentBase;
+
+/** Records of a journal */
+enum class ESlotInventoryJournalOp : uint8
+{
+	/** Full content of an inventory, written before its first operation in each segment */
+	Snapshot,
+	/** Content hash of an inventory at this point */
+	StateHash,
+
+	SetCapacity,
+	SetSlot,
+	ClearSlot,
+	ModifySlotQuantity,
+	AddModifier,
+	ModifyContent,
+	TryModifyContent,
+	DropSlotAtIndex,
+	DropSlot,
+	RegroupSimilarItems,
+	/** DropSlot of part of the slot */
+	DropSlotAmount,
+
+	Count
+};
+
+SLOTBASEDINVENTORYSYSTEM_API const TCHAR* LexToString(ESlotInventoryJournalOp Op);
+
+/**
+ * Binary journal of the mutations of inventory components, with their inputs and rules.
+ * Stack sizes are resolved while recording so a journal replays without the components.
+ *
+ * Records are written in segments. Each segment snapshots the inventories it touches,
+ * so the oldest segments can be dropped to keep the journal within its size, like a ring buffer.
+ * Mutations that bypass the component functions (transactions, aggregates, bulk operations)
+ * are recorded as the resulting slot values.
+ */
+class SLOTBASEDINVENTORYSYSTEM_API FSlotInventoryJournal
+{
+public:
+
+	static constexpr uint32 FileMagic = 0x4A495353; // SSIJ
+	static constexpr uint32 FileVersion = 1;
+
+	/** Journal being recorded, null when not recording. Game thread only. */
+	static FSlotInventoryJournal* GetRecording();
+
+	static void StartRecording(int64 MaxBytes);
+
+	static void StopRecording();
+
+	/** Storage independent hash of the capacity and the non empty slots */
+	static uint32 HashContent(const FInventoryContent& Content);
+
+
+	/** Recording, before the operation is applied */
+
+	void RecordSetCapacity(USlotInventoryComponentBase* Inventory, int32 NewCapacity);
+	void RecordSetSlot(USlotInventoryComponentBase* Inventory, int32 Index, const FInventorySlot& Value);
+	void RecordClearSlot(USlotInventoryComponentBase* Inventory, int32 Index);
+	void RecordModifySlotQuantity(USlotInventoryComponentBase* Inventory, int32 Index, int32 ModifyAmount, bool bAllOrNothing);
+	void RecordAddModifier(USlotInventoryComponentBase* Inventory, int32 Index, const FItemModifier& Modifier);
+	void RecordModifyContent(USlotInventoryComponentBase* Inventory, const TMap<FName, int32>& Items, bool bWithoutOverflow);
+	void RecordDropSlotAtIndex(USlotInventoryComponentBase* Source, int32 SourceIndex, USlotInventoryComponentBase* Destination, int32 DestinationIndex, int32 MaxAmount);
+	void RecordDropSlot(USlotInventoryComponentBase* Source, int32 SourceIndex, USlotInventoryComponentBase* Destination, int32 MaxAmount = 0);
+	void RecordRegroupSimilarItems(USlotInventoryComponentBase* Inventory, int32 Index);
+
+	/** Recording, after the slots have been written directly */
+
+	void RecordSlotValues(USlotInventoryComponentBase* Inventory, TConstArrayView<int32> Indices);
+
+
+	/** Write the retained segments followed by the current hash of every recorded inventory */
+	bool SaveToFile(const FString& FilePath) const;
+
+	int64 GetRecordedBytes() const;
+
+	int32 GetNumRecords() const { return NumRecords; }
+
+
+private:
+
+	explicit FSlotInventoryJournal(int64 InMaxBytes);
+
+	struct FSegment
+	{
+		TArray<uint8> Bytes;
+
+		/** Names are written once per segment, then by index */
+		TMap<FName, int32> NameIndices;
+
+		TSet<uint32> SnapshotInventories;
+	};
+
+	/** Append a record to the current segment, snapshotting the inventories first seen in it */
+	template<typename FunctionType>
+	void Record(ESlotInventoryJournalOp Op, USlotInventoryComponentBase* Inventory, USlotInventoryComponentBase* OtherInventory, FunctionType&& WritePayload);
+
+	FSegment& GetRecordSegment();
+
+	uint32 GetInventoryId(USlotInventoryComponentBase* Inventory);
+
+	void EnsureSnapshot(FSegment& Segment, USlotInventoryComponentBase* Inventory, uint32 InventoryId);
+
+	int64 MaxBytes = 0;
+
+	int64 SegmentBytes = 0;
+
+	int32 NumRecords = 0;
+
+	TArray<FSegment> Segments;
+
+	TMap<TObjectKey<USlotInventoryComponentBase>, uint32> InventoryIds;
+
+	TArray<TWeakObjectPtr<USlotInventoryComponentBase>> Inventories;
+};
+
+
+/** Timings of one operation type during a replay */
+struct SLOTBASEDINVENTORYSYSTEM_API FSlotInventoryReplayOpStats
+{
+	int32 Count = 0;
+	double TotalSeconds = 0.0;
+	double MaxSeconds = 0.0;
+};
+
+struct SLOTBASEDINVENTORYSYSTEM_API FSlotInventoryReplayReport
+{
+	int32 NumOperations = 0;
+	int32 NumHashChecks = 0;
+
+	/** Hash checks that failed, with the inventory name and the record number */
+	TArray<FString> Mismatches;
+
+	FSlotInventoryReplayOpStats OpStats[(int32)ESlotInventoryJournalOp::Count];
+
+	double TotalSeconds = 0.0;
+
+	bool Succeeded() const { return Mismatches.IsEmpty(); }
+
+	void Log(FOutputDevice& Ar) const;
+};
+
+/**
+ * Re-executes a saved journal against plain FInventoryContent, without world or components.
+ * Snapshots met again after the first one, and the final hashes, are checked against the replayed state.
+ */
+class SLOTBASEDINVENTORYSYSTEM_API FSlotInventoryJournalReplayer
+{
+public:
+
+	bool LoadFromFile(const FString& FilePath);
+
+	/** Replay the whole journal from its first snapshots. Can be called several times to benchmark. */
+	FSlotInventoryReplayReport Replay() const;
+
+	int32 GetNumSegments() const { return Segments.Num(); }
+
+
+private:
+
+	struct FReplayState;
+
+	void ReplaySegment(const TArray<uint8>& Bytes, FReplayState& State, FSlotInventoryReplayReport& Report) const;
+
+	TArray<TArray<uint8>> Segments;
+
+	TArray<uint8> FinalHashes;
+};
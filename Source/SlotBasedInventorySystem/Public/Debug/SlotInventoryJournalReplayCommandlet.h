@@ -0,0 +1,23 @@
+// Amasson
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "SlotInventoryJournalReplayCommandlet.generated.h"
+
+/**
+ * Replays an inventory journal without loading a map, for regression runs and benchmarks.
+ * Usage: -run=SlotInventoryJournalReplay -Journal=<File> [-Iterations=<Count>]
+ * Returns 1 when a state hash does not match.
+ */
+UCLASS()
+class SLOTBASEDINVENTORYSYSTEM_API USlotInventoryJournalReplayCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual int32 Main(const FString& Params) override;
+
+};
@@ -0,0 +1,213 @@
+// Amasson
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Engine/EngineBaseTypes.h"
+#include "UObject/ObjectKey.h"
+#include "Debug/SlotInventoryNetTelemetry.h"
+#include "SlotInventoryLoadTest.generated.h"
+
+class AController;
+class AGameModeBase;
+class APlayerController;
+class UNetDriver;
+class USlotInventoryComponent;
+
+/** Actions of the simulated players, each one sends the server requests of a player doing it in the UI */
+enum class ESlotInventoryLoadTestAction : uint8
+{
+	/** Move a stack inside the own inventory or into a container */
+	DragDrop,
+	/** Take every stack of a container */
+	LootAll,
+	RegroupSlot,
+	/** Give a stack to another player */
+	Trade,
+
+	Count
+};
+
+SLOTBASEDINVENTORYSYSTEM_API const TCHAR* LexToString(ESlotInventoryLoadTestAction Action);
+
+/** Read from the command line, see USlotInventoryLoadTestSubsystem */
+struct SLOTBASEDINVENTORYSYSTEM_API FSlotInventoryLoadTestSettings
+{
+	/** Seconds before the process writes its report and exits, 0 to run until stopped */
+	double DurationSeconds = 0.0;
+
+	int32 NumContainers = 32;
+	int32 ContainerCapacity = 24;
+	int32 PlayerCapacity = 40;
+	int32 NumItemTypes = 16;
+
+	/** Actions per second of each simulated player */
+	float ActionsPerSecond = 2.0f;
+
+	/** Relative weight of each action, -LoadTestMix=DragDrop:4,LootAll:1,RegroupSlot:2,Trade:1 */
+	float ActionWeights[(int32)ESlotInventoryLoadTestAction::Count] = { 4.0f, 1.0f, 2.0f, 1.0f };
+
+	void ParseCommandLine(const TCHAR* CommandLine);
+};
+
+
+/** Inventory of the load test: a container, or the inventory of a connected player owned by its controller */
+UCLASS(NotPlaceable, Transient)
+class SLOTBASEDINVENTORYSYSTEM_API ASlotInventoryLoadTestActor : public AActor
+{
+	GENERATED_BODY()
+
+	friend class USlotInventoryLoadTestSubsystem;
+
+public:
+
+	ASlotInventoryLoadTestActor();
+
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+	USlotInventoryComponent* GetInventory() const { return Inventory; }
+
+	bool IsContainer() const { return bContainer; }
+
+
+protected:
+
+	UPROPERTY(VisibleAnywhere, Category = "Inventory")
+	TObjectPtr<USlotInventoryComponent> Inventory;
+
+	UPROPERTY(Replicated)
+	bool bContainer = false;
+
+};
+
+
+/**
+ * Inventory load test driver, only created in game worlds when the command line has -SlotInventoryLoadTest.
+ * It needs no dedicated map: run a dedicated server and headless clients over loopback on the same machine.
+ *
+ *   Server: <Project> <Map> -server -SlotInventoryLoadTest [-LoadTestDuration=300] [-LoadTestContainers=32]
+ *   Client: <Project> 127.0.0.1 -game -nullrhi -nosound -SlotInventoryLoadTest [-LoadTestRate=2] [-LoadTestMix=...]
+ *
+ * The server spawns the containers and an inventory for every player that logs in. Every client is a simulated player
+ * sending the requests of the action mix through the server RPCs of USlotInventoryComponent.
+ * Telemetry is enabled in every process. Clients regularly write their request latency histogram to
+ * Saved/Profiling/SlotInventory. The server report contains the frame cost, the request counts, the bytes per second
+ * of each client connection, and the latency percentiles merged from the client files.
+ */
+UCLASS()
+class SLOTBASEDINVENTORYSYSTEM_API USlotInventoryLoadTestSubsystem : public UTickableWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	static bool IsLoadTestEnabled();
+
+	virtual bool ShouldCreateSubsystem(UObject* Outer) const override;
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+	virtual void OnWorldBeginPlay(UWorld& InWorld) override;
+	virtual void Tick(float DeltaTime) override;
+	virtual TStatId GetStatId() const override;
+
+	/** Server: summary of the run. Client: the latency of its requests. Also written as csv to Saved/Profiling/SlotInventory. */
+	void WriteReport(FOutputDevice& Ar);
+
+
+protected:
+
+	/** Server */
+
+	void OnGameModePostLogin(AGameModeBase* GameMode, APlayerController* NewPlayer);
+	void OnGameModeLogout(AGameModeBase* GameMode, AController* Exiting);
+
+	ASlotInventoryLoadTestActor* SpawnInventory(AActor* Owner, bool bContainer, int32 Capacity);
+
+	/** Put random stacks in the empty slots until FillRatio of the slots are used */
+	void FillInventory(USlotInventoryComponent* Inventory, float FillRatio);
+
+	/** Looting empties the containers, refill the ones running low */
+	void RefillContainers();
+
+	void SampleConnections();
+
+	void OnWorldTickStart(UWorld* InWorld, ELevelTick TickType, float DeltaSeconds);
+	void OnEndFrame();
+
+	void WriteServerReport(TArray<FString>& Lines);
+
+	UPROPERTY()
+	TArray<TObjectPtr<ASlotInventoryLoadTestActor>> Containers;
+
+	TMap<TObjectKey<APlayerController>, TObjectPtr<ASlotInventoryLoadTestActor>> PlayerInventories;
+
+	struct FConnectionStats
+	{
+		uint64 TotalOutBytesPerSecond = 0;
+		uint64 TotalInBytesPerSecond = 0;
+		int32 MaxOutBytesPerSecond = 0;
+		int32 NumSamples = 0;
+	};
+
+	/** Keyed by remote address */
+	TMap<FString, FConnectionStats> ConnectionStats;
+
+	/** Game thread milliseconds from the world tick start to the end of the frame, net flush included */
+	TArray<float> FrameCostsMs;
+
+	double FrameStartSeconds = 0.0;
+
+	int32 MaxPlayers = 0;
+
+	FDelegateHandle PostLoginHandle;
+	FDelegateHandle LogoutHandle;
+	FDelegateHandle WorldTickStartHandle;
+	FDelegateHandle EndFrameHandle;
+
+
+	/** Client */
+
+	void RefreshClientTargets();
+
+	void RunAction(ESlotInventoryLoadTestAction Action);
+
+	ESlotInventoryLoadTestAction PickAction();
+
+	/** Random non empty slot of an inventory as replicated to this client, INDEX_NONE if there is none */
+	int32 PickStoredSlot(const USlotInventoryComponent* Inventory);
+
+	void WriteClientLatency() const;
+
+	FString GetClientLatencyFilePath() const;
+
+	void OnNetworkFailure(UWorld* InWorld, UNetDriver* NetDriver, ENetworkFailure::Type FailureType, const FString& ErrorString);
+
+	TWeakObjectPtr<ASlotInventoryLoadTestActor> OwnInventory;
+
+	TArray<TWeakObjectPtr<ASlotInventoryLoadTestActor>> TargetContainers;
+
+	TArray<TWeakObjectPtr<ASlotInventoryLoadTestActor>> TradePartners;
+
+	float PendingActions = 0.0f;
+
+	uint32 ActionCounts[(int32)ESlotInventoryLoadTestAction::Count] = {};
+
+	FDelegateHandle NetworkFailureHandle;
+
+
+	FSlotInventoryLoadTestSettings Settings;
+
+	FRandomStream Random;
+
+	double StartSeconds = 0.0;
+
+	/** Client latency files older than the start of the run are ignored */
+	FDateTime StartDateTime;
+
+	double NextSampleSeconds = 0.0;
+
+	bool bFinished = false;
+
+};
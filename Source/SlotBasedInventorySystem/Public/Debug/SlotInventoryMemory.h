@@ -0,0 +1,31 @@
+// Amasson
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+/** Heap memory owned by an inventory, in bytes */
+struct SLOTBASEDINVENTORYSYSTEM_API FSlotInventoryMemoryUsage
+{
+	/** Slot arrays or pages */
+	SIZE_T Slots = 0;
+
+	/** Modifier arrays of the slots */
+	SIZE_T Modifiers = 0;
+
+	/** Structures held by the FInstancedStruct of the modifiers */
+	SIZE_T ModifierPayloads = 0;
+
+	/** Dirty slots, change tracking and replication scratch buffers */
+	SIZE_T Tracking = 0;
+
+	/** Serialized content of a dehydrated inventory */
+	SIZE_T Dehydrated = 0;
+
+	/** Part of the above that is allocated but not used, released by compaction */
+	SIZE_T Slack = 0;
+
+	SIZE_T GetTotal() const { return Slots + Modifiers + ModifierPayloads + Tracking + Dehydrated; }
+
+	FSlotInventoryMemoryUsage& operator+=(const FSlotInventoryMemoryUsage& Other);
+};
@@ -0,0 +1,120 @@
+// Amasson
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+struct FInventorySlot;
+
+/** Server requests that can be sent by clients to a USlotInventoryComponent */
+enum class ESlotInventoryServerRequest : uint8
+{
+	BroadcastFullInventory,
+	SetContentCapacity,
+	SetSlotValueAtIndex,
+	ClearSlotAtIndex,
+	DropSlotTowardOtherInventoryAtIndex,
+	DropSlotTowardOtherInventory,
+	DropSlotFromOtherInventoryAtIndex,
+	DropSlotFromOtherInventory,
+	RegroupSlotAtIndexWithSimilarIds,
+
+	Count
+};
+
+SLOTBASEDINVENTORYSYSTEM_API const TCHAR* LexToString(ESlotInventoryServerRequest Request);
+
+/** Fixed buckets histogram of request to acknowledgement latencies */
+struct SLOTBASEDINVENTORYSYSTEM_API FSlotInventoryLatencyHistogram
+{
+	static constexpr int32 NumBuckets = 12;
+
+	/** Upper bound in milliseconds of each bucket, the last one is unbounded */
+	static const double BucketUpperBoundsMs[NumBuckets];
+
+	void AddSample(double LatencyMs);
+
+	/** Add the samples of another histogram, to aggregate several inventories or processes */
+	void Merge(const FSlotInventoryLatencyHistogram& Other);
+
+	void Reset();
+
+	/** Approximated from the buckets, returns the upper bound of the bucket containing the percentile */
+	double GetPercentileMs(double Percentile) const;
+
+	double GetAverageMs() const;
+
+	uint32 Buckets[NumBuckets] = {};
+	uint32 NumSamples = 0;
+	double TotalMs = 0.0;
+	double MaxMs = 0.0;
+};
+
+/**
+ * Replication telemetry of one inventory component.
+ * Only allocated by the component while `SlotInventory.Telemetry.Enable` is set.
+ *
+ * Request latency is measured per request: the client tags each request with a sequence number, and the server
+ * echoes it once the request has been executed and the update it caused has been sent. Updates caused by other
+ * players or by the server itself are not counted as latency.
+ */
+struct SLOTBASEDINVENTORYSYSTEM_API FSlotInventoryNetTelemetry
+{
+	static bool IsEnabled();
+
+	/** Size of the parameters of a slot update on the wire */
+	static int32 EstimateSlotsUpdateSize(const TArray<int32>& Indices, const TArray<FInventorySlot>& Values);
+
+
+	/** Server side */
+
+	void RecordSlotsUpdateSent(int32 NumSlots, int32 NumBytes);
+
+	void RecordServerRequest(ESlotInventoryServerRequest Request);
+
+
+	/** Client side */
+
+	/** Returns the sequence number the server echoes back, never 0 */
+	uint32 RecordRequestSent();
+
+	/** The request has been executed and the update it caused received */
+	void RecordRequestAcknowledged(uint32 Sequence);
+
+	/** The request budget of the server rejected the request, it is not counted as latency */
+	void RecordRequestRejected(uint32 Sequence);
+
+	void RecordSlotsUpdateReceived();
+
+	/** Count the requests waiting for longer than the timeout as expired, and the oldest beyond MaxPendingRequests */
+	void ExpirePendingRequests(double Now);
+
+
+	void Reset();
+
+	double GetElapsedSeconds() const;
+
+
+	double StartTime = FPlatformTime::Seconds();
+
+	uint64 UpdatesSent = 0;
+	uint64 SlotsSent = 0;
+	uint64 BytesSent = 0;
+	uint32 LargestUpdateBytes = 0;
+
+	uint32 RequestCounts[(int32)ESlotInventoryServerRequest::Count] = {};
+
+	uint64 UpdatesReceived = 0;
+
+	/** Sequence and send time of the requests still waiting for their acknowledgement, oldest first */
+	TArray<TPair<uint32, double>> PendingRequests;
+	static constexpr int32 MaxPendingRequests = 1024;
+	uint32 NextRequestSequence = 1;
+
+	/** Requests never acknowledged within SlotInventory.Telemetry.RequestTimeout, lost with a closed connection for instance */
+	uint32 ExpiredRequests = 0;
+
+	uint32 RejectedRequests = 0;
+
+	FSlotInventoryLatencyHistogram Latency;
+};
@@ -0,0 +1,50 @@
+// Amasson
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/WeakObjectPtrTemplates.h"
+
+class USlotInventoryComponentBase;
+struct FInventoryContent;
+
+/** Serialized and compressed content of one inventory */
+struct SLOTBASEDINVENTORYSYSTEM_API FSlotInventorySaveRecord
+{
+	TWeakObjectPtr<USlotInventoryComponentBase> Inventory;
+
+	/** Content revision of the inventory when it was snapshot */
+	uint32 ContentRevision = 0;
+
+	TArray<uint8> Bytes;
+};
+
+/**
+ * Save inventories without serializing on the game thread.
+ * The game thread only copies the content of the inventories, serialization and compression run on background tasks.
+ */
+class SLOTBASEDINVENTORYSYSTEM_API FSlotInventoryAsyncSave
+{
+public:
+
+	using FOnSaveCompleted = TFunction<void(TArray<FSlotInventorySaveRecord>&& Records)>;
+
+	/**
+	 * Snapshot the inventories, serialize them in the background and give back the bytes on the game thread.
+	 * Saved inventories are marked as saved at the revision they were snapshot.
+	 * @param bOnlyUnsaved Skip the inventories without changes since their last save.
+	 */
+	static void SaveInventoriesAsync(TConstArrayView<USlotInventoryComponentBase*> Inventories, FOnSaveCompleted OnCompleted, bool bOnlyUnsaved = true);
+
+	/**
+	 * Serialize the SaveGame properties of a content and compress them. Can be called from any thread.
+	 * Without bSaveGameOnly every property is kept, modifier payloads included, for dehydrated and cooked contents.
+	 */
+	static bool SerializeContent(const FInventoryContent& Content, TArray<uint8>& OutBytes, bool bSaveGameOnly = true);
+
+	/** Reverse of SerializeContent, in the mode the bytes were written with. Must be called on the game thread since it may resolve modifier structs. */
+	static bool DeserializeContent(const TArray<uint8>& Bytes, FInventoryContent& OutContent);
+
+	/** Deserialize bytes and set them as the content of an inventory */
+	static bool LoadInventory(USlotInventoryComponentBase* Inventory, const TArray<uint8>& Bytes);
+};
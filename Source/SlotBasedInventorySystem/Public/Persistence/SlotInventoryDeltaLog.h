@@ -0,0 +1,122 @@
+// Amasson
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/WeakObjectPtrTemplates.h"
+#include "Structures/SlotInventorySystemStructs.h"
+#include <atomic>
+
+class USlotInventoryComponentBase;
+
+/**
+ * Persist inventories as an append-only log of the slots changed since the last save.
+ * Every save appends one frame to Deltas.sidl with the changed slots of each inventory, instead of rewriting
+ * every slot. Once the deltas grow past SlotInventory.Persistence.CheckpointKB, a checkpoint writes the full
+ * content of every inventory to Checkpoint.sidl and starts a new log. Loading reads the checkpoint and replays
+ * the frames written after it.
+ * The game thread only copies the changed slots, serialization, compression and file writes run on a background
+ * task in the order of the saves.
+ */
+class SLOTBASEDINVENTORYSYSTEM_API FSlotInventoryDeltaLog : public TSharedFromThis<FSlotInventoryDeltaLog, ESPMode::ThreadSafe>
+{
+public:
+
+	using FOnWriteCompleted = TFunction<void(bool bSuccess)>;
+
+	/** Files are written in Directory, relative to Saved/SaveGames unless absolute */
+	explicit FSlotInventoryDeltaLog(const FString& InDirectory);
+
+
+	/** Inventories */
+
+	/**
+	 * Save an inventory under an id that stays the same between runs. Content loaded for this id is set right away.
+	 * The inventory must be unregistered before it is destroyed.
+	 */
+	void RegisterInventory(FName Id, USlotInventoryComponentBase* Inventory);
+
+	/** Stop tracking an inventory, its content is kept in memory and written by the next saves */
+	void UnregisterInventory(FName Id);
+
+
+	/** Load */
+
+	/** Read the checkpoint and replay the deltas. Must be called once on the game thread before saving. */
+	bool Load();
+
+	bool IsLoaded() const { return bLoaded; }
+
+
+	/** Save */
+
+	/** Append the slots changed since the last save of every inventory, or write a checkpoint if one is due */
+	void SaveAsync(FOnWriteCompleted OnCompleted = nullptr);
+
+	/** Write the full content of every inventory and start a new log */
+	void CheckpointAsync(FOnWriteCompleted OnCompleted = nullptr);
+
+	/** Block until the pending file writes are done. Their completion callbacks still run on the next game thread tick. */
+	void WaitForWrites();
+
+	/** Size of the deltas written since the last checkpoint */
+	int64 GetDeltaBytes() const { return DeltaBytes; }
+
+	const FString& GetDirectory() const { return Directory; }
+
+
+private:
+
+	/** Content of an inventory, already serialized when it was dehydrated */
+	struct FContentData
+	{
+		FInventoryContent Content;
+		TArray<uint8> Bytes;
+	};
+
+	struct FRecord;
+
+	static void CopyContent(const USlotInventoryComponentBase* Inventory, FContentData& OutData);
+
+	void ApplyLoadedContent(USlotInventoryComponentBase* Inventory, FContentData& Data);
+
+	void WriteRecordsAsync(TArray<FRecord>&& Records, bool bCheckpoint, FOnWriteCompleted&& OnCompleted);
+
+	/** Run on the background writer, in order */
+	void EnqueueWrite(TUniqueFunction<void()>&& Write);
+
+	void DrainWrites();
+
+	FString Directory;
+	FString CheckpointPath;
+	FString DeltasPath;
+
+	TMap<FName, TWeakObjectPtr<USlotInventoryComponentBase>> Inventories;
+
+	/** Loaded content of the ids not registered yet, and content of the unregistered inventories */
+	TMap<FName, FContentData> UnregisteredContents;
+
+	/** Written as a full content record by the next save: new inventories and unregistered ones with changes */
+	TSet<FName> FullContentIds;
+
+	/** Generation of the checkpoint, only the delta frames of the same generation are replayed */
+	uint32 Generation = 0;
+
+	bool bLoaded = false;
+
+	/** Set when a write failed or the log has a torn frame, the next save writes a checkpoint */
+	bool bCheckpointRequired = false;
+
+	std::atomic<int64> DeltaBytes { 0 };
+
+	/** Writer state */
+
+	FCriticalSection WriteLock;
+
+	TArray<TUniqueFunction<void()>> PendingWrites;
+
+	bool bWriterRunning = false;
+
+	/** Generation of the checkpoint on disk, only accessed by the writer */
+	uint32 WrittenGeneration = 0;
+};
@@ -5,6 +5,8 @@
 #include "CoreMinimal.h"
 #include "Kismet/BlueprintFunctionLibrary.h"
 #include "Structures/SlotInventorySystemStructs.h"
+#include "Crafting/SlotInventoryCraftabilityEvaluator.h"
+#include "Transactions/SlotInventoryTransaction.h"
 #include "SlotInventoryBlueprintLibrary.generated.h"
 
 /**
@@ -33,6 +35,25 @@ public:
 
 	/** Inventory Content */
 
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "SlotInventory|Content")
+	static int32 GetContentCapacity(const FInventoryContent& Content);
+
+	/** Every slot up to the capacity, in dense and sparse contents alike */
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "SlotInventory|Content")
+	static void GetContentSlots(const FInventoryContent& Content, TArray<FInventorySlot>& Slots);
+
+	/** Replace every slot, the capacity becomes the number of slots */
+	UFUNCTION(BlueprintCallable, Category = "SlotInventory|Content")
+	static void SetContentSlots(UPARAM(Ref) FInventoryContent& Content, const TArray<FInventorySlot>& Slots);
+
+	/** Empty slot if Index is not valid */
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "SlotInventory|Content")
+	static FInventorySlot GetContentSlotAtIndex(const FInventoryContent& Content, int32 Index);
+
+	/** Returns false if Index is not valid */
+	UFUNCTION(BlueprintCallable, Category = "SlotInventory|Content")
+	static bool SetContentSlotAtIndex(UPARAM(Ref) FInventoryContent& Content, int32 Index, const FInventorySlot& Slot);
+
 	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "SlotInventory|Content")
 	static bool IsValidIndex(const FInventoryContent& Content, int32 Index);
 
@@ -51,6 +72,25 @@ public:
 	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "SlotInventory|Content")
 	static int32 GetItemQuantity(const FInventoryContent& Content, FName Item);
 
+	/** Crafting */
+
+	/** Number of times each recipe can be crafted with the items of all the contents */
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "SlotInventory|Crafting")
+	static void GetCraftableCounts(const TArray<FInventoryContent>& Contents, const TArray<FSlotInventoryRecipe>& Recipes, TArray<int32>& CraftableCounts);
+
+	/** Transactions */
+
+	/** Apply every modification, or none of them if any would overflow */
+	UFUNCTION(BlueprintCallable, Category = "SlotInventory|Transaction")
+	static bool TryModifyInventoriesWithoutOverflow(const TArray<FSlotInventoryModification>& Modifications);
+
+	/** Hold the content updates of every inventory modified until the matching End, which sends them right away */
+	UFUNCTION(BlueprintCallable, Category = "SlotInventory|Transaction")
+	static void BeginInventoryBatchEdit();
+
+	UFUNCTION(BlueprintCallable, Category = "SlotInventory|Transaction")
+	static void EndInventoryBatchEdit();
+
 	/** Inventory Component */
 
 	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "SlotInventory|Component")
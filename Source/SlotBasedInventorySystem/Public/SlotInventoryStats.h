@@ -0,0 +1,97 @@
+// Amasson
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Stats/Stats.h"
+#include "ProfilingDebugging/CpuProfilerTrace.h"
+
+/**
+ * Stats of the inventory system, viewable with `stat SlotInventory` and in Unreal Insights.
+ * Everything declared here compiles out when STATS and the cpu profiler trace are disabled (shipping).
+ */
+
+DECLARE_STATS_GROUP(TEXT("SlotInventory"), STATGROUP_SlotInventory, STATCAT_Advanced);
+
+/** Transactions */
+DECLARE_CYCLE_STAT_EXTERN(TEXT("SetContent"), STAT_SlotInventory_SetContent, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("SetContentCapacity"), STAT_SlotInventory_SetContentCapacity, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("ModifySlotQuantity"), STAT_SlotInventory_ModifySlotQuantity, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("ModifyContent"), STAT_SlotInventory_ModifyContent, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("TryModifyContent"), STAT_SlotInventory_TryModifyContent, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("DropSlotAtIndex"), STAT_SlotInventory_DropSlotAtIndex, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("DropSlot"), STAT_SlotInventory_DropSlot, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("RegroupSimilarItems"), STAT_SlotInventory_RegroupSimilarItems, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("ReceiveStacks"), STAT_SlotInventory_ReceiveStacks, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("ParallelModifyContents"), STAT_SlotInventory_ParallelModifyContents, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+
+/** Multi inventory transactions */
+DECLARE_CYCLE_STAT_EXTERN(TEXT("TransactionStage"), STAT_SlotInventory_TransactionStage, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("TransactionCommit"), STAT_SlotInventory_TransactionCommit, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("TransactionAbort"), STAT_SlotInventory_TransactionAbort, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("FlushBatchEdit"), STAT_SlotInventory_FlushBatchEdit, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+
+/** Aggregates */
+DECLARE_CYCLE_STAT_EXTERN(TEXT("AggregateModifyContent"), STAT_SlotInventory_AggregateModifyContent, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+
+/** Snapshots */
+DECLARE_CYCLE_STAT_EXTERN(TEXT("PublishSnapshot"), STAT_SlotInventory_PublishSnapshot, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+
+/** Command queue */
+DECLARE_CYCLE_STAT_EXTERN(TEXT("DrainCommands"), STAT_SlotInventory_DrainCommands, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+
+/** Request budget */
+DECLARE_CYCLE_STAT_EXTERN(TEXT("ProcessDeferredRequests"), STAT_SlotInventory_ProcessDeferredRequests, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_DWORD_ACCUMULATOR_STAT_EXTERN(TEXT("Requests Waiting"), STAT_SlotInventory_RequestsWaiting, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+
+/** Registry */
+DECLARE_CYCLE_STAT_EXTERN(TEXT("RegistryRadiusQuery"), STAT_SlotInventory_RegistryRadiusQuery, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+
+/** Memory */
+DECLARE_CYCLE_STAT_EXTERN(TEXT("CompactMemory"), STAT_SlotInventory_CompactMemory, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("CompactIdleInventories"), STAT_SlotInventory_CompactIdleInventories, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+
+/** Hydration */
+DECLARE_CYCLE_STAT_EXTERN(TEXT("HydrateContent"), STAT_SlotInventory_HydrateContent, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("DehydrateContent"), STAT_SlotInventory_DehydrateContent, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Hydrations"), STAT_SlotInventory_Hydrations, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Dehydrations"), STAT_SlotInventory_Dehydrations, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+
+/** Background maintenance */
+DECLARE_CYCLE_STAT_EXTERN(TEXT("MaintainInventories"), STAT_SlotInventory_MaintainInventories, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("BackgroundMaintenance"), STAT_SlotInventory_BackgroundMaintenance, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Maintenance Slots Modified"), STAT_SlotInventory_MaintenanceSlotsModified, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+
+/** Persistence */
+DECLARE_CYCLE_STAT_EXTERN(TEXT("SnapshotForSave"), STAT_SlotInventory_SnapshotForSave, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("SnapshotDeltas"), STAT_SlotInventory_SnapshotDeltas, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("SnapshotCheckpoint"), STAT_SlotInventory_SnapshotCheckpoint, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("LoadDeltaLog"), STAT_SlotInventory_LoadDeltaLog, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+
+/** Broadcasts */
+DECLARE_CYCLE_STAT_EXTERN(TEXT("BroadcastContentUpdate"), STAT_SlotInventory_BroadcastContentUpdate, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("OnInventoryContentChanged"), STAT_SlotInventory_OnInventoryContentChanged, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("OnInventorySlotsChanged"), STAT_SlotInventory_OnInventorySlotsChanged, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("ViewModelSlotsChanged"), STAT_SlotInventory_ViewModelSlotsChanged, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("OnInventoryCapacityChanged"), STAT_SlotInventory_OnInventoryCapacityChanged, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("BroadcastModifiedSlotsToClients"), STAT_SlotInventory_BroadcastModifiedSlotsToClients, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("BroadcastFullInventory"), STAT_SlotInventory_BroadcastFullInventory, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_CYCLE_STAT_EXTERN(TEXT("ReceivedUpdateSlotsValues"), STAT_SlotInventory_ReceivedUpdateSlotsValues, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+
+/** Counters, reset every frame */
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Slots Scanned"), STAT_SlotInventory_SlotsScanned, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Slots Dirtied"), STAT_SlotInventory_SlotsDirtied, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Flushes"), STAT_SlotInventory_Flushes, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Slot Updates Sent"), STAT_SlotInventory_SlotUpdatesSent, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Slot Update Bytes Sent"), STAT_SlotInventory_SlotUpdateBytesSent, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Commands Executed"), STAT_SlotInventory_CommandsExecuted, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Requests Accepted"), STAT_SlotInventory_RequestsAccepted, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Requests Deferred"), STAT_SlotInventory_RequestsDeferred, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Requests Rejected"), STAT_SlotInventory_RequestsRejected, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Dormancy Wakes"), STAT_SlotInventory_DormancyWakes, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("Delta Slots Saved"), STAT_SlotInventory_DeltaSlotsSaved, STATGROUP_SlotInventory, SLOTBASEDINVENTORYSYSTEM_API);
+
+/** Scope timed both by the stat system and as a named cpu event in Insights */
+#define SLOTINVENTORY_SCOPE_CYCLE_COUNTER(StatName) \
+	TRACE_CPUPROFILER_EVENT_SCOPE(SlotInventory_##StatName); \
+	SCOPE_CYCLE_COUNTER(STAT_SlotInventory_##StatName)
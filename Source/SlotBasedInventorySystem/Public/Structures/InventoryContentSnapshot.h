@@ -0,0 +1,112 @@
+// Amasson
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Templates/RefCounting.h"
+#include "Structures/SlotInventorySystemStructs.h"
+#include <atomic>
+
+/** Immutable range of slots, shared by every snapshot in which it did not change */
+struct SLOTBASEDINVENTORYSYSTEM_API FInventorySlotBlock
+{
+	static constexpr int32 NumSlotsPerBlock = 64;
+
+	TArray<FInventorySlot> Slots;
+
+	int32 NumEmptySlots = 0;
+
+	TMap<FName, int32> ItemQuantities;
+};
+
+/**
+ * Immutable published version of an inventory content.
+ * Safe to read from any thread for as long as a reference is held.
+ */
+class SLOTBASEDINVENTORYSYSTEM_API FInventoryContentSnapshot
+{
+public:
+
+	int32 GetCapacity() const;
+
+	/** Null if Index is out of range */
+	const FInventorySlot* GetSlot(int32 Index) const;
+
+	int32 GetItemQuantity(const FName& Item) const;
+
+	bool ContainsItem(const FName& Item) const;
+
+	int32 GetEmptySlotCount() const;
+
+	/** INDEX_NONE if there is no empty slot */
+	int32 GetFirstEmptySlotIndex() const;
+
+	/** Content revision of the inventory when it was published */
+	uint32 GetContentRevision() const;
+
+
+	void AddRef() const;
+	uint32 Release() const;
+
+private:
+
+	friend class FInventoryContentSnapshotChannel;
+
+	using FBlockRef = TSharedRef<const FInventorySlotBlock, ESPMode::ThreadSafe>;
+
+	TArray<FBlockRef> Blocks;
+
+	int32 Capacity = 0;
+
+	int32 NumEmptySlots = 0;
+
+	TMap<FName, int32> ItemQuantities;
+
+	uint32 ContentRevision = 0;
+
+	mutable std::atomic<uint32> NumRefs { 0 };
+};
+
+using FInventoryContentSnapshotRef = TRefCountPtr<const FInventoryContentSnapshot>;
+
+/**
+ * Publishes snapshots of one inventory content (game thread) and hands them to readers (any thread) without locks.
+ * Readers never wait: acquiring is a load and a reference increment, whatever the publishing rate.
+ * Replaced snapshots are released by the publisher once no reader is in the middle of acquiring one.
+ */
+class SLOTBASEDINVENTORYSYSTEM_API FInventoryContentSnapshotChannel
+{
+public:
+
+	FInventoryContentSnapshotChannel() = default;
+	~FInventoryContentSnapshotChannel();
+
+	UE_NONCOPYABLE(FInventoryContentSnapshotChannel);
+
+	/** Any thread. Latest published snapshot, null before the first publish. */
+	FInventoryContentSnapshotRef Acquire() const;
+
+	/** Game thread. Publish a new snapshot rebuilding only the blocks holding a dirty slot or affected by a capacity change. */
+	void Publish(const FInventoryContent& Content, const TSet<int32>& DirtySlots, uint32 ContentRevision);
+
+	/** Game thread. Publish a new snapshot rebuilding every block. */
+	void PublishFull(const FInventoryContent& Content, uint32 ContentRevision);
+
+private:
+
+	static FInventoryContentSnapshot::FBlockRef BuildBlock(const FInventoryContent& Content, int32 BlockIndex);
+
+	static void AddBlockTotals(FInventoryContentSnapshot& Snapshot, const FInventorySlotBlock& Block);
+	static void RemoveBlockTotals(FInventoryContentSnapshot& Snapshot, const FInventorySlotBlock& Block);
+
+	void Swap(const FInventoryContentSnapshot* NewSnapshot);
+
+	void ReleaseRetiredSnapshots();
+
+	std::atomic<const FInventoryContentSnapshot*> Current { nullptr };
+
+	mutable std::atomic<int32> NumAcquiringReaders { 0 };
+
+	/** Replaced snapshots still referenced by the channel, game thread only */
+	TArray<const FInventoryContentSnapshot*> RetiredSnapshots;
+};
@@ -6,6 +6,8 @@
 #include "InstancedStruct.h"
 #include "SlotInventorySystemStructs.generated.h"
 
+struct FSlotInventoryMemoryUsage;
+
 /** Rules set when moving one specific slow around */
 USTRUCT(BlueprintType)
 struct SLOTBASEDINVENTORYSYSTEM_API FInventorySlotTransactionRule
@@ -98,36 +100,194 @@ struct SLOTBASEDINVENTORYSYSTEM_API FInventorySlot // : public FFastArraySeriali
 };
 
 
+/** Item and quantity of one slot before and after a content update. Empty slots have no item and no quantity. */
+struct SLOTBASEDINVENTORYSYSTEM_API FInventorySlotChange
+{
+	int32 Index = INDEX_NONE;
+
+	FName PreviousItem;
+	int32 PreviousQuantity = 0;
+
+	FName NewItem;
+	int32 NewQuantity = 0;
+};
+
+
+/** Slots of a sparse inventory content. Empty until one of its slots is written. */
+USTRUCT()
+struct SLOTBASEDINVENTORYSYSTEM_API FInventorySlotPage
+{
+	GENERATED_USTRUCT_BODY()
+
+	static constexpr int32 NumSlotsPerPage = 64;
+
+	UPROPERTY(SaveGame)
+	TArray<FInventorySlot> Slots;
+};
+
+
 USTRUCT(BlueprintType)
 struct SLOTBASEDINVENTORYSYSTEM_API FInventoryContent // : public FFastArraySerializer
 {
     GENERATED_USTRUCT_BODY()
 
 
+	/** Capacity */
+
+	int32 GetCapacity() const;
+
+	/** New slots are empty. In sparse mode they are not allocated. */
+	void SetCapacity(int32 NewCapacity);
+
+	bool IsSparse() const { return bSparse; }
+
+	/** Convert the slots to the other storage, indices and values are kept */
+	void SetSparse(bool bNewSparse);
+
+
+	/** Slots */
+
 	bool IsValidIndex(int32 Index) const;
 
+	/** Pointer to a writable slot. In sparse mode, the page of the slot is allocated if needed. */
 	FInventorySlot* GetSlotPtrAtIndex(int32 Index);
+
+	/** Pointer to a slot. In sparse mode, slots of pages that are not allocated point to a shared empty slot. */
 	const FInventorySlot* GetSlotConstPtrAtIndex(int32 Index) const;
 
-	using FItemStacks = TMap<FName, int32>;
+	/** Number of slots allocated in memory, the capacity in dense mode */
+	int32 GetStoredSlotCount() const;
+
+	/** Copy every slot up to the capacity into a dense array */
+	void CopySlots(TArray<FInventorySlot>& OutSlots) const;
+
+	/** Replace every slot, the capacity becomes the number of slots. The storage mode is kept. */
+	void SetSlots(const TArray<FInventorySlot>& NewSlots);
+
+	/** Free the pages of these slots that only contain empty slots. Does nothing in dense mode. */
+	void ReleaseEmptyPages(const TSet<int32>& SlotIndices);
+
+
+	/** Memory */
+
+	void AccumulateMemoryUsage(FSlotInventoryMemoryUsage& Usage) const;
+
+	/** Release the slack of the slot and modifier arrays and the empty sparse pages */
+	void Compact();
+
+	/** Call Function(Index, Slot) on every slot that can hold items, in index order */
+	template<typename FunctionType>
+	void ForEachStoredSlot(FunctionType&& Function) const
+	{
+		if (!bSparse)
+		{
+			for (int32 SlotIndex = 0; SlotIndex < Slots.Num(); SlotIndex++)
+				Function(SlotIndex, Slots[SlotIndex]);
+			return;
+		}
+		for (int32 PageIndex = 0; PageIndex < SlotPages.Num(); PageIndex++)
+		{
+			const TArray<FInventorySlot>& PageSlots = SlotPages[PageIndex].Slots;
+			for (int32 PageSlotIndex = 0; PageSlotIndex < PageSlots.Num(); PageSlotIndex++)
+				Function(PageIndex * FInventorySlotPage::NumSlotsPerPage + PageSlotIndex, PageSlots[PageSlotIndex]);
+		}
+	}
+
+	template<typename FunctionType>
+	void ForEachStoredSlot(FunctionType&& Function)
+	{
+		if (!bSparse)
+		{
+			for (int32 SlotIndex = 0; SlotIndex < Slots.Num(); SlotIndex++)
+				Function(SlotIndex, Slots[SlotIndex]);
+			return;
+		}
+		for (int32 PageIndex = 0; PageIndex < SlotPages.Num(); PageIndex++)
+		{
+			TArray<FInventorySlot>& PageSlots = SlotPages[PageIndex].Slots;
+			for (int32 PageSlotIndex = 0; PageSlotIndex < PageSlots.Num(); PageSlotIndex++)
+				Function(PageIndex * FInventorySlotPage::NumSlotsPerPage + PageSlotIndex, PageSlots[PageSlotIndex]);
+		}
+	}
+
+	/** Transaction temporaries, sized so that a typical transaction does not allocate */
+	using FItemStacks = TMap<FName, int32, TInlineSetAllocator<8>>;
+	using FMaxStackSizes = TMap<FName, int32, TInlineSetAllocator<8>>;
+	using FModifiedSlots = TSet<int32, DefaultKeyFuncs<int32>, TInlineSetAllocator<16>>;
+	using FPreviousValues = TArray<TPair<int32, FInventorySlot>, TInlineAllocator<8>>;
 
 	struct FContentModifications
 	{
-		TSet<int32> ModifiedSlots;
+		FModifiedSlots ModifiedSlots;
 		bool bCreatedEmptySlot = false;
+
+		/** Optional, receives the value of each slot before it is modified. A slot can appear several times, oldest first. */
+		FPreviousValues* PreviousValues = nullptr;
+
+		void RecordPreviousValue(int32 Index, const FName& Item, int32 Quantity);
 	};
 
-	bool ReceiveStacks(FItemStacks& Stacks, const FInventoryContentTransactionRule& Rule, const TMap<FName, int32>& MaxStackSizes, FContentModifications& OutModifications);
+	/** Restore the previous values recorded in a FContentModifications, newest first */
+	void RestorePreviousValues(FPreviousValues& PreviousValues);
+
+	bool ReceiveStacks(FItemStacks& Stacks, const FInventoryContentTransactionRule& Rule, const FMaxStackSizes& MaxStackSizes, FContentModifications& OutModifications);
 
 	bool ReceiveStack(const FName& Item, int32& InoutQuantity, const FInventorySlotTransactionRule& Rule, int32 MaxStackSize, FContentModifications& OutModifications);
 	bool ReceiveSlotAtIndex(FInventorySlot& InoutSlot, int32 Index, const FInventorySlotTransactionRule& Rule, int32 MaxStackSize);
 	bool ReceiveSlot(FInventorySlot& InoutSlot, const FInventoryContentTransactionRule& Rule, int32 MaxStackSize, FContentModifications& OutModifications);
 
+	/** ReceiveSlot of at most MaxAmount of the slot, the rest stays in InoutSlot. A MaxAmount of 0 receives the whole slot. */
+	bool ReceiveSlotAmount(FInventorySlot& InoutSlot, int32 MaxAmount, const FInventoryContentTransactionRule& Rule, int32 MaxStackSize, FContentModifications& OutModifications);
+
 	bool RegroupSimilarItemsAtIndex(int32 Index, FContentModifications& OutModifications, int32 MaxStackSize);
 
+	/** Fill the partial stack at Index from the stacks of the same item after it, slots before Index are not touched */
+	bool MergeFollowingStacksAtIndex(int32 Index, FContentModifications& OutModifications, int32 MaxStackSize);
+
+	/**
+	 * Move the first non empty slot after Index into the empty slot at Index.
+	 * InoutReadIndex keeps the scan position between calls with increasing indices. Previous values are not recorded.
+	 */
+	bool MoveNextSlotToIndex(int32 Index, int32& InoutReadIndex, FContentModifications& OutModifications);
+
 
+	/**
+	 * Slots of a dense content, always empty in sparse mode. Blueprints reading the content of a sparse
+	 * inventory use the content functions of USlotInventoryBlueprintLibrary, which handle both storages.
+	 * Inventories are edited dense in the editor and only switch to sparse in game worlds.
+	 */
 	UPROPERTY(BlueprintReadWrite, EditAnywhere, SaveGame, Category = "Content")
 	TArray<FInventorySlot> Slots;
+
+private:
+
+	/** Slots are stored in pages instead of Slots, see SetSparse */
+	UPROPERTY(SaveGame)
+	bool bSparse = false;
+
+	/**
+	 * Call Function(Index, Slot) in index order until it returns false.
+	 * In sparse mode, pages that are not allocated are skipped, or allocated when reached if bAllocatePages.
+	 */
+	template<typename FunctionType>
+	int32 VisitSlots(bool bAllocatePages, FunctionType&& Function);
+
+	TArray<FInventorySlot>& AllocatePage(int32 PageIndex);
+
+	int32 GetPageSize(int32 PageIndex) const;
+
+	/** Receive loops specialized on the slot rule flags, see SlotInventoryTransactionKernels.h */
+	template<typename PolicyType>
+	bool ReceiveStackWithPolicy(const FName& Item, int32& InoutQuantity, const PolicyType& Policy, int32 MaxStackSize, FContentModifications& OutModifications);
+
+	template<typename PolicyType>
+	bool ReceiveSlotWithPolicy(FInventorySlot& InoutSlot, const PolicyType& Policy, bool bAllocatePages, int32 MaxStackSize, FContentModifications& OutModifications, int32& InoutScannedSlots);
+
+	UPROPERTY(SaveGame)
+	int32 SparseCapacity = 0;
+
+	UPROPERTY(SaveGame)
+	TArray<FInventorySlotPage> SlotPages;
 };
 
 // template<>
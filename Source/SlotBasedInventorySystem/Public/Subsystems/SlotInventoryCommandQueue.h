@@ -0,0 +1,88 @@
+// Amasson
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Containers/Queue.h"
+#include "UObject/WeakObjectPtrTemplates.h"
+#include <atomic>
+
+class USlotInventoryComponentBase;
+
+/** Operation on an inventory submitted from any thread and executed on the game thread */
+struct SLOTBASEDINVENTORYSYSTEM_API FSlotInventoryCommand
+{
+	enum class EType : uint8
+	{
+		AddStacks,
+		RemoveStacks,
+		MoveSlot,
+	};
+
+	/**
+	 * Called on the game thread once the command is executed. Overflows are only filled by stack commands.
+	 * Commands failed because the world was torn down are completed with their items as overflows, on the enqueuing thread if enqueued after.
+	 */
+	using FOnCompleted = TFunction<void(bool bSuccess, const TMap<FName, int32>& Overflows)>;
+
+	EType Type = EType::AddStacks;
+
+	TWeakObjectPtr<USlotInventoryComponentBase> Inventory;
+
+	/** AddStacks and RemoveStacks, quantities are always positive */
+	TMap<FName, int32> Items;
+
+	/** MoveSlot, a DestinationIndex of INDEX_NONE drops the slot anywhere in the destination. A MaxAmount of 0 moves the whole slot. */
+	int32 SourceIndex = INDEX_NONE;
+	TWeakObjectPtr<USlotInventoryComponentBase> Destination;
+	int32 DestinationIndex = INDEX_NONE;
+	int32 MaxAmount = 0;
+
+	FOnCompleted OnCompleted;
+};
+
+/**
+ * Lock-free multiple producers, single consumer queue of inventory commands.
+ * Any thread can enqueue, the owning USlotInventorySubsystem drains it on the game thread before actors tick,
+ * so the modifications are flushed in the same frame.
+ * Hold it by shared reference from worker threads: it stays valid even after the world is torn down.
+ */
+class SLOTBASEDINVENTORYSYSTEM_API FSlotInventoryCommandQueue
+{
+public:
+
+	/** Thread safe */
+
+	void EnqueueAddStacks(TWeakObjectPtr<USlotInventoryComponentBase> Inventory, TMap<FName, int32> Items, FSlotInventoryCommand::FOnCompleted OnCompleted = nullptr);
+
+	void EnqueueRemoveStacks(TWeakObjectPtr<USlotInventoryComponentBase> Inventory, TMap<FName, int32> Items, FSlotInventoryCommand::FOnCompleted OnCompleted = nullptr);
+
+	void EnqueueMoveSlot(TWeakObjectPtr<USlotInventoryComponentBase> Source, int32 SourceIndex, TWeakObjectPtr<USlotInventoryComponentBase> Destination, int32 DestinationIndex = INDEX_NONE, int32 MaxAmount = 0, FSlotInventoryCommand::FOnCompleted OnCompleted = nullptr);
+
+	void Enqueue(FSlotInventoryCommand&& Command);
+
+
+	/** Game thread */
+
+	/**
+	 * Execute the commands enqueued before the drain started. Returns the number of executed commands.
+	 * Commands enqueued by completion callbacks wait for the next drain.
+	 */
+	int32 Drain();
+
+	/** Complete every queued command as failed, their items as overflows. Commands enqueued afterwards fail right away on their thread. */
+	int32 FailAll();
+
+private:
+
+	static bool Execute(FSlotInventoryCommand& Command, TMap<FName, int32>& OutOverflows);
+
+	static void Fail(FSlotInventoryCommand& Command);
+
+	TQueue<FSlotInventoryCommand, EQueueMode::Mpsc> Commands;
+
+	/** Enqueued and not yet dequeued, incremented after each enqueue */
+	std::atomic<int32> NumQueued = 0;
+
+	std::atomic<bool> bClosed = false;
+};
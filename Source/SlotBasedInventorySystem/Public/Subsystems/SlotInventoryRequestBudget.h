@@ -0,0 +1,68 @@
+// Amasson
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/ObjectKey.h"
+#include "Debug/SlotInventoryNetTelemetry.h"
+
+class UNetConnection;
+
+/**
+ * Per connection token buckets bounding the server time spent on client inventory requests.
+ * Costs are counted in slot visits: a base cost per request plus the slots it may scan.
+ * A request over budget is deferred until its connection has refilled, and rejected when
+ * too many requests of the connection are already waiting. Costs are clamped to the burst, so a large request
+ * waits for a full bucket rather than being refused. Requests of a connection always execute in the order they were received.
+ *
+ * Opt-in with `SlotInventory.Budget.Enable`, tuned with the other `SlotInventory.Budget.*` console variables.
+ */
+class SLOTBASEDINVENTORYSYSTEM_API FSlotInventoryRequestBudget
+{
+public:
+
+	enum class EDecision : uint8
+	{
+		Accept,
+		Defer,
+		Reject
+	};
+
+	static bool IsEnabled();
+
+	/** Slot visits a request may cost, WorkSlots being the number of slots it can scan or send, at most the burst */
+	static double EstimateCost(ESlotInventoryServerRequest Request, int32 WorkSlots);
+
+	/** Spend the cost of a request now if the connection can afford it */
+	EDecision Consume(const UNetConnection* Connection, double Cost);
+
+	/** Keep a request that Consume deferred, it is executed by ProcessDeferred if Requester is still valid */
+	void Defer(const UNetConnection* Connection, double Cost, const UObject* Requester, TFunction<void()>&& Execute);
+
+	/** Execute the deferred requests the connections can afford and forget closed connections */
+	void ProcessDeferred();
+
+	int32 GetNumDeferred() const;
+
+private:
+
+	struct FDeferredRequest
+	{
+		double Cost;
+		TWeakObjectPtr<const UObject> Requester;
+		TFunction<void()> Execute;
+	};
+
+	struct FConnectionBudget
+	{
+		double Tokens = 0.0;
+		double LastRefillSeconds = 0.0;
+		TArray<FDeferredRequest> Deferred;
+	};
+
+	FConnectionBudget& FindOrAddBudget(const UNetConnection* Connection);
+
+	static void Refill(FConnectionBudget& Budget, double NowSeconds);
+
+	TMap<TObjectKey<UNetConnection>, FConnectionBudget> Connections;
+};
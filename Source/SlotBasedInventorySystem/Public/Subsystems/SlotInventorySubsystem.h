@@ -0,0 +1,144 @@
+// Amasson
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "Templates/SubclassOf.h"
+#include "UObject/ObjectKey.h"
+#include "Subsystems/SlotInventoryCommandQueue.h"
+#include "Subsystems/SlotInventoryRequestBudget.h"
+#include "SlotInventorySubsystem.generated.h"
+
+class AActor;
+class USceneComponent;
+class USlotInventoryComponentBase;
+enum class EUpdateTransformFlags : int32;
+enum class ETeleportType : uint8;
+
+/**
+ * World wide services of the inventory system.
+ */
+UCLASS()
+class SLOTBASEDINVENTORYSYSTEM_API USlotInventorySubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+
+	/** Command Queue */
+
+	/** Queue to submit inventory modifications from any thread. Get it on the game thread and keep the reference. */
+	TSharedRef<FSlotInventoryCommandQueue, ESPMode::ThreadSafe> GetCommandQueue() const;
+
+
+	/** Request Budget */
+
+	/** Server time budget of the client requests, deferred requests are executed before actors tick */
+	FSlotInventoryRequestBudget& GetRequestBudget();
+
+
+	/** Inventories */
+
+	/** Inventories register while playing, keyed by owner and tag. Idle ones are compacted in the background. */
+	void RegisterInventory(USlotInventoryComponentBase* Inventory);
+	void UnregisterInventory(USlotInventoryComponentBase* Inventory);
+
+	/** Registered inventory of an owner with this tag, the first registered one if several share it */
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "SlotInventory|Registry")
+	USlotInventoryComponentBase* FindInventory(const UObject* Owner, FName InventoryTag) const;
+
+	/** Registered inventory of an owner with this tag, null if none or several share it */
+	USlotInventoryComponentBase* FindUniqueInventory(const UObject* Owner, FName InventoryTag) const;
+
+	/** Registered inventories whose owner is of this class or a child class */
+	UFUNCTION(BlueprintCallable, Category = "SlotInventory|Registry")
+	void GetInventoriesOfOwnerClass(TSubclassOf<AActor> OwnerClass, TArray<USlotInventoryComponentBase*>& OutInventories) const;
+
+	/** Registered inventories whose owner is within Radius of Center */
+	UFUNCTION(BlueprintCallable, Category = "SlotInventory|Registry")
+	void GetInventoriesInRadius(FVector Center, float Radius, TArray<USlotInventoryComponentBase*>& OutInventories);
+
+
+	/** Background Maintenance */
+
+	/** Called by inventories with background maintenance to do, see USlotInventoryComponentBase::bBackgroundAutoStack */
+	void QueueMaintenance(USlotInventoryComponentBase* Inventory);
+
+
+protected:
+
+	/** Compact the idle inventories in turn until the compaction time budget is spent */
+	void CompactIdleInventories();
+
+	/** Run the maintenance of the queued inventories in turn until the maintenance time budget is spent */
+	void MaintainInventories();
+
+	void RemoveInventoryAt(int32 Index);
+
+	/** Move the owners that moved since the last radius query to their new cell, everything is placed again if the cell size changed */
+	void UpdateSpatialCells();
+
+	void UpdateSpatialCell(int32 Index);
+
+	FIntVector GetSpatialCell(const FVector& Location) const;
+
+	void OnOwnerTransformUpdated(USceneComponent* UpdatedComponent, EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport, TObjectKey<USlotInventoryComponentBase> InventoryKey);
+
+	void OnWorldPreActorTick(UWorld* InWorld, ELevelTick TickType, float DeltaSeconds);
+
+	TSharedRef<FSlotInventoryCommandQueue, ESPMode::ThreadSafe> CommandQueue = MakeShared<FSlotInventoryCommandQueue, ESPMode::ThreadSafe>();
+
+	FSlotInventoryRequestBudget RequestBudget;
+
+	FDelegateHandle PreActorTickHandle;
+
+	struct FRegisteredInventory
+	{
+		TWeakObjectPtr<USlotInventoryComponentBase> Inventory;
+
+		/** Keys are kept to unregister inventories already destroyed */
+		TObjectKey<USlotInventoryComponentBase> InventoryKey;
+		TObjectKey<UObject> Owner;
+		TObjectKey<UClass> OwnerClass;
+		FName Tag;
+
+		/** Position in InventoryIndicesByOwnerClass */
+		int32 ClassBucketIndex = INDEX_NONE;
+
+		/** Root of the owner, its moves are tracked for the spatial cells */
+		TWeakObjectPtr<USceneComponent> OwnerRoot;
+		FDelegateHandle TransformUpdatedHandle;
+
+		FIntVector SpatialCell = FIntVector::ZeroValue;
+		bool bInSpatialCell = false;
+	};
+
+	TArray<FRegisteredInventory> Inventories;
+
+	/** Indices in Inventories */
+	TMap<TObjectKey<USlotInventoryComponentBase>, int32> InventoryIndices;
+	/** In registration order, owners may have several inventories with the same tag */
+	TMap<TPair<TObjectKey<UObject>, FName>, TArray<int32, TInlineAllocator<1>>> InventoryIndicesByOwnerAndTag;
+	TMap<TObjectKey<UClass>, TArray<int32>> InventoryIndicesByOwnerClass;
+
+	TMap<FIntVector, TArray<int32, TInlineAllocator<4>>> SpatialCells;
+
+	float SpatialCellSize = 0.0f;
+
+	/** Inventories whose owner moved or registered since the last radius query */
+	TSet<TObjectKey<USlotInventoryComponentBase>> MovedInventories;
+
+	/** Round robin position of the background compaction */
+	int32 NextCompactionIndex = 0;
+
+	/** Inventories with maintenance to do, each one is queued once */
+	TArray<TWeakObjectPtr<USlotInventoryComponentBase>> MaintenanceQueue;
+
+	int32 NextMaintenanceIndex = 0;
+
+};
@@ -0,0 +1,46 @@
+// Amasson
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/WeakObjectPtrTemplates.h"
+
+class USlotInventoryComponentBase;
+
+/**
+ * Group the modifications of several inventories into one content update each.
+ *
+ * While a scope is open, modified inventories do not schedule their update for the next tick. When the outermost
+ * scope ends, every touched inventory broadcasts OnInventoryContentChanged and sends its replication update right away,
+ * once, in the order they were first touched. Scopes nest and can span any number of inventories. Game thread only.
+ * Dormant owners are flushed when modified, their update is sent right away as well.
+ */
+class SLOTBASEDINVENTORYSYSTEM_API FSlotInventoryBatchEditScope
+{
+public:
+
+	FSlotInventoryBatchEditScope() { Begin(); }
+	~FSlotInventoryBatchEditScope() { End(); }
+
+	UE_NONCOPYABLE(FSlotInventoryBatchEditScope);
+
+	/** Unscoped counterparts, for the Blueprint nodes. Every Begin must be matched by an End. */
+	static void Begin();
+	static void End();
+
+	static bool IsBatching() { return Depth > 0; }
+
+	/** Called when an inventory has modified slots while batching, instead of enabling its tick */
+	static void AddModifiedInventory(USlotInventoryComponentBase* Inventory);
+
+	/** Close the scopes left open, a batch cannot span frames. Returns false if there were any. */
+	static bool EndUnbalanced();
+
+private:
+
+	static void FlushInventories();
+
+	static int32 Depth;
+
+	static TArray<TWeakObjectPtr<USlotInventoryComponentBase>> ModifiedInventories;
+};
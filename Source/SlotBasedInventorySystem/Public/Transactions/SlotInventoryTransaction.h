@@ -0,0 +1,95 @@
+// Amasson
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Structures/SlotInventorySystemStructs.h"
+#include "SlotInventoryTransaction.generated.h"
+
+class USlotInventoryComponentBase;
+
+/** Items to add (positive) or remove (negative) from one inventory */
+USTRUCT(BlueprintType)
+struct SLOTBASEDINVENTORYSYSTEM_API FSlotInventoryModification
+{
+	GENERATED_USTRUCT_BODY()
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Transaction")
+	TObjectPtr<USlotInventoryComponentBase> Inventory;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Transaction")
+	TMap<FName, int32> Items;
+};
+
+/**
+ * All or nothing modification of several inventories.
+ *
+ * Operations are applied to the live contents as they are staged, journaling only the previous value of the touched slots.
+ * Commit marks the touched slots dirty, abort restores them. Nothing is broadcast before the commit.
+ * A transaction is aborted when it goes out of scope without being committed.
+ * Capacity changes are not supported while a transaction is open on an inventory.
+ */
+class SLOTBASEDINVENTORYSYSTEM_API FSlotInventoryTransaction
+{
+public:
+
+	FSlotInventoryTransaction() = default;
+	~FSlotInventoryTransaction();
+
+	UE_NONCOPYABLE(FSlotInventoryTransaction);
+
+
+	/** Staging, each operation returns false and fails the transaction if it could not be done */
+
+	/** Add or remove stacks. Fails if anything overflows, unless bAllowOverflow. */
+	bool ModifyContent(USlotInventoryComponentBase* Inventory, const TMap<FName, int32>& Items, bool bAllowOverflow = false);
+
+	bool DropSlotTowardOtherInventoryAtIndex(USlotInventoryComponentBase* Source, int32 SourceIndex, USlotInventoryComponentBase* Destination, int32 DestinationIndex, int32 MaxAmount = 0);
+
+	bool DropSlotTowardOtherInventory(USlotInventoryComponentBase* Source, int32 SourceIndex, USlotInventoryComponentBase* Destination);
+
+	bool SetSlotValueAtIndex(USlotInventoryComponentBase* Inventory, int32 Index, const FInventorySlot& NewSlotValue);
+
+	bool ClearSlotAtIndex(USlotInventoryComponentBase* Inventory, int32 Index);
+
+
+	/** Resolution */
+
+	/** False once an operation failed */
+	bool CanCommit() const;
+
+	/** Keep the modifications if every operation succeeded, abort otherwise. Returns true if committed. */
+	bool Commit();
+
+	void Abort();
+
+private:
+
+	struct FParticipant
+	{
+		TWeakObjectPtr<USlotInventoryComponentBase> Inventory;
+
+		/** Value of the touched slots when the transaction first touched them */
+		TMap<int32, FInventorySlot> OriginalSlots;
+	};
+
+	enum class EState : uint8
+	{
+		Open,
+		Failed,
+		Committed,
+		Aborted,
+	};
+
+	FParticipant* GetParticipant(USlotInventoryComponentBase* Inventory);
+
+	void JournalSlot(FParticipant& Participant, int32 Index, const FInventorySlot& Value);
+
+	void JournalPreviousValues(FParticipant& Participant, FInventoryContent::FPreviousValues& PreviousValues);
+
+	bool Stage(bool bSucceeded);
+
+	TArray<FParticipant> Participants;
+
+	EState State = EState::Open;
+};
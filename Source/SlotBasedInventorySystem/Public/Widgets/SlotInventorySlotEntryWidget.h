@@ -0,0 +1,45 @@
+// Amasson
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Blueprint/UserWidget.h"
+#include "Blueprint/IUserObjectListEntry.h"
+#include "Structures/SlotInventorySystemStructs.h"
+#include "SlotInventorySlotEntryWidget.generated.h"
+
+class USlotInventorySlotViewItem;
+
+/**
+ * Base of the entry widget of a list view bound to a USlotInventoryViewModel.
+ * It listens to its item only while it is displayed and refreshes when the slot changes.
+ */
+UCLASS(Abstract, Blueprintable)
+class SLOTBASEDINVENTORYSYSTEM_API USlotInventorySlotEntryWidget : public UUserWidget, public IUserObjectListEntry
+{
+	GENERATED_BODY()
+
+public:
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "SlotInventory|View")
+	USlotInventorySlotViewItem* GetSlotViewItem() const;
+
+protected:
+
+	virtual void NativeOnListItemObjectSet(UObject* ListItemObject) override;
+	virtual void NativeOnEntryReleased() override;
+
+	/** Called when the entry displays a new item and each time its slot changes */
+	UFUNCTION(BlueprintImplementableEvent, Category = "SlotInventory|View")
+	void OnSlotValueChanged(int32 SlotIndex, const FInventorySlot& SlotValue);
+
+private:
+
+	void BindSlotViewItem(USlotInventorySlotViewItem* NewItem);
+
+	UFUNCTION()
+	void OnSlotViewItemUpdated(USlotInventorySlotViewItem* SlotViewItem);
+
+	UPROPERTY(Transient)
+	TWeakObjectPtr<USlotInventorySlotViewItem> SlotViewItem;
+};
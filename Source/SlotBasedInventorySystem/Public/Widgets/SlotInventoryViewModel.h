@@ -0,0 +1,161 @@
+// Amasson
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "Structures/SlotInventorySystemStructs.h"
+#include "SlotInventoryViewModel.generated.h"
+
+class USlotInventoryComponentBase;
+class USlotInventoryViewModel;
+class USlotInventorySlotViewItem;
+class UListView;
+class UUserWidget;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnSlotViewItemUpdatedSignature, USlotInventorySlotViewItem*, SlotViewItem);
+DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FOnSlotViewItemsChangedSignature, USlotInventoryViewModel*, ViewModel);
+
+/**
+ * List item of one inventory slot. It only holds its index: the slot value is read from the
+ * inventory when an entry widget displays it.
+ */
+UCLASS(BlueprintType)
+class SLOTBASEDINVENTORYSYSTEM_API USlotInventorySlotViewItem : public UObject
+{
+	GENERATED_BODY()
+
+	friend class USlotInventoryViewModel;
+
+public:
+
+	/** Broadcast when the slot value changed. Entry widgets bind while they display this item. */
+	UPROPERTY(BlueprintAssignable)
+	FOnSlotViewItemUpdatedSignature OnSlotUpdated;
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "SlotInventory|View")
+	int32 GetSlotIndex() const { return SlotIndex; }
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "SlotInventory|View")
+	USlotInventoryViewModel* GetViewModel() const;
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "SlotInventory|View")
+	USlotInventoryComponentBase* GetInventory() const;
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "SlotInventory|View")
+	bool GetSlotValue(FInventorySlot& SlotValue) const;
+
+private:
+
+	int32 SlotIndex = INDEX_NONE;
+};
+
+/**
+ * Backing of a UListView or UTileView over the slots of an inventory.
+ * The list view only creates widgets for the visible items, and content updates only
+ * notify the items of the modified slots.
+ *
+ * UListView needs one item object per row, so the slots are shown in pages of DefaultPageSize slots:
+ * only the slots of the current page get items, and changing page points the same items at other slots.
+ * Items are pooled: they are created once per view model and reused across inventories and capacity changes.
+ * A page size of 0 shows every slot, with one item UObject per slot.
+ */
+UCLASS(BlueprintType)
+class SLOTBASEDINVENTORYSYSTEM_API USlotInventoryViewModel : public UObject
+{
+	GENERATED_BODY()
+
+public:
+
+	UFUNCTION(BlueprintCallable, Category = "SlotInventory|View")
+	static USlotInventoryViewModel* MakeInventoryViewModel(USlotInventoryComponentBase* Inventory);
+
+	virtual void BeginDestroy() override;
+
+	UFUNCTION(BlueprintCallable, Category = "SlotInventory|View")
+	void SetInventory(USlotInventoryComponentBase* NewInventory);
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "SlotInventory|View")
+	USlotInventoryComponentBase* GetInventory() const;
+
+
+	/** Items */
+
+	/** Broadcast when items were added or removed, the list view items must be set again */
+	UPROPERTY(BlueprintAssignable)
+	FOnSlotViewItemsChangedSignature OnItemsChanged;
+
+	const TArray<TObjectPtr<USlotInventorySlotViewItem>>& GetItems() const { return Items; }
+
+	/** Index in the items, the slot index minus GetFirstSlotIndex */
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "SlotInventory|View")
+	USlotInventorySlotViewItem* GetItemAtIndex(int32 Index) const;
+
+
+	/** Pages */
+
+	static constexpr int32 DefaultPageSize = 64;
+
+	/** Only give items to PageSize slots at a time, DefaultPageSize by default, 0 to show every slot */
+	UFUNCTION(BlueprintCallable, Category = "SlotInventory|View")
+	void SetPageSize(int32 NewPageSize);
+
+	UFUNCTION(BlueprintCallable, Category = "SlotInventory|View")
+	void SetPage(int32 NewPage);
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "SlotInventory|View")
+	int32 GetPage() const { return Page; }
+
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "SlotInventory|View")
+	int32 GetNumPages() const;
+
+	/** Slot index of the first item */
+	UFUNCTION(BlueprintCallable, BlueprintPure, Category = "SlotInventory|View")
+	int32 GetFirstSlotIndex() const { return PageSize > 0 ? Page * PageSize : 0; }
+
+	/**
+	 * Set the items of a list view or tile view and keep it updated when items are added or removed.
+	 * The inventory stays view locked while a list view is bound, until it is unbound or its widget is destructed.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "SlotInventory|View")
+	void BindListView(UListView* ListView);
+
+	UFUNCTION(BlueprintCallable, Category = "SlotInventory|View")
+	void UnbindListView(UListView* ListView);
+
+private:
+
+	void UnbindInventory();
+
+	void AcquireInventoryViewLock();
+
+	void ReleaseInventoryViewLock();
+
+	void OnListViewWidgetDestructed(UUserWidget* Widget);
+
+	void SyncItemsWithCapacity();
+
+	void OnInventorySlotsChanged(USlotInventoryComponentBase* SlotInventoryComponent, TConstArrayView<FInventorySlotChange> Changes);
+
+	UFUNCTION()
+	void OnInventoryCapacityChanged(USlotInventoryComponentBase* SlotInventoryComponent, int32 NewCapacity);
+
+	TWeakObjectPtr<USlotInventoryComponentBase> Inventory;
+
+	bool bHoldsViewLock = false;
+
+	FDelegateHandle SlotsChangedHandle;
+
+	UPROPERTY()
+	TArray<TObjectPtr<USlotInventorySlotViewItem>> Items;
+
+	/** Items removed when the capacity or the page shrank, reused before creating new ones */
+	UPROPERTY()
+	TArray<TObjectPtr<USlotInventorySlotViewItem>> PooledItems;
+
+	int32 PageSize = DefaultPageSize;
+
+	int32 Page = 0;
+
+	TArray<TWeakObjectPtr<UListView>> BoundListViews;
+};
@@ -39,6 +39,7 @@ public class SlotBasedInventorySystem : ModuleRules
 				"Engine",
 				"Slate",
 				"SlateCore",
+				"UMG",
 				"JsonUtilities",
 				// ... add private dependencies that you statically link with here ...	
 			}